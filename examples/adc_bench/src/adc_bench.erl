@@ -0,0 +1,185 @@
+%%
+%% Copyright (c) 2020 dushin.net
+%% All rights reserved.
+%%
+%% Licensed under the Apache License, Version 2.0 (the "License");
+%% you may not use this file except in compliance with the License.
+%% You may obtain a copy of the License at
+%%
+%%     http://www.apache.org/licenses/LICENSE-2.0
+%%
+%% Unless required by applicable law or agreed to in writing, software
+%% distributed under the License is distributed on an "AS IS" BASIS,
+%% WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+%% See the License for the specific language governing permissions and
+%% limitations under the License.
+%%
+-module(adc_bench).
+
+-export([start/0, run/1]).
+
+%% readings per case; every latency is kept to compute percentiles
+-define(ITERATIONS, 200).
+-define(WARMUP, 10).
+-define(SAMPLES, [1, 16, 64, 256, 1024]).
+
+start() ->
+    {Model, Pins} = board(),
+    io:format("adc_bench model=~p pins=~p iterations=~p~n", [Model, Pins, ?ITERATIONS]),
+    run(Pins).
+
+%% Run every case against the given pins, the first of which is used for
+%% single pin cases, and print one report line per case.
+run(Pins) ->
+    ADCs = [start_adc(P) || P <- Pins],
+    [ADC | _] = ADCs,
+    Channel = gen_server:call(ADC, get_channel),
+    header(),
+    bench("read/1", fun() -> {ok, _} = adc:read(ADC) end),
+    lists:foreach(
+        fun(Samples) ->
+            bench(io_lib:format("read/2 samples=~p", [Samples]), fun() -> {ok, _} = adc:read(ADC, [raw, voltage, {samples, Samples}]) end)
+        end,
+        ?SAMPLES
+    ),
+    lists:foreach(
+        fun(Samples) ->
+            bench(io_lib:format("direct samples=~p", [Samples]), fun() -> direct_read(Channel, [raw, voltage, {samples, Samples}]) end)
+        end,
+        [1, 64]
+    ),
+    lists:foreach(
+        fun(Samples) ->
+            bench(io_lib:format("scan n=~p samples=~p", [length(ADCs), Samples]), fun() -> {ok, _, _} = adc:scan(ADCs, [raw, voltage, {samples, Samples}]) end)
+        end,
+        [1, 64]
+    ),
+    lists:foreach(
+        fun(Samples) ->
+            bench(io_lib:format("read_async samples=~p", [Samples]), fun() -> async_read(ADC, [raw, voltage, {samples, Samples}]) end)
+        end,
+        [1, 64]
+    ),
+    io:format("scheduler ~p~n", [adc:scheduler_stats()]),
+    [adc:stop(A) || A <- ADCs],
+    io:format("adc_bench done~n"),
+    ok.
+
+%%
+%% internal operations
+%%
+
+%% @private
+board() ->
+    Model = model(),
+    {Model, pins(Model)}.
+
+%% @private
+model() ->
+    try erlang:system_info(esp32_chip_info) of
+        #{model := Model} ->
+            Model;
+        {Model, _Features, _Cores, _Revision} ->
+            Model;
+        _ ->
+            unknown
+    catch
+        _:_ ->
+            unknown
+    end.
+
+%% @private
+%% ADC1 pins, which are usable with WiFi enabled
+pins(esp32_s2) -> [1, 2];
+pins(esp32_s3) -> [1, 2];
+pins(esp32_c3) -> [0, 1];
+pins(_) -> [34, 35].
+
+%% @private
+start_adc(Pin) ->
+    {ok, ADC} = adc:start(Pin),
+    ADC.
+
+%% @private
+%% a reading straight through the nif, without the gen_server round trip
+direct_read({Pin, BitWidth, Attenuation, Discard}, ReadOptions) ->
+    case adc:take_reading(Pin, ReadOptions ++ [{discard, Discard}], BitWidth, Attenuation) of
+        {continue, Continuation} ->
+            resume(Continuation);
+        {error, _} = Error ->
+            throw(Error);
+        Reading ->
+            Reading
+    end.
+
+%% @private
+resume(Continuation) ->
+    case adc:resume_reading(Continuation) of
+        {continue, Continuation} ->
+            resume(Continuation);
+        Reading ->
+            Reading
+    end.
+
+%% @private
+async_read(ADC, ReadOptions) ->
+    {ok, Ref} = adc:read_async(ADC, ReadOptions),
+    receive
+        {adc_reading, Ref, {error, _} = Error} ->
+            throw(Error);
+        {adc_reading, Ref, Reading} ->
+            Reading
+    after 5000 ->
+        throw(timeout)
+    end.
+
+%% @private
+header() ->
+    row("case", ["reads/s", "min", "p50", "p90", "p99", "max"]).
+
+%% @private
+bench(Name, Fun) ->
+    repeat(Fun, ?WARMUP),
+    Start = erlang:monotonic_time(microsecond),
+    Latencies = measure(Fun, ?ITERATIONS, []),
+    Elapsed = erlang:monotonic_time(microsecond) - Start,
+    Sorted = lists:sort(Latencies),
+    row(lists:flatten(Name), [
+        integer_to_list(?ITERATIONS * 1000000 div max(Elapsed, 1)) |
+        [integer_to_list(L) || L <- [hd(Sorted), percentile(Sorted, 50), percentile(Sorted, 90), percentile(Sorted, 99), lists:last(Sorted)]]
+    ]).
+
+%% @private
+%% fixed width columns, so that reports from different boards line up
+row(Name, Columns) ->
+    io:format("~s~n", [lists:flatten([pad_right(Name, 28) | [pad_left(C, 9) || C <- Columns]])]).
+
+%% @private
+pad_right(String, Width) ->
+    String ++ lists:duplicate(max(0, Width - length(String)), $\s).
+
+%% @private
+pad_left(String, Width) ->
+    lists:duplicate(max(0, Width - length(String)), $\s) ++ String.
+
+%% @private
+repeat(_Fun, 0) ->
+    ok;
+repeat(Fun, N) ->
+    Fun(),
+    repeat(Fun, N - 1).
+
+%% @private
+measure(_Fun, 0, Accum) ->
+    Accum;
+measure(Fun, N, Accum) ->
+    T0 = erlang:monotonic_time(microsecond),
+    Fun(),
+    T1 = erlang:monotonic_time(microsecond),
+    measure(Fun, N - 1, [T1 - T0 | Accum]).
+
+%% @private
+%% nearest rank
+percentile(Sorted, P) ->
+    Rank = max(1, (P * length(Sorted) + 99) div 100),
+    lists:nth(Rank, Sorted).
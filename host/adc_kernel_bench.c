@@ -0,0 +1,306 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Microbenchmark of the processing kernels in nifs/ over synthetic blocks
+// of 12-bit readings.  Each kernel is run repeatedly for at least
+// MIN_RUN_NS, and the best of RUNS runs is reported, per sample.
+//
+// Usage: adc_kernel_bench [-n SAMPLES] [FILTER]
+//
+// Only kernels whose name contains FILTER are run.
+//
+
+#include "adc_block.h"
+#include "adc_convert.h"
+#include "adc_filter.h"
+#include "adc_frame.h"
+#include "adc_quantile.h"
+#include "adc_reduce.h"
+#include "adc_smooth.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static inline uint64_t cycles(void)
+{
+    return __rdtsc();
+}
+#else
+#define HAVE_CYCLES 0
+static inline uint64_t cycles(void)
+{
+    return 0;
+}
+#endif
+
+#define DEFAULT_SAMPLES 4096
+#define RUNS 5
+#define MIN_RUN_NS 20000000LL
+#define MAX_SAMPLES (1 << 20)
+
+// typical ESP32 characteristics at 11 dB
+#define COEFF_A 53000
+#define COEFF_B 142
+
+struct bench
+{
+    size_t n;
+    uint16_t *raw;
+    uint16_t *out;
+    uint16_t *scratch;
+    uint8_t *frame;
+    struct adc_convert_linear linear;
+    struct adc_convert_lut *lut;
+    struct adc_smooth moving_average;
+    struct adc_smooth savitzky_golay;
+    // results are accumulated here, so that no kernel is optimized away
+    volatile uint32_t sink;
+};
+
+typedef void (*kernel_t)(struct bench *bench);
+
+static void bench_copy(struct bench *bench)
+{
+    memcpy(bench->scratch, bench->raw, bench->n * sizeof(uint16_t));
+    bench->sink += bench->scratch[bench->n - 1];
+}
+
+static void bench_convert_linear(struct bench *bench)
+{
+    adc_convert_linear_block(&bench->linear, bench->raw, bench->out, bench->n);
+    bench->sink += bench->out[bench->n - 1];
+}
+
+static void bench_convert_lut(struct bench *bench)
+{
+    adc_convert_lut_block(bench->lut, bench->raw, bench->out, bench->n);
+    bench->sink += bench->out[bench->n - 1];
+}
+
+static void bench_mean(struct bench *bench)
+{
+    bench->sink += adc_reduce_mean(bench->raw, bench->n);
+}
+
+// the median and trimmed mean reorder their input, so they include a copy
+// (see the copy kernel)
+static void bench_median(struct bench *bench)
+{
+    memcpy(bench->scratch, bench->raw, bench->n * sizeof(uint16_t));
+    bench->sink += adc_reduce_median(bench->scratch, bench->n);
+}
+
+static void bench_trimmed_mean(struct bench *bench)
+{
+    memcpy(bench->scratch, bench->raw, bench->n * sizeof(uint16_t));
+    bench->sink += adc_reduce_trimmed_mean(bench->scratch, bench->n, 250);
+}
+
+static void bench_block_minmax(struct bench *bench)
+{
+    uint16_t min;
+    uint16_t max;
+    adc_block_minmax(bench->raw, bench->n, &min, &max);
+    bench->sink += min + max;
+}
+
+static void bench_block_fir(struct bench *bench)
+{
+    adc_block_fir(bench->raw, bench->out, bench->n, bench->savitzky_golay.coeffs, bench->savitzky_golay.window, ADC_SMOOTH_SHIFT);
+    bench->sink += bench->out[0];
+}
+
+static void bench_kalman(struct bench *bench)
+{
+    struct adc_filter filter;
+    adc_filter_init_kalman(&filter, ADC_FILTER_ONE / 100, 25 * ADC_FILTER_ONE);
+    for (size_t i = 0; i < bench->n; ++i) {
+        adc_filter_update(&filter, bench->raw[i]);
+    }
+    bench->sink += filter.x;
+}
+
+static void bench_alpha_beta(struct bench *bench)
+{
+    struct adc_filter filter;
+    adc_filter_init_alpha_beta(&filter, ADC_FILTER_ONE / 10, ADC_FILTER_ONE / 100);
+    for (size_t i = 0; i < bench->n; ++i) {
+        adc_filter_update(&filter, bench->raw[i]);
+    }
+    bench->sink += filter.x;
+}
+
+static void bench_moving_average(struct bench *bench)
+{
+    adc_smooth_apply(&bench->moving_average, bench->raw, bench->out, bench->n);
+    bench->sink += bench->out[bench->n / 2];
+}
+
+static void bench_savitzky_golay(struct bench *bench)
+{
+    adc_smooth_apply(&bench->savitzky_golay, bench->raw, bench->out, bench->n);
+    bench->sink += bench->out[bench->n / 2];
+}
+
+static void bench_quantiles(struct bench *bench)
+{
+    static const float p[] = { 0.5f, 0.95f, 0.99f };
+    struct adc_quantiles quantiles;
+    adc_quantiles_init(&quantiles, p, 3);
+    for (size_t i = 0; i < bench->n; ++i) {
+        adc_quantiles_update(&quantiles, bench->raw[i]);
+    }
+    bench->sink += (uint32_t) adc_quantiles_get(&quantiles, 0);
+}
+
+static void bench_frame(struct bench *bench)
+{
+    struct adc_frame_info info = { .type = ADC_FRAME_SAMPLES, .source = 34, .sequence = bench->sink, .timestamp_us = bench->sink, .period_us = 1000 };
+    size_t len = adc_frame_encode(&info, bench->raw, bench->n, bench->frame);
+    bench->sink += bench->frame[len - 1];
+}
+
+static const struct
+{
+    const char *name;
+    kernel_t kernel;
+} kernels[] = {
+    { "copy", bench_copy },
+    { "convert/linear", bench_convert_linear },
+    { "convert/lut", bench_convert_lut },
+    { "reduce/mean", bench_mean },
+    { "reduce/median", bench_median },
+    { "reduce/trimmed_mean_25", bench_trimmed_mean },
+    { "block/minmax", bench_block_minmax },
+    { "block/fir_9", bench_block_fir },
+    { "filter/kalman", bench_kalman },
+    { "filter/alpha_beta", bench_alpha_beta },
+    { "smooth/moving_average_9", bench_moving_average },
+    { "smooth/savitzky_golay_9_2", bench_savitzky_golay },
+    { "quantiles/p2_3", bench_quantiles },
+    { "frame/encode", bench_frame },
+};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t linear_to_mv(uint32_t raw, const void *arg)
+{
+    return adc_convert_linear_to_mv((const struct adc_convert_linear *) arg, raw);
+}
+
+// a slow sine over the whole range, with noise
+static void synthesize(uint16_t *raw, size_t n)
+{
+    srand(1);
+    for (size_t i = 0; i < n; ++i) {
+        double x = 2048.0 + 1800.0 * sin(2.0 * M_PI * (double) i / 512.0) + (rand() % 41 - 20);
+        raw[i] = x < 0.0 ? 0 : (x > 4095.0 ? 4095 : (uint16_t) x);
+    }
+}
+
+static void run(struct bench *bench, const char *name, kernel_t kernel)
+{
+    double best_ns = INFINITY;
+    double best_cycles = INFINITY;
+    for (int run = 0; run < RUNS; ++run) {
+        long iterations = 0;
+        int64_t start = now_ns();
+        uint64_t start_cycles = cycles();
+        int64_t elapsed;
+        do {
+            kernel(bench);
+            ++iterations;
+            elapsed = now_ns() - start;
+        } while (elapsed < MIN_RUN_NS);
+        uint64_t elapsed_cycles = cycles() - start_cycles;
+        double samples = (double) iterations * bench->n;
+        if (elapsed / samples < best_ns) {
+            best_ns = elapsed / samples;
+            best_cycles = elapsed_cycles / samples;
+        }
+    }
+    if (HAVE_CYCLES) {
+        printf("%-28s %12.3f %14.2f\n", name, best_ns, best_cycles);
+    } else {
+        printf("%-28s %12.3f %14s\n", name, best_ns, "-");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = DEFAULT_SAMPLES;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = strtoul(argv[++i], NULL, 10);
+        } else if (argv[i][0] != '-' && filter == NULL) {
+            filter = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [-n SAMPLES] [FILTER]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (n == 0 || n > MAX_SAMPLES) {
+        fprintf(stderr, "SAMPLES must be between 1 and %d\n", MAX_SAMPLES);
+        return 2;
+    }
+
+    struct bench bench = {
+        .n = n,
+        .linear = { .coeff_a = COEFF_A, .coeff_b = COEFF_B, .shift = 0 },
+    };
+    bench.raw = malloc(n * sizeof(uint16_t));
+    bench.out = malloc(n * sizeof(uint16_t));
+    bench.scratch = malloc(n * sizeof(uint16_t));
+    bench.frame = malloc(adc_frame_size(n));
+    bench.lut = malloc(adc_convert_lut_size(12));
+    if (bench.raw == NULL || bench.out == NULL || bench.scratch == NULL || bench.frame == NULL || bench.lut == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    synthesize(bench.raw, n);
+    adc_convert_lut_build(bench.lut, 12, linear_to_mv, &bench.linear);
+    adc_smooth_init_moving_average(&bench.moving_average, 9);
+    adc_smooth_init_savitzky_golay(&bench.savitzky_golay, 9, 2);
+
+    printf("samples=%zu runs=%d block=%s\n", n, RUNS, adc_block_impl());
+    printf("%-28s %12s %14s\n", "kernel", "ns/sample", "cycles/sample");
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+        if (filter == NULL || strstr(kernels[i].name, filter) != NULL) {
+            run(&bench, kernels[i].name, kernels[i].kernel);
+        }
+    }
+
+    free(bench.raw);
+    free(bench.out);
+    free(bench.scratch);
+    free(bench.frame);
+    free(bench.lut);
+    return 0;
+}
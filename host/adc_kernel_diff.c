@@ -0,0 +1,541 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Differential check of the processing kernels in nifs/ against reference
+// implementations, over randomized blocks of readings.  Each check reports
+// the largest difference seen and its tolerance; the exit status is 1 if any
+// check exceeds its tolerance.
+//
+// Usage: adc_kernel_diff [-s SEED] [-i ITERATIONS]
+//
+// The references are deliberately naive:
+//
+//   * conversion: the linear esp_adc_cal characteristic, evaluated in 64 bits
+//     with a division, as in esp_adc_cal_raw_to_voltage
+//   * averaging: the truncating sum / samples of take_reading in
+//     atomvm_adc.c, which adc_reduce_mean rounds instead, so the mean may be
+//     one more
+//   * order statistics: a fully sorted copy of the block
+//   * block kernels: plain loops, over blocks at every alignment
+//   * smoothing: direct window sums, and the closed form Savitzky-Golay
+//     coefficients for orders 2 and 3 in double precision.  The fixed point
+//     coefficients are rounded to 2^-14, which bounds the error to
+//     1 + window * max / 2^14 for readings up to max
+//   * quantiles: the P-square estimates of uniform readings after a long
+//     run of 2^25 samples, past where single precision positions break
+//     down, against the known quantiles, within 1% of full scale
+//   * conversion profiles: the profile evaluated in floating point at every
+//     millivolt, against the table compiled for each attenuation.  The error
+//     is that of linear interpolation between points, 32 mV apart for db_11:
+//     up to 0.5 degrees C for typical NTC circuits between -40 and 125
+//     degrees C, 1 mV for dividers, and 3.5% at the knees of the Li-ion curve
+//   * frames, gap and config records: the header fields read back byte by byte, and
+//     a bitwise CRC-32
+//
+
+#include "adc_block.h"
+#include "adc_convert.h"
+#include "adc_frame.h"
+#include "adc_profile.h"
+#include "adc_quantile.h"
+#include "adc_reduce.h"
+#include "adc_smooth.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_ITERATIONS 2000
+#define MAX_BLOCK 1024
+#define QUANTILE_RUN (1UL << 25)
+#define QUANTILE_RANGE 1000
+// temperatures NTC tables are checked over, in m°C
+#define NTC_CHECK_MIN -40000
+#define NTC_CHECK_MAX 125000
+#define NTC_TOLERANCE 500
+#define DIVIDER_TOLERANCE 1
+#define LI_ION_TOLERANCE 35
+
+struct check
+{
+    const char *name;
+    unsigned long cases;
+    long max_diff;
+    long tolerance;
+    bool failed;
+};
+
+static uint64_t rng_state;
+
+// xorshift64*, so that runs are reproducible across C libraries
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t) ((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rng() % (hi - lo + 1);
+}
+
+static void compare(struct check *check, long expected, long actual, long tolerance, const char *context)
+{
+    long diff = labs(actual - expected);
+    check->cases++;
+    if (diff > check->max_diff) {
+        check->max_diff = diff;
+    }
+    if (tolerance > check->tolerance) {
+        check->tolerance = tolerance;
+    }
+    if (diff > tolerance && !check->failed) {
+        check->failed = true;
+        fprintf(stderr, "%s: expected %ld, got %ld (%s)\n", check->name, expected, actual, context);
+    }
+}
+
+// blocks of readings of the given width: noise, constant, full scale
+// alternation, or a ramp, so that edge values are well covered
+static size_t random_block(uint16_t *block, unsigned bits)
+{
+    size_t n = rng_range(1, MAX_BLOCK);
+    uint32_t max = (1 << bits) - 1;
+    uint32_t kind = rng() % 4;
+    uint32_t base = rng_range(0, max);
+    for (size_t i = 0; i < n; ++i) {
+        switch (kind) {
+            case 0:
+                block[i] = rng_range(0, max);
+                break;
+            case 1:
+                block[i] = base;
+                break;
+            case 2:
+                block[i] = (i & 1) ? max : 0;
+                break;
+            default:
+                block[i] = (base + i) % (max + 1);
+                break;
+        }
+    }
+    return n;
+}
+
+static int compare_u16(const void *a, const void *b)
+{
+    return (int) *(const uint16_t *) a - (int) *(const uint16_t *) b;
+}
+
+static uint32_t reference_linear(uint32_t a, uint32_t b, unsigned bits, uint32_t raw)
+{
+    uint64_t scaled = (uint64_t) raw << (12 - bits);
+    return (uint32_t) ((a * scaled + 32768) / 65536) + b;
+}
+
+static uint32_t linear_to_mv(uint32_t raw, const void *arg)
+{
+    return adc_convert_linear_to_mv((const struct adc_convert_linear *) arg, raw);
+}
+
+static void check_convert(struct check *linear_check, struct check *lut_check, uint16_t *raw, uint16_t *mv, struct adc_convert_lut *lut)
+{
+    unsigned bits = rng_range(9, 12);
+    struct adc_convert_linear linear = {
+        .coeff_a = rng_range(10000, 120000),
+        .coeff_b = rng_range(0, 300),
+        .shift = 12 - bits
+    };
+    size_t n = random_block(raw, bits);
+    char context[64];
+    snprintf(context, sizeof(context), "a=%u b=%u bits=%u", linear.coeff_a, linear.coeff_b, bits);
+
+    adc_convert_linear_block(&linear, raw, mv, n);
+    for (size_t i = 0; i < n; ++i) {
+        compare(linear_check, reference_linear(linear.coeff_a, linear.coeff_b, bits, raw[i]), mv[i], 0, context);
+    }
+    adc_convert_lut_build(lut, bits, linear_to_mv, &linear);
+    adc_convert_lut_block(lut, raw, mv, n);
+    for (size_t i = 0; i < n; ++i) {
+        compare(lut_check, reference_linear(linear.coeff_a, linear.coeff_b, bits, raw[i]), mv[i], 0, context);
+    }
+}
+
+static void check_reduce(struct check *mean_check, struct check *median_check, struct check *trimmed_check, uint16_t *block, uint16_t *sorted, uint16_t *scratch)
+{
+    unsigned bits = rng_range(9, 12);
+    size_t n = random_block(block, bits);
+    unsigned trim = rng_range(0, 499);
+    char context[64];
+    snprintf(context, sizeof(context), "n=%zu trim=%u", n, trim);
+
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += block[i];
+    }
+    // rounding instead of truncating adds at most one
+    compare(mean_check, (long) (sum / n), adc_reduce_mean(block, n), 1, context);
+
+    memcpy(sorted, block, n * sizeof(uint16_t));
+    qsort(sorted, n, sizeof(uint16_t), compare_u16);
+    uint32_t median = (n & 1) ? sorted[n / 2] : ((uint32_t) sorted[n / 2 - 1] + sorted[n / 2] + 1) / 2;
+    memcpy(scratch, block, n * sizeof(uint16_t));
+    compare(median_check, median, adc_reduce_median(scratch, n), 0, context);
+
+    size_t k = n * trim / 1000;
+    uint64_t kept = 0;
+    for (size_t i = k; i < n - k; ++i) {
+        kept += sorted[i];
+    }
+    uint32_t trimmed = (kept + (n - 2 * k) / 2) / (n - 2 * k);
+    memcpy(scratch, block, n * sizeof(uint16_t));
+    compare(trimmed_check, trimmed, adc_reduce_trimmed_mean(scratch, n, trim), 0, context);
+}
+
+// buffer must have room for MAX_BLOCK + 7 samples
+static void check_block(struct check *minmax_check, struct check *fir_check, uint16_t *buffer, uint16_t *out)
+{
+    // any alignment; FIR inputs are limited to 14 bits
+    size_t offset = rng_range(0, 7);
+    uint16_t *block = buffer + offset;
+    bool fir = rng() % 2;
+    size_t n = random_block(block, fir ? 14 : 16);
+    char context[64];
+    snprintf(context, sizeof(context), "n=%zu offset=%zu", n, offset);
+
+    uint16_t min = block[0];
+    uint16_t max = block[0];
+    for (size_t i = 0; i < n; ++i) {
+        min = block[i] < min ? block[i] : min;
+        max = block[i] > max ? block[i] : max;
+    }
+    uint16_t block_min;
+    uint16_t block_max;
+    adc_block_minmax(block, n, &block_min, &block_max);
+    compare(minmax_check, min, block_min, 0, context);
+    compare(minmax_check, max, block_max, 0, context);
+
+    if (!fir) {
+        return;
+    }
+    // random coefficients, scaled down to the limits of adc_block_fir
+    int16_t coeffs[ADC_SMOOTH_MAX_WINDOW];
+    unsigned taps = rng_range(1, ADC_SMOOTH_MAX_WINDOW);
+    unsigned shift = rng_range(1, 16);
+    long magnitude = 0;
+    for (unsigned j = 0; j < taps; ++j) {
+        coeffs[j] = (int16_t) (rng_range(0, 65535) - 32768);
+        magnitude += labs(coeffs[j]);
+    }
+    for (unsigned j = 0; magnitude > 65536 && j < taps; ++j) {
+        coeffs[j] = (int16_t) (coeffs[j] * 65536L / magnitude);
+    }
+    adc_block_fir(block, out, n, coeffs, taps, shift);
+    for (size_t i = 0; i + taps <= n; ++i) {
+        int64_t acc = 0;
+        for (unsigned j = 0; j < taps; ++j) {
+            acc += (int64_t) coeffs[j] * block[i + j];
+        }
+        acc = (acc + (1 << (shift - 1))) >> shift;
+        compare(fir_check, acc < 0 ? 0 : (acc > UINT16_MAX ? UINT16_MAX : acc), out[i], 0, context);
+    }
+}
+
+static uint16_t sample_at(const uint16_t *in, size_t n, long i)
+{
+    return in[i < 0 ? 0 : ((size_t) i >= n ? n - 1 : (size_t) i)];
+}
+
+static void check_smooth(struct check *ma_check, struct check *sg_check, uint16_t *in, uint16_t *out)
+{
+    unsigned bits = rng_range(9, 12);
+    size_t n = random_block(in, bits);
+    long m = rng_range(1, ADC_SMOOTH_MAX_WINDOW / 2);
+    unsigned window = 2 * m + 1;
+    char context[64];
+    snprintf(context, sizeof(context), "n=%zu window=%u", n, window);
+
+    struct adc_smooth smooth;
+    adc_smooth_init_moving_average(&smooth, window);
+    adc_smooth_apply(&smooth, in, out, n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t sum = 0;
+        for (long j = -m; j <= m; ++j) {
+            sum += sample_at(in, n, (long) i + j);
+        }
+        compare(ma_check, (sum + window / 2) / window, out[i], 0, context);
+    }
+
+    if (window < 5) {
+        return;
+    }
+    unsigned order = rng_range(2, 3);
+    adc_smooth_init_savitzky_golay(&smooth, window, order);
+    adc_smooth_apply(&smooth, in, out, n);
+    // orders 2 and 3 share their smoothing coefficients
+    double norm = (double) (2 * m - 1) * (2 * m + 1) * (2 * m + 3);
+    long tolerance = 1 + (long) ((window * ((1u << bits) - 1)) >> ADC_SMOOTH_SHIFT);
+    for (size_t i = 0; i < n; ++i) {
+        double acc = 0.0;
+        for (long j = -m; j <= m; ++j) {
+            double c = (3.0 * (3 * m * m + 3 * m - 1) - 15.0 * j * j) / norm;
+            acc += c * sample_at(in, n, (long) i + j);
+        }
+        long expected = lround(acc < 0.0 ? 0.0 : acc);
+        compare(sg_check, expected, out[i], tolerance, context);
+    }
+}
+
+static uint32_t reference_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint64_t read_le(const uint8_t *p, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= (uint64_t) p[i] << (8 * i);
+    }
+    return value;
+}
+
+static void check_frame(struct check *header_check, struct check *crc_check, uint16_t *block, uint8_t *frame)
+{
+    size_t n = random_block(block, 16);
+    struct adc_frame_info info = {
+        .type = ADC_FRAME_SAMPLES,
+        .source = rng_range(0, 48),
+        .sequence = rng(),
+        .timestamp_us = ((int64_t) rng() << 32) | rng(),
+        .period_us = rng_range(100, 1000000)
+    };
+    char context[64];
+    snprintf(context, sizeof(context), "n=%zu", n);
+
+    size_t len = adc_frame_encode(&info, block, n, frame);
+    compare(header_check, adc_frame_size(n), len, 0, context);
+    compare(header_check, len, adc_frame_length(frame), 0, context);
+    compare(header_check, 0, memcmp(frame, "ADCF", 4), 0, context);
+    compare(header_check, ADC_FRAME_VERSION, frame[4], 0, context);
+    compare(header_check, info.type, frame[5], 0, context);
+    compare(header_check, info.source, read_le(frame + 6, 2), 0, context);
+    compare(header_check, info.sequence, read_le(frame + 8, 4), 0, context);
+    compare(header_check, n, read_le(frame + 12, 4), 0, context);
+    compare(header_check, n * sizeof(uint16_t), read_le(frame + 16, 4), 0, context);
+    compare(header_check, 0, read_le(frame + 20, 8) != (uint64_t) info.timestamp_us, 0, context);
+    compare(header_check, info.period_us, read_le(frame + 28, 4), 0, context);
+    for (size_t i = 0; i < n; ++i) {
+        compare(header_check, block[i], read_le(frame + ADC_FRAME_HEADER_SIZE + 2 * i, 2), 0, context);
+    }
+    uint32_t crc = reference_crc32(frame + 4, len - 4 - ADC_FRAME_TRAILER_SIZE);
+    compare(crc_check, crc, read_le(frame + len - ADC_FRAME_TRAILER_SIZE, 4), 0, context);
+
+    // a gap record of the frame lost, and of samples skipped before it
+    struct adc_frame_gap gap = { 0 };
+    uint32_t skipped = rng_range(0, 100);
+    if (skipped > 0) {
+        adc_frame_gap_add_samples(&gap, skipped, info.timestamp_us - (int64_t) skipped * info.period_us);
+    }
+    adc_frame_gap_add_frame(&gap, info.sequence, n, info.timestamp_us);
+    int64_t first_us = skipped > 0 ? info.timestamp_us - (int64_t) skipped * info.period_us : info.timestamp_us;
+    info.sequence++;
+    adc_frame_encode_gap(&info, &gap, frame);
+    compare(header_check, ADC_FRAME_GAP_SIZE, adc_frame_length(frame), 0, context);
+    compare(header_check, ADC_FRAME_GAP, frame[5], 0, context);
+    compare(header_check, info.sequence, read_le(frame + 8, 4), 0, context);
+    compare(header_check, skipped + n, read_le(frame + 12, 4), 0, context);
+    compare(header_check, 0, read_le(frame + 20, 8) != (uint64_t) first_us, 0, context);
+    compare(header_check, info.sequence - 1, read_le(frame + ADC_FRAME_HEADER_SIZE, 4), 0, context);
+    compare(header_check, 1, read_le(frame + ADC_FRAME_HEADER_SIZE + 4, 4), 0, context);
+    crc = reference_crc32(frame + 4, ADC_FRAME_GAP_SIZE - 4 - ADC_FRAME_TRAILER_SIZE);
+    compare(crc_check, crc, read_le(frame + ADC_FRAME_GAP_SIZE - ADC_FRAME_TRAILER_SIZE, 4), 0, context);
+
+    // a config record, as sent when the sampler is reconfigured
+    uint8_t atten = rng_range(0, 3);
+    uint16_t oversample = rng_range(1, 64);
+    info.sequence++;
+    adc_frame_encode_config(&info, atten, oversample, frame);
+    compare(header_check, ADC_FRAME_CONFIG_SIZE, adc_frame_length(frame), 0, context);
+    compare(header_check, ADC_FRAME_CONFIG, frame[5], 0, context);
+    compare(header_check, info.sequence, read_le(frame + 8, 4), 0, context);
+    compare(header_check, 0, read_le(frame + 12, 4), 0, context);
+    compare(header_check, info.period_us, read_le(frame + 28, 4), 0, context);
+    compare(header_check, atten, frame[ADC_FRAME_HEADER_SIZE], 0, context);
+    compare(header_check, oversample, read_le(frame + ADC_FRAME_HEADER_SIZE + 2, 2), 0, context);
+    crc = reference_crc32(frame + 4, ADC_FRAME_CONFIG_SIZE - 4 - ADC_FRAME_TRAILER_SIZE);
+    compare(crc_check, crc, read_le(frame + ADC_FRAME_CONFIG_SIZE - ADC_FRAME_TRAILER_SIZE, 4), 0, context);
+}
+
+// once per run, as the run is long
+static void check_quantiles(struct check *check)
+{
+    static const float p[] = { 0.5f, 0.95f, 0.99f };
+    struct adc_quantiles quantiles;
+    adc_quantiles_init(&quantiles, p, 3);
+    for (unsigned long i = 0; i < QUANTILE_RUN; ++i) {
+        adc_quantiles_update(&quantiles, (float) rng_range(0, QUANTILE_RANGE - 1));
+    }
+    for (unsigned i = 0; i < 3; ++i) {
+        char context[32];
+        snprintf(context, sizeof(context), "p=%.2f", p[i]);
+        compare(check, lroundf(p[i] * QUANTILE_RANGE), lroundf(adc_quantiles_get(&quantiles, i)), QUANTILE_RANGE / 100, context);
+    }
+}
+
+// input ranges of the attenuations, as in atomvm_adc.c
+static const uint32_t attenuation_max_mv[] = { 1100, 1500, 2200, 3900 };
+
+// every millivolt of every attenuation range; NTC tables only where the
+// thermistor is within NTC_CHECK_MIN..NTC_CHECK_MAX
+static void check_profile(struct check *check, const struct adc_profile *profile, long tolerance, struct adc_lut *lut)
+{
+    bool ntc = profile->type == ADC_PROFILE_NTC_BETA || profile->type == ADC_PROFILE_NTC_STEINHART_HART;
+    for (size_t i = 0; i < sizeof(attenuation_max_mv) / sizeof(attenuation_max_mv[0]); ++i) {
+        uint32_t max_mv = attenuation_max_mv[i];
+        adc_lut_compile(profile, max_mv, lut);
+        for (uint32_t mv = 0; mv <= max_mv; ++mv) {
+            int32_t expected = adc_profile_eval(profile, (float) mv);
+            if (ntc && (expected < NTC_CHECK_MIN || expected > NTC_CHECK_MAX)) {
+                continue;
+            }
+            char context[64];
+            snprintf(context, sizeof(context), "max_mv=%u mv=%u", max_mv, mv);
+            compare(check, expected, adc_lut_lookup(lut, mv), tolerance, context);
+        }
+    }
+}
+
+// typical circuits: a 10k, Beta 3950 thermistor (or its Steinhart-Hart
+// equivalent) against 10k from 3.3 V on either side, a divider, and one and
+// two Li-ion cells behind dividers
+static void check_profiles(struct check *beta_check, struct check *sh_check, struct check *divider_check, struct check *li_ion_check, struct adc_lut *lut)
+{
+    struct adc_profile profile = { .type = ADC_PROFILE_NTC_BETA };
+    profile.ntc.beta = 3950.0f;
+    profile.ntc.r0 = 10000.0f;
+    profile.ntc.t0 = 25.0f;
+    profile.ntc.series = 10000.0f;
+    profile.ntc.supply_mv = 3300.0f;
+    for (int high_side = 0; high_side < 2; ++high_side) {
+        profile.ntc.high_side = high_side;
+        profile.type = ADC_PROFILE_NTC_BETA;
+        check_profile(beta_check, &profile, NTC_TOLERANCE, lut);
+        profile.type = ADC_PROFILE_NTC_STEINHART_HART;
+        profile.ntc.a = 1.009249522e-3f;
+        profile.ntc.b = 2.378405444e-4f;
+        profile.ntc.c = 2.019202697e-7f;
+        check_profile(sh_check, &profile, NTC_TOLERANCE, lut);
+    }
+
+    profile.type = ADC_PROFILE_DIVIDER;
+    profile.divider.r_top = 100000;
+    profile.divider.r_bottom = 47000;
+    check_profile(divider_check, &profile, DIVIDER_TOLERANCE, lut);
+
+    profile.type = ADC_PROFILE_LI_ION;
+    profile.li_ion.cells = 1;
+    profile.li_ion.r_top = 100000;
+    profile.li_ion.r_bottom = 100000;
+    check_profile(li_ion_check, &profile, LI_ION_TOLERANCE, lut);
+    profile.li_ion.cells = 2;
+    profile.li_ion.r_top = 300000;
+    check_profile(li_ion_check, &profile, LI_ION_TOLERANCE, lut);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long seed = 1;
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-s SEED] [-i ITERATIONS]\n", argv[0]);
+            return 2;
+        }
+    }
+    rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    // room for blocks at any alignment
+    static uint16_t a[MAX_BLOCK + 8];
+    static uint16_t b[MAX_BLOCK];
+    static uint16_t c[MAX_BLOCK];
+    static uint8_t frame[ADC_FRAME_HEADER_SIZE + 2 * MAX_BLOCK + ADC_FRAME_TRAILER_SIZE];
+    struct adc_convert_lut *lut = malloc(adc_convert_lut_size(12));
+    struct adc_lut *profile_lut = malloc(adc_lut_size(3900));
+    if (lut == NULL || profile_lut == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    struct check checks[] = {
+        { .name = "convert/linear" },
+        { .name = "convert/lut" },
+        { .name = "reduce/mean" },
+        { .name = "reduce/median" },
+        { .name = "reduce/trimmed_mean" },
+        { .name = "block/minmax" },
+        { .name = "block/fir" },
+        { .name = "smooth/moving_average" },
+        { .name = "smooth/savitzky_golay" },
+        { .name = "quantiles/long_run" },
+        { .name = "profile/ntc_beta" },
+        { .name = "profile/steinhart_hart" },
+        { .name = "profile/divider" },
+        { .name = "profile/li_ion" },
+        { .name = "frame/header" },
+        { .name = "frame/crc32" },
+    };
+    for (unsigned long i = 0; i < iterations; ++i) {
+        check_convert(&checks[0], &checks[1], a, b, lut);
+        check_reduce(&checks[2], &checks[3], &checks[4], a, b, c);
+        check_block(&checks[5], &checks[6], a, b);
+        check_smooth(&checks[7], &checks[8], a, b);
+        check_frame(&checks[14], &checks[15], a, frame);
+    }
+    check_quantiles(&checks[9]);
+    check_profiles(&checks[10], &checks[11], &checks[12], &checks[13], profile_lut);
+    free(lut);
+    free(profile_lut);
+
+    int status = 0;
+    printf("seed=%lu iterations=%lu block=%s\n", seed, iterations, adc_block_impl());
+    printf("%-24s %10s %9s %9s\n", "check", "cases", "max_diff", "tolerance");
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+        printf("%-24s %10lu %9ld %9ld %s\n", checks[i].name, checks[i].cases, checks[i].max_diff, checks[i].tolerance,
+            checks[i].failed ? "FAIL" : "ok");
+        if (checks[i].failed) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,599 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Host simulation of a binary stream sink.  A producer thread stands in for
+// the acquisition task and encodes blocks of a synthetic sine wave into
+// frames with the encoder in nifs/, which are queued in a bounded buffer and
+// written out by a writer thread, as the sink task does on the device.
+// Frames that do not fit in the buffer are dropped, counted and reported in
+// gap records.  With -o, every so many blocks the producer skips half a block
+// of samples, as the acquisition task does when it falls behind, so that
+// blocks are cut short.  With -p, the producer stops in the middle of a
+// block, after so many samples of it, as when a sampler is stopped.  At the
+// end, every sample due must have been either queued or counted lost.
+//
+// Frames are written to the master side of a pseudo terminal, whose slave
+// side is printed on stdout, or, with -u or -t, sent to a port on the
+// loopback interface, batched into datagrams or over a TCP connection, so
+// that a capture tool can be tested without a device, e.g.
+//
+//     adc_sink_sim -r 1000 -b 100 -l /tmp/adc0 &
+//     tools/adc_capture.py /tmp/adc0 --csv samples.csv
+//
+// Usage: adc_sink_sim [-r RATE] [-b BLOCK] [-n FRAMES] [-s SOURCE] [-q BYTES]
+//                     [-l LINK | -u PORT | -t PORT] [-m MTU] [-o BLOCKS]
+//                     [-p SAMPLES]
+//
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include "adc_frame.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_RATE 1000
+#define DEFAULT_BLOCK 100
+#define DEFAULT_SOURCE 34
+#define DEFAULT_BUFFER 16384
+#define DEFAULT_MTU 1500
+#define UDP_OVERHEAD 28
+#define MAX_BLOCK 4096
+#define CHUNK_SIZE 512
+#define BATCH_MS 20
+#define CONNECT_RETRY_MS 1000
+#define DRAIN_TIMEOUT_MS 2000
+#define SIGNAL_HZ 50.0
+#define SIGNAL_MV 1000.0
+#define OFFSET_MV 1650.0
+
+enum mode
+{
+    MODE_PTY,
+    MODE_UDP,
+    MODE_TCP
+};
+
+struct sim
+{
+    enum mode mode;
+    int fd;
+    struct sockaddr_in addr;
+    size_t datagram_size;
+    unsigned rate;
+    size_t block;
+    unsigned long frames;
+    uint16_t source;
+    unsigned long overrun_every;
+    size_t tail;
+
+    // bounded byte ring between the producer and the writer
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    uint8_t *ring;
+    size_t size;
+    size_t head;
+    size_t fill;
+    bool done;
+
+    unsigned long queued;
+    unsigned long gaps;
+    unsigned long dropped;
+    unsigned long long lost_samples;
+    unsigned long long due_samples;
+    unsigned long long queued_samples;
+    unsigned long long bytes;
+    unsigned long sends;
+    unsigned long errors;
+    unsigned long connects;
+};
+
+static volatile sig_atomic_t stopped;
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    stopped = 1;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void ring_put(struct sim *sim, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        sim->ring[(sim->head + sim->fill + i) % sim->size] = data[i];
+    }
+    sim->fill += len;
+}
+
+static void ring_get(struct sim *sim, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        out[i] = sim->ring[(sim->head + i) % sim->size];
+    }
+    sim->head = (sim->head + len) % sim->size;
+    sim->fill -= len;
+}
+
+// like adc_sink_write and adc_sink_write_gap, never blocks the producer
+static bool sim_write(struct sim *sim, const uint8_t *frame, size_t len, bool gap)
+{
+    pthread_mutex_lock(&sim->lock);
+    bool queued = sim->size - sim->fill >= len;
+    if (queued) {
+        ring_put(sim, frame, len);
+        if (gap) {
+            sim->gaps++;
+        } else {
+            sim->queued++;
+        }
+        pthread_cond_signal(&sim->ready);
+    } else {
+        sim->dropped++;
+    }
+    pthread_mutex_unlock(&sim->lock);
+    return queued;
+}
+
+static void count_lost(struct sim *sim, size_t samples)
+{
+    pthread_mutex_lock(&sim->lock);
+    sim->lost_samples += samples;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+// as stream_gap in the sampler
+static void produce_gap(struct sim *sim, struct adc_frame_info *info, struct adc_frame_gap *gap)
+{
+    uint8_t record[ADC_FRAME_GAP_SIZE];
+    info->type = ADC_FRAME_GAP;
+    adc_frame_encode_gap(info, gap, record);
+    if (sim_write(sim, record, sizeof(record), true)) {
+        memset(gap, 0, sizeof(*gap));
+    } else {
+        adc_frame_gap_add_frame(gap, info->sequence, 0, 0);
+    }
+    info->sequence++;
+}
+
+// as stream_block in the sampler: report losses first, and drop the frame
+// if they cannot be reported
+static void produce(struct sim *sim, struct adc_frame_info *info, struct adc_frame_gap *gap, const uint16_t *samples, size_t n, uint8_t *frame)
+{
+    if (adc_frame_gap_pending(gap)) {
+        produce_gap(sim, info, gap);
+    }
+    info->type = ADC_FRAME_SAMPLES;
+    size_t len = adc_frame_encode(info, samples, n, frame);
+    if (adc_frame_gap_pending(gap) || !sim_write(sim, frame, len, false)) {
+        adc_frame_gap_add_frame(gap, info->sequence, n, info->timestamp_us);
+        count_lost(sim, n);
+    } else {
+        pthread_mutex_lock(&sim->lock);
+        sim->queued_samples += n;
+        pthread_mutex_unlock(&sim->lock);
+    }
+    info->sequence++;
+}
+
+static void count_write(struct sim *sim, size_t bytes, bool failed)
+{
+    pthread_mutex_lock(&sim->lock);
+    sim->bytes += bytes;
+    if (bytes > 0) {
+        sim->sends++;
+    }
+    if (failed) {
+        sim->errors++;
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+static void *producer_loop(void *arg)
+{
+    struct sim *sim = (struct sim *) arg;
+    uint16_t *samples = malloc(sim->block * sizeof(uint16_t));
+    uint8_t *frame = malloc(adc_frame_size(sim->block));
+    uint32_t period_us = 1000000 / sim->rate;
+    int64_t block_us = (int64_t) period_us * sim->block;
+    int64_t start_us = now_us();
+    struct adc_frame_info info = {
+        .source = sim->source,
+        .period_us = period_us
+    };
+    struct adc_frame_gap gap = { 0 };
+    unsigned long i;
+
+    for (i = 0; !stopped && (sim->frames == 0 || i < sim->frames); ++i) {
+        int64_t timestamp_us = start_us + (int64_t) i * block_us;
+        // the first sample of the block since the start
+        unsigned long first = i * sim->block;
+        size_t n = sim->block;
+        if (sim->overrun_every > 0 && i % sim->overrun_every == sim->overrun_every - 1) {
+            // the second half of the block is skipped
+            n = sim->block / 2;
+        }
+        for (size_t j = 0; j < n; ++j) {
+            double t = (double) (first + j) * period_us / 1e6;
+            samples[j] = (uint16_t) lround(OFFSET_MV + SIGNAL_MV * sin(2.0 * M_PI * SIGNAL_HZ * t));
+        }
+        // wait until the block would be complete on the device
+        int64_t wait_us = timestamp_us + block_us - now_us();
+        if (wait_us > 0) {
+            usleep(wait_us);
+        }
+        info.timestamp_us = timestamp_us;
+        if (n > 0) {
+            produce(sim, &info, &gap, samples, n, frame);
+        }
+        if (n < sim->block) {
+            adc_frame_gap_add_samples(&gap, sim->block - n, timestamp_us + (int64_t) n * period_us);
+            count_lost(sim, sim->block - n);
+        }
+        sim->due_samples += sim->block;
+    }
+    // as adc_sampler_flush, when the sampler is stopped: the samples of the
+    // block collected so far are sent short, then pending losses reported
+    if (sim->tail > 0) {
+        int64_t timestamp_us = start_us + (int64_t) i * block_us;
+        for (size_t j = 0; j < sim->tail; ++j) {
+            double t = (double) (i * sim->block + j) * period_us / 1e6;
+            samples[j] = (uint16_t) lround(OFFSET_MV + SIGNAL_MV * sin(2.0 * M_PI * SIGNAL_HZ * t));
+        }
+        info.timestamp_us = timestamp_us;
+        produce(sim, &info, &gap, samples, sim->tail, frame);
+        sim->due_samples += sim->tail;
+    }
+    if (adc_frame_gap_pending(&gap)) {
+        produce_gap(sim, &info, &gap);
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    sim->done = true;
+    pthread_cond_signal(&sim->ready);
+    pthread_mutex_unlock(&sim->lock);
+    free(frame);
+    free(samples);
+    return NULL;
+}
+
+// as the TCP sink connects from its task, and drops frames until connected
+static bool tcp_connect(struct sim *sim)
+{
+    if (sim->fd >= 0) {
+        return true;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (connect(fd, (struct sockaddr *) &sim->addr, sizeof(sim->addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sim->fd = fd;
+    pthread_mutex_lock(&sim->lock);
+    sim->connects++;
+    pthread_mutex_unlock(&sim->lock);
+    return true;
+}
+
+static ssize_t port_write(struct sim *sim, const uint8_t *data, size_t len)
+{
+    if (sim->mode == MODE_TCP) {
+        ssize_t ret = send(sim->fd, data, len, MSG_NOSIGNAL);
+        if (ret < 0) {
+            close(sim->fd);
+            sim->fd = -1;
+        }
+        return ret;
+    }
+    // blocks while nobody reads the slave side, as a UART at a low baud
+    // rate would, so that frames back up and get dropped
+    struct pollfd pfd = { .fd = sim->fd, .events = POLLOUT };
+    if (poll(&pfd, 1, 100) <= 0) {
+        return 0;
+    }
+    ssize_t ret = write(sim->fd, data, len);
+    return ret < 0 && (errno == EAGAIN || errno == EINTR) ? 0 : ret;
+}
+
+// pty and TCP: byte streams, written in chunks
+static void stream_loop(struct sim *sim)
+{
+    uint8_t chunk[CHUNK_SIZE];
+
+    for (;;) {
+        if (sim->mode == MODE_TCP && !tcp_connect(sim)) {
+            if (stopped || sim->done) {
+                break;
+            }
+            usleep(CONNECT_RETRY_MS * 1000);
+            continue;
+        }
+        pthread_mutex_lock(&sim->lock);
+        while (sim->fill == 0 && !sim->done) {
+            pthread_cond_wait(&sim->ready, &sim->lock);
+        }
+        if (sim->fill == 0) {
+            pthread_mutex_unlock(&sim->lock);
+            break;
+        }
+        size_t n = sim->fill < CHUNK_SIZE ? sim->fill : CHUNK_SIZE;
+        ring_get(sim, chunk, n);
+        pthread_mutex_unlock(&sim->lock);
+
+        size_t written = 0;
+        while (written < n && !stopped) {
+            ssize_t ret = port_write(sim, chunk + written, n - written);
+            if (ret < 0) {
+                break;
+            }
+            written += ret;
+        }
+        count_write(sim, written, written < n);
+        if (stopped) {
+            break;
+        }
+    }
+}
+
+static void send_datagram(struct sim *sim, const uint8_t *data, size_t len)
+{
+    ssize_t ret = sendto(sim->fd, data, len, 0, (struct sockaddr *) &sim->addr, sizeof(sim->addr));
+    count_write(sim, ret > 0 ? ret : 0, ret != (ssize_t) len);
+}
+
+// UDP: whole frames, batched into datagrams as in the sink task
+static void datagram_loop(struct sim *sim)
+{
+    size_t limit = sim->datagram_size;
+    uint8_t *batch = malloc(limit > adc_frame_size(MAX_BLOCK) ? limit : adc_frame_size(MAX_BLOCK));
+    size_t fill = 0;
+    int64_t batch_start_us = 0;
+
+    while (!stopped) {
+        pthread_mutex_lock(&sim->lock);
+        while (sim->fill == 0 && !sim->done && (fill == 0 || now_us() - batch_start_us < BATCH_MS * 1000)) {
+            if (fill == 0) {
+                pthread_cond_wait(&sim->ready, &sim->lock);
+            } else {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += 1000000;
+                if (deadline.tv_nsec >= 1000000000) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&sim->ready, &sim->lock, &deadline);
+            }
+        }
+        size_t size = 0;
+        if (sim->fill > 0) {
+            // only whole frames are queued
+            uint8_t header[ADC_FRAME_HEADER_SIZE];
+            for (size_t i = 0; i < sizeof(header); ++i) {
+                header[i] = sim->ring[(sim->head + i) % sim->size];
+            }
+            size = adc_frame_length(header);
+        }
+        bool done = sim->done && sim->fill == 0;
+        if (size > 0 && fill > 0 && fill + size > limit) {
+            // send what is batched first; the frame stays queued
+            size = 0;
+        }
+        if (size > 0) {
+            ring_get(sim, batch + fill, size);
+        }
+        pthread_mutex_unlock(&sim->lock);
+
+        if (size == 0) {
+            if (fill > 0) {
+                send_datagram(sim, batch, fill);
+                fill = 0;
+            }
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        if (fill == 0) {
+            batch_start_us = now_us();
+        }
+        fill += size;
+        if (fill >= limit) {
+            send_datagram(sim, batch, fill);
+            fill = 0;
+        }
+    }
+    free(batch);
+}
+
+static void *writer_loop(void *arg)
+{
+    struct sim *sim = (struct sim *) arg;
+    if (sim->mode == MODE_UDP) {
+        datagram_loop(sim);
+    } else {
+        stream_loop(sim);
+    }
+    return NULL;
+}
+
+static int open_pty(const char **slave)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        return -1;
+    }
+    // frames are binary, so no line discipline on either side
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    *slave = ptsname(fd);
+    return *slave != NULL ? fd : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct sim sim = {
+        .mode = MODE_PTY,
+        .fd = -1,
+        .rate = DEFAULT_RATE,
+        .block = DEFAULT_BLOCK,
+        .source = DEFAULT_SOURCE,
+        .size = DEFAULT_BUFFER
+    };
+    const char *link = NULL;
+    unsigned long port = 0;
+    unsigned long mtu = DEFAULT_MTU;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            sim.rate = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            sim.block = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            sim.frames = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sim.source = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            sim.size = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            link = argv[++i];
+        } else if ((strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "-t") == 0) && i + 1 < argc) {
+            sim.mode = argv[i][1] == 'u' ? MODE_UDP : MODE_TCP;
+            port = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mtu = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            sim.overrun_every = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            sim.tail = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-r RATE] [-b BLOCK] [-n FRAMES] [-s SOURCE] [-q BYTES] [-l LINK | -u PORT | -t PORT] [-m MTU] [-o BLOCKS] [-p SAMPLES]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sim.rate < 1 || sim.rate > 1000000 || sim.block < 1 || sim.block > MAX_BLOCK || sim.tail >= sim.block || sim.size < adc_frame_size(sim.block)
+        || (sim.mode != MODE_PTY && (port < 1 || port > 65535)) || mtu < 576 || mtu > 65535) {
+        fprintf(stderr, "invalid rate, block, tail, buffer size, port or MTU\n");
+        return 2;
+    }
+    sim.datagram_size = mtu - UDP_OVERHEAD;
+
+    int slave_fd = -1;
+    if (sim.mode == MODE_PTY) {
+        const char *slave;
+        sim.fd = open_pty(&slave);
+        if (sim.fd < 0) {
+            perror("posix_openpt");
+            return 1;
+        }
+        if (link != NULL) {
+            unlink(link);
+            if (symlink(slave, link) != 0) {
+                perror("symlink");
+                return 1;
+            }
+        }
+        // held open so that frames written before a reader opens the slave
+        // side are kept in the pty, and to see when the reader has caught up
+        slave_fd = open(slave, O_RDONLY | O_NOCTTY);
+        if (slave_fd < 0) {
+            perror(slave);
+            return 1;
+        }
+        printf("%s\n", slave);
+        fflush(stdout);
+    } else {
+        sim.addr.sin_family = AF_INET;
+        sim.addr.sin_port = htons(port);
+        sim.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (sim.mode == MODE_UDP) {
+            sim.fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (sim.fd < 0) {
+                perror("socket");
+                return 1;
+            }
+        }
+    }
+
+    sim.ring = malloc(sim.size);
+    pthread_mutex_init(&sim.lock, NULL);
+    pthread_cond_init(&sim.ready, NULL);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    pthread_t producer;
+    pthread_t writer;
+    pthread_create(&producer, NULL, producer_loop, &sim);
+    pthread_create(&writer, NULL, writer_loop, &sim);
+    pthread_join(producer, NULL);
+    pthread_join(writer, NULL);
+
+    if (slave_fd >= 0) {
+        // the reader gets an error once the master side is closed, even with
+        // data left in the pty, so give it time to read everything
+        int queued = 0;
+        for (int ms = 0; !stopped && ms < DRAIN_TIMEOUT_MS && ioctl(slave_fd, FIONREAD, &queued) == 0 && queued > 0; ms += 10) {
+            usleep(10000);
+        }
+        close(slave_fd);
+    }
+    fprintf(stderr, "frames %lu gaps %lu dropped %lu lost_samples %llu bytes %llu sends %lu errors %lu connects %lu\n",
+        sim.queued, sim.gaps, sim.dropped, sim.lost_samples, sim.bytes, sim.sends, sim.errors, sim.connects);
+    int status = 0;
+    if (sim.queued_samples + sim.lost_samples != sim.due_samples) {
+        fprintf(stderr, "samples due %llu, queued %llu, lost %llu\n", sim.due_samples, sim.queued_samples, sim.lost_samples);
+        status = 1;
+    }
+    if (link != NULL) {
+        unlink(link);
+    }
+    if (sim.fd >= 0) {
+        close(sim.fd);
+    }
+    free(sim.ring);
+    return status;
+}
@@ -0,0 +1,532 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Acquisition task
+//
+// Asynchronous readings and background samplers are executed on a dedicated
+// FreeRTOS task, so that the AtomVM schedulers are never blocked on ADC
+// conversions.  Samplers are woken by a one-shot esp_timer armed for the
+// next sample that is due.  Requests are
+// kept in one queue per priority class, ordered by deadline within a class.
+// Samples are taken in chunks of CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES, and the
+// scheduler re-evaluates which request to run after every chunk, so a long
+// low priority average never holds up a high priority reading for more than
+// a single chunk.
+//
+
+#include "adc_acq.h"
+#include "adc_cal.h"
+#include "adc_sampler.h"
+#include "adc_trace.h"
+
+#include <context.h>
+#include <defaultatoms.h>
+#include <globalcontext.h>
+#include <interop.h>
+#include <memory.h>
+#include <term.h>
+
+// #define ENABLE_TRACE
+#include <trace.h>
+
+#include <esp_adc_cal.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+#include <stdlib.h>
+
+#define TAG "atomvm_adc"
+#define ACQ_TASK_STACK_SIZE 4096
+
+#if CONFIG_AVM_ADC_ACQ_TASK_CORE < 0
+#define ACQ_TASK_CORE tskNO_AFFINITY
+#else
+#define ACQ_TASK_CORE CONFIG_AVM_ADC_ACQ_TASK_CORE
+#endif
+
+static SemaphoreHandle_t task_lock;
+static TaskHandle_t acq_task;
+
+// multiplexer state, protected by hw_lock
+static SemaphoreHandle_t hw_lock;
+static adc_bits_width_t adc1_width = ADC_WIDTH_MAX;
+static adc_channel_t last_channel[ADC_ACQ_UNITS] = {
+    ADC_CHANNEL_MAX,
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    ADC_CHANNEL_MAX
+#endif
+};
+
+// incoming requests, handed over from the schedulers
+static portMUX_TYPE incoming_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct adc_acq_read *incoming;
+static uint32_t incoming_count;
+
+static struct adc_sampler *incoming_samplers;
+
+// per priority run queues and active samplers, only touched by the
+// acquisition task
+static struct adc_acq_read *run_queue[ADC_ACQ_PRIORITY_MAX];
+static uint32_t run_queue_count;
+static struct adc_sampler *samplers;
+static esp_timer_handle_t wake_timer;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct adc_acq_stats stats;
+
+static inline int unit_index(adc_unit_t adc_unit)
+{
+    return adc_unit == ADC_UNIT_1 ? 0 : 1;
+}
+
+static inline int raw_read(const struct adc_acq_channel *ch, esp_err_t *err)
+{
+    if (ch->adc_unit == ADC_UNIT_1) {
+        return adc1_get_raw((adc1_channel_t) ch->channel);
+    }
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    int read_raw = 0;
+    *err = adc2_get_raw((adc2_channel_t) ch->channel, ch->bit_width, &read_raw);
+    return read_raw;
+#else
+    *err = ESP_ERR_INVALID_ARG;
+    return 0;
+#endif
+}
+
+esp_err_t adc_acq_config_width(adc_bits_width_t bit_width)
+{
+    xSemaphoreTake(hw_lock, portMAX_DELAY);
+    esp_err_t err = adc1_config_width(bit_width);
+    adc1_width = err == ESP_OK ? bit_width : ADC_WIDTH_MAX;
+    xSemaphoreGive(hw_lock);
+    return err;
+}
+
+esp_err_t adc_acq_config_atten(const struct adc_acq_channel *ch, adc_atten_t atten)
+{
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(hw_lock, portMAX_DELAY);
+    if (ch->adc_unit == ADC_UNIT_1) {
+        err = adc1_config_channel_atten((adc1_channel_t) ch->channel, atten);
+    }
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (ch->adc_unit == ADC_UNIT_2) {
+        err = adc2_config_channel_atten((adc2_channel_t) ch->channel, atten);
+    }
+#endif
+    xSemaphoreGive(hw_lock);
+    return err;
+}
+
+esp_err_t adc_acq_sample(const struct adc_acq_channel *ch, avm_int_t samples, uint64_t *sum, uint32_t *conversions)
+{
+    esp_err_t err = ESP_OK;
+    uint64_t acc = 0;
+    avm_int_t discard = 0;
+
+    if (UNLIKELY((ch->adc_unit != ADC_UNIT_1 && ch->adc_unit != ADC_UNIT_2) || unit_index(ch->adc_unit) >= ADC_ACQ_UNITS)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(hw_lock, portMAX_DELAY);
+    if (ch->adc_unit == ADC_UNIT_1 && adc1_width != ch->bit_width) {
+        // the adc1 width is global to the unit, so it is reapplied whenever a
+        // channel with a different width is read.  This ensures the
+        // calibration characteristics and reading match the desired bit width
+        // for the channel.
+        err = adc1_config_width(ch->bit_width);
+        adc1_width = err == ESP_OK ? ch->bit_width : ADC_WIDTH_MAX;
+    }
+    if (last_channel[unit_index(ch->adc_unit)] != ch->channel) {
+        discard = ch->discard;
+    }
+    for (avm_int_t i = 0; i < discard && LIKELY(err == ESP_OK); ++i) {
+        raw_read(ch, &err);
+    }
+    for (avm_int_t i = 0; i < samples && LIKELY(err == ESP_OK); ++i) {
+        acc += raw_read(ch, &err);
+    }
+    last_channel[unit_index(ch->adc_unit)] = err == ESP_OK ? ch->channel : ADC_CHANNEL_MAX;
+    xSemaphoreGive(hw_lock);
+
+    *sum += acc;
+    if (conversions != NULL) {
+        *conversions += discard + samples;
+    }
+    return err;
+}
+
+static void run_queue_insert(struct adc_acq_read *read)
+{
+    // earliest deadline first within a priority class; requests without a
+    // deadline (or with equal deadlines) are served in arrival order
+    struct adc_acq_read **pos = &run_queue[read->priority];
+    while (*pos != NULL && (*pos)->deadline_us <= read->deadline_us) {
+        pos = &(*pos)->next;
+    }
+    read->next = *pos;
+    *pos = read;
+    run_queue_count++;
+}
+
+static void drain_incoming(void)
+{
+    portENTER_CRITICAL(&incoming_lock);
+    struct adc_acq_read *read = incoming;
+    incoming = NULL;
+    incoming_count = 0;
+    struct adc_sampler *sampler = incoming_samplers;
+    incoming_samplers = NULL;
+    portEXIT_CRITICAL(&incoming_lock);
+
+    while (sampler != NULL) {
+        struct adc_sampler *next = sampler->next;
+        sampler->next = samplers;
+        samplers = sampler;
+        sampler = next;
+    }
+
+    // incoming is a LIFO stack; restore arrival order before queueing
+    struct adc_acq_read *ordered = NULL;
+    while (read != NULL) {
+        struct adc_acq_read *next = read->next;
+        read->next = ordered;
+        ordered = read;
+        read = next;
+    }
+    while (ordered != NULL) {
+        struct adc_acq_read *next = ordered->next;
+        run_queue_insert(ordered);
+        ordered = next;
+    }
+}
+
+static struct adc_acq_read *run_queue_peek(void)
+{
+    for (int i = 0; i < ADC_ACQ_PRIORITY_MAX; ++i) {
+        if (run_queue[i] != NULL) {
+            return run_queue[i];
+        }
+    }
+    return NULL;
+}
+
+static void run_queue_remove(struct adc_acq_read *read)
+{
+    struct adc_acq_read **pos = &run_queue[read->priority];
+    while (*pos != read) {
+        pos = &(*pos)->next;
+    }
+    *pos = read->next;
+    read->next = NULL;
+    run_queue_count--;
+}
+
+static void send_reply(struct adc_acq_read *read, esp_err_t err)
+{
+    GlobalContext *global = read->global;
+
+    // {adc_reading, Ref, {Raw, Voltage} | {error, Reason}}
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + REF_SIZE + TUPLE_SIZE(2), heap)
+    term result = term_alloc_tuple(2, &heap);
+    if (LIKELY(err == ESP_OK)) {
+        uint32_t adc_reading = (uint32_t) (read->sum / read->samples);
+        term raw = read->raw ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
+        term voltage = UNDEFINED_ATOM;
+        if (read->voltage) {
+            esp_adc_cal_characteristics_t adc_chars;
+            adc_cal_get(read->ch.adc_unit, read->atten, read->ch.bit_width, &adc_chars, NULL);
+            voltage = term_from_int32(esp_adc_cal_raw_to_voltage(adc_reading, &adc_chars));
+        }
+        term_put_tuple_element(result, 0, raw);
+        term_put_tuple_element(result, 1, voltage);
+    } else {
+        term reason = err == ESP_ERR_TIMEOUT ? globalcontext_make_atom(global, ATOM_STR("\x7", "timeout")) : term_from_int(err);
+        term_put_tuple_element(result, 0, ERROR_ATOM);
+        term_put_tuple_element(result, 1, reason);
+    }
+
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, ATOM_STR("\xb", "adc_reading")));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(read->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, result);
+    globalcontext_send_message(global, read->reply_to, msg);
+    END_WITH_STACK_HEAP(heap, global)
+}
+
+static void complete(struct adc_acq_read *read, esp_err_t err)
+{
+    int64_t now = esp_timer_get_time();
+    run_queue_remove(read);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.completed[read->priority]++;
+    if (now > read->deadline_us) {
+        stats.deadline_misses[read->priority]++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    ADC_TRACE(ADC_TRACE_COMPLETE, read->priority, now > read->deadline_us);
+    send_reply(read, err);
+    free(read);
+}
+
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+static int64_t service_samplers(int64_t now)
+{
+    int64_t next_due = INT64_MAX;
+    uint32_t taken = 0;
+    struct adc_sampler **pos = &samplers;
+    while (*pos != NULL) {
+        struct adc_sampler *sampler = *pos;
+        if (sampler->stopping) {
+            *pos = sampler->next;
+            adc_sampler_flush(sampler);
+            adc_sampler_destroy(sampler);
+            continue;
+        }
+        if (sampler->pending != NULL) {
+            // a peek without the lock; a change set meanwhile waits for the next round
+            adc_sampler_apply_config(sampler, now > sampler->next_due_us ? now : sampler->next_due_us);
+        }
+        if (now >= sampler->next_due_us) {
+            if (taken++ == 0) {
+                ADC_TRACE(ADC_TRACE_SAMPLERS_BEGIN, 0, 0);
+            }
+            uint64_t sum = 0;
+            // phase and jitter need the actual time of the conversion
+            int64_t start = sampler->phase != NULL || sampler->jitter != NULL ? esp_timer_get_time() : now;
+            adc_sampler_tick(sampler, start);
+            esp_err_t err = adc_acq_sample(&sampler->ch, sampler->oversample, &sum, NULL);
+            uint64_t sum2 = 0;
+            int64_t start2 = start;
+            if (LIKELY(err == ESP_OK) && sampler->phase != NULL) {
+                // the second channel of a pair, as close after the first as possible
+                start2 = esp_timer_get_time();
+                err = adc_acq_sample(&sampler->ch2, sampler->oversample, &sum2, NULL);
+            }
+            if (LIKELY(err == ESP_OK)) {
+                uint32_t raw = (uint32_t) (sum / sampler->oversample);
+                uint32_t mv = esp_adc_cal_raw_to_voltage(raw, &sampler->adc_chars);
+                if (sampler->phase != NULL) {
+                    uint32_t mv2 = esp_adc_cal_raw_to_voltage((uint32_t) (sum2 / sampler->oversample), &sampler->adc_chars2);
+                    adc_sampler_process_pair(sampler, start, mv, mv2, start2 - start);
+                }
+                adc_sampler_process(sampler, start, raw, mv);
+            } else {
+                adc_sampler_error(sampler, start);
+            }
+            sampler->next_due_us += sampler->period_us;
+            if (sampler->next_due_us <= now) {
+                // overrun; skip the missed periods instead of bursting to catch up
+                ADC_TRACE(ADC_TRACE_SAMPLER_OVERRUN, 0, now - sampler->next_due_us);
+                adc_sampler_overrun(sampler, sampler->next_due_us, (now - sampler->next_due_us) / sampler->period_us + 1);
+                sampler->next_due_us = now + sampler->period_us;
+            }
+        }
+        if (sampler->next_due_us < next_due) {
+            next_due = sampler->next_due_us;
+        }
+        pos = &sampler->next;
+    }
+    if (taken > 0) {
+        ADC_TRACE(ADC_TRACE_SAMPLERS_END, 0, taken);
+    }
+    return next_due;
+}
+#endif
+
+// Block until there is new work, a sampler is due, or timeout ticks have
+// passed; returns false if a sampler is already due, without blocking.
+static bool wait_for_work(int64_t next_due, TickType_t timeout)
+{
+    if (next_due != INT64_MAX) {
+        int64_t delay = next_due - esp_timer_get_time();
+        if (delay <= 0) {
+            return false;
+        }
+        esp_timer_stop(wake_timer);
+        esp_timer_start_once(wake_timer, delay);
+    }
+    ulTaskNotifyTake(pdTRUE, timeout);
+    return true;
+}
+
+static void acq_task_loop(void *arg)
+{
+    UNUSED(arg);
+    struct adc_acq_read *last = NULL;
+    int64_t busy_since = esp_timer_get_time();
+
+    for (;;) {
+        drain_incoming();
+
+        // samplers are serviced between reading chunks, so their timing is
+        // never off by more than one chunk
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+        int64_t next_due = service_samplers(esp_timer_get_time());
+#else
+        int64_t next_due = INT64_MAX;
+#endif
+
+        struct adc_acq_read *read = run_queue_peek();
+        if (read == NULL) {
+            wait_for_work(next_due, portMAX_DELAY);
+            busy_since = esp_timer_get_time();
+            continue;
+        }
+        if (read->priority != ADC_ACQ_PRIORITY_HIGH && esp_timer_get_time() - busy_since >= CONFIG_AVM_ADC_ACQ_BUSY_US) {
+            // background readings give way to lower priority tasks, see Kconfig
+            if (wait_for_work(next_due, 1)) {
+                busy_since = esp_timer_get_time();
+            }
+            continue;
+        }
+        if (last != NULL && last != read) {
+            // the previous request still has chunks left, but something more
+            // urgent arrived in the meantime
+            portENTER_CRITICAL(&stats_lock);
+            stats.preemptions++;
+            portEXIT_CRITICAL(&stats_lock);
+            ADC_TRACE(ADC_TRACE_PREEMPT, read->priority, 0);
+        }
+
+        avm_int_t chunk = read->samples - read->taken;
+        if (chunk > CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES) {
+            chunk = CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES;
+        }
+        ADC_TRACE(ADC_TRACE_CHUNK_BEGIN, read->priority, chunk);
+        esp_err_t err = adc_acq_sample(&read->ch, chunk, &read->sum, NULL);
+        read->taken += chunk;
+        ADC_TRACE(ADC_TRACE_CHUNK_END, err, read->taken);
+
+        if (UNLIKELY(err != ESP_OK) || read->taken >= read->samples) {
+            complete(read, err);
+            last = NULL;
+        } else {
+            last = read;
+        }
+    }
+}
+
+static void wake_timer_callback(void *arg)
+{
+    UNUSED(arg);
+    xTaskNotifyGive(acq_task);
+}
+
+static esp_err_t ensure_task(void)
+{
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(task_lock, portMAX_DELAY);
+    if (acq_task == NULL) {
+        // the task is only created once somebody actually uses async reads
+        // or samplers
+        const esp_timer_create_args_t timer_args = {
+            .callback = wake_timer_callback,
+            .name = "adc_acq"
+        };
+        if (wake_timer == NULL) {
+            err = esp_timer_create(&timer_args, &wake_timer);
+        }
+        if (LIKELY(err == ESP_OK)) {
+            BaseType_t res = xTaskCreatePinnedToCore(acq_task_loop, "adc_acq", ACQ_TASK_STACK_SIZE, NULL,
+                CONFIG_AVM_ADC_ACQ_TASK_PRIORITY, &acq_task, ACQ_TASK_CORE);
+            if (UNLIKELY(res != pdPASS)) {
+                acq_task = NULL;
+                err = ESP_ERR_NO_MEM;
+            }
+        }
+        if (UNLIKELY(err != ESP_OK)) {
+            ESP_LOGE(TAG, "Unable to create acquisition task");
+        }
+    }
+    xSemaphoreGive(task_lock);
+    return err;
+}
+
+esp_err_t adc_acq_submit(struct adc_acq_read *read)
+{
+    esp_err_t err = ensure_task();
+    if (UNLIKELY(err != ESP_OK)) {
+        return err;
+    }
+
+    read->next = NULL;
+    read->taken = 0;
+    read->sum = 0;
+
+    portENTER_CRITICAL(&incoming_lock);
+    read->next = incoming;
+    incoming = read;
+    incoming_count++;
+    portEXIT_CRITICAL(&incoming_lock);
+
+    xTaskNotifyGive(acq_task);
+    return ESP_OK;
+}
+
+esp_err_t adc_acq_sampler_start(struct adc_sampler *sampler)
+{
+    esp_err_t err = ensure_task();
+    if (UNLIKELY(err != ESP_OK)) {
+        return err;
+    }
+
+    sampler->next_due_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&incoming_lock);
+    sampler->next = incoming_samplers;
+    incoming_samplers = sampler;
+    portEXIT_CRITICAL(&incoming_lock);
+
+    xTaskNotifyGive(acq_task);
+    return ESP_OK;
+}
+
+void adc_acq_sampler_stop(struct adc_sampler *sampler)
+{
+    sampler->stopping = true;
+    xTaskNotifyGive(acq_task);
+}
+
+void adc_acq_get_stats(struct adc_acq_stats *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    portENTER_CRITICAL(&incoming_lock);
+    out->pending = run_queue_count + incoming_count;
+    portEXIT_CRITICAL(&incoming_lock);
+}
+
+esp_err_t adc_acq_init(void)
+{
+    hw_lock = xSemaphoreCreateMutex();
+    task_lock = xSemaphoreCreateMutex();
+    if (UNLIKELY(hw_lock == NULL || task_lock == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_ACQ_H__
+#define __ADC_ACQ_H__
+
+#include <globalcontext.h>
+#include <term.h>
+
+#include <driver/adc.h>
+#include <sdkconfig.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    ADC_ACQ_PRIORITY_HIGH = 0,
+    ADC_ACQ_PRIORITY_NORMAL,
+    ADC_ACQ_PRIORITY_LOW,
+    ADC_ACQ_PRIORITY_MAX
+} adc_acq_priority_t;
+
+#define ADC_ACQ_NO_DEADLINE INT64_MAX
+
+// number of ADC units that can be used, and so of per unit state
+#ifdef CONFIG_AVM_ADC2_ENABLE
+#define ADC_ACQ_UNITS 2
+#else
+#define ADC_ACQ_UNITS 1
+#endif
+
+//
+// A channel as seen by the sampling loop.  `discard' is the number of
+// settling conversions thrown away whenever the multiplexer has to switch
+// to this channel from a different one.
+//
+struct adc_acq_channel
+{
+    adc_unit_t adc_unit;
+    adc_channel_t channel;
+    adc_bits_width_t bit_width;
+    avm_int_t discard;
+};
+
+//
+// An asynchronous reading request.  Ownership passes to the acquisition task
+// on a successful adc_acq_submit; the task frees the request once the reply
+// has been sent to reply_to.
+//
+struct adc_acq_read
+{
+    struct adc_acq_read *next;
+    GlobalContext *global;
+    int32_t reply_to;
+    uint64_t ref_ticks;
+    struct adc_acq_channel ch;
+    adc_atten_t atten;
+    avm_int_t samples;
+    avm_int_t taken;
+    uint64_t sum;
+    bool raw;
+    bool voltage;
+    adc_acq_priority_t priority;
+    int64_t deadline_us;
+};
+
+struct adc_acq_stats
+{
+    uint32_t completed[ADC_ACQ_PRIORITY_MAX];
+    uint32_t deadline_misses[ADC_ACQ_PRIORITY_MAX];
+    uint32_t preemptions;
+    uint32_t pending;
+};
+
+struct adc_sampler;
+
+esp_err_t adc_acq_init(void);
+esp_err_t adc_acq_submit(struct adc_acq_read *read);
+void adc_acq_get_stats(struct adc_acq_stats *stats);
+
+esp_err_t adc_acq_config_width(adc_bits_width_t bit_width);
+
+//
+// Set the attenuation of a channel, without interrupting conversions on the
+// unit that are in progress.
+//
+esp_err_t adc_acq_config_atten(const struct adc_acq_channel *ch, adc_atten_t atten);
+
+//
+// Hand a sampler over to the acquisition task, which services it until it
+// is stopped.  After adc_acq_sampler_stop the sampler must not be touched
+// anymore; it is destroyed by the acquisition task.
+//
+esp_err_t adc_acq_sampler_start(struct adc_sampler *sampler);
+void adc_acq_sampler_stop(struct adc_sampler *sampler);
+
+//
+// Take `samples' raw conversions from a channel, adding them to *sum.  If the
+// previous conversion on the same unit was on another channel, ch->discard
+// settling conversions are taken first.  The total number of conversions,
+// including discarded ones, is added to *conversions if it is not NULL.
+//
+// The ADC hardware lock is held for the duration of the call, so callers
+// should keep `samples' small when other readers may be waiting.
+//
+esp_err_t adc_acq_sample(const struct adc_acq_channel *ch, avm_int_t samples, uint64_t *sum, uint32_t *conversions);
+
+#endif
@@ -0,0 +1,266 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_block.h"
+
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+
+#if defined(CONFIG_AVM_ADC_BLOCK_PIE)
+#define ADC_BLOCK_PIE
+#elif defined(__SSE2__)
+#define ADC_BLOCK_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define ADC_BLOCK_NEON
+#include <arm_neon.h>
+#endif
+
+static void minmax_scalar(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (samples[i] < *min) {
+            *min = samples[i];
+        }
+        if (samples[i] > *max) {
+            *max = samples[i];
+        }
+    }
+}
+
+static inline uint16_t clamp_sample(int32_t value)
+{
+    return value < 0 ? 0 : (value > UINT16_MAX ? UINT16_MAX : (uint16_t) value);
+}
+
+static void fir_scalar(const uint16_t *in, uint16_t *out, size_t outputs, const int16_t *coeffs, unsigned taps, unsigned shift)
+{
+    int32_t round = 1 << (shift - 1);
+    for (size_t i = 0; i < outputs; ++i) {
+        int32_t acc = 0;
+        for (unsigned j = 0; j < taps; ++j) {
+            acc += coeffs[j] * (int32_t) in[i + j];
+        }
+        out[i] = clamp_sample((acc + round) >> shift);
+    }
+}
+
+#if defined(ADC_BLOCK_SSE2)
+
+const char *adc_block_impl(void)
+{
+    return "sse2";
+}
+
+void adc_block_minmax(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max)
+{
+    *min = samples[0];
+    *max = samples[0];
+    size_t i = 0;
+    if (n >= 8) {
+        // SSE2 only compares signed 16-bit lanes, so samples are biased
+        const __m128i bias = _mm_set1_epi16((short) 0x8000);
+        __m128i vmin = _mm_xor_si128(_mm_loadu_si128((const __m128i *) samples), bias);
+        __m128i vmax = vmin;
+        for (i = 8; i + 8 <= n; i += 8) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (samples + i)), bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+        }
+        uint16_t lanes[8];
+        _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmin, bias));
+        minmax_scalar(lanes, 8, min, max);
+        _mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmax, bias));
+        minmax_scalar(lanes, 8, min, max);
+    }
+    minmax_scalar(samples + i, n - i, min, max);
+}
+
+void adc_block_fir(const uint16_t *in, uint16_t *out, size_t n, const int16_t *coeffs, unsigned taps, unsigned shift)
+{
+    if (n < taps) {
+        return;
+    }
+    size_t outputs = n - taps + 1;
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+    size_t i = 0;
+    for (; i + 8 <= outputs; i += 8) {
+        __m128i acc0 = round;
+        __m128i acc1 = round;
+        for (unsigned j = 0; j < taps; ++j) {
+            __m128i v = _mm_loadu_si128((const __m128i *) (in + i + j));
+            __m128i c = _mm_set1_epi16(coeffs[j]);
+            __m128i lo = _mm_mullo_epi16(v, c);
+            __m128i hi = _mm_mulhi_epi16(v, c);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(lo, hi));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(lo, hi));
+        }
+        acc0 = _mm_sub_epi32(_mm_sra_epi32(acc0, count), bias32);
+        acc1 = _mm_sub_epi32(_mm_sra_epi32(acc1, count), bias32);
+        // signed saturation of the biased values clamps to 0..65535
+        __m128i packed = _mm_xor_si128(_mm_packs_epi32(acc0, acc1), bias16);
+        _mm_storeu_si128((__m128i *) (out + i), packed);
+    }
+    fir_scalar(in + i, out + i, outputs - i, coeffs, taps, shift);
+}
+
+#elif defined(ADC_BLOCK_NEON)
+
+const char *adc_block_impl(void)
+{
+    return "neon";
+}
+
+void adc_block_minmax(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max)
+{
+    *min = samples[0];
+    *max = samples[0];
+    size_t i = 0;
+    if (n >= 8) {
+        uint16x8_t vmin = vld1q_u16(samples);
+        uint16x8_t vmax = vmin;
+        for (i = 8; i + 8 <= n; i += 8) {
+            uint16x8_t v = vld1q_u16(samples + i);
+            vmin = vminq_u16(vmin, v);
+            vmax = vmaxq_u16(vmax, v);
+        }
+        *min = vminvq_u16(vmin);
+        *max = vmaxvq_u16(vmax);
+    }
+    minmax_scalar(samples + i, n - i, min, max);
+}
+
+void adc_block_fir(const uint16_t *in, uint16_t *out, size_t n, const int16_t *coeffs, unsigned taps, unsigned shift)
+{
+    if (n < taps) {
+        return;
+    }
+    size_t outputs = n - taps + 1;
+    const int32x4_t round = vdupq_n_s32(1 << (shift - 1));
+    const int32x4_t count = vdupq_n_s32(-(int32_t) shift);
+    size_t i = 0;
+    for (; i + 8 <= outputs; i += 8) {
+        int32x4_t acc0 = round;
+        int32x4_t acc1 = round;
+        for (unsigned j = 0; j < taps; ++j) {
+            int16x8_t v = vreinterpretq_s16_u16(vld1q_u16(in + i + j));
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(v), coeffs[j]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(v), coeffs[j]);
+        }
+        // arithmetic shift right, then unsigned saturation to 0..65535
+        uint16x4_t lo = vqmovun_s32(vshlq_s32(acc0, count));
+        uint16x4_t hi = vqmovun_s32(vshlq_s32(acc1, count));
+        vst1q_u16(out + i, vcombine_u16(lo, hi));
+    }
+    fir_scalar(in + i, out + i, outputs - i, coeffs, taps, shift);
+}
+
+#elif defined(ADC_BLOCK_PIE)
+
+//
+// The PIE loops work on 16-byte aligned vectors; unaligned heads and tails
+// are handled in C.  There is no PIE FIR: sliding windows need
+// unaligned loads, and the plain C version is used.
+//
+
+#define PIE_ALIGN 16
+static const uint16_t pie_bias[8] __attribute__((aligned(PIE_ALIGN))) = { 0x8000, 0x8000, 0x8000, 0x8000, 0x8000, 0x8000, 0x8000, 0x8000 };
+
+const char *adc_block_impl(void)
+{
+    return "pie";
+}
+
+static size_t unaligned_head(const uint16_t *samples, size_t n)
+{
+    size_t head = ((PIE_ALIGN - ((uintptr_t) samples & (PIE_ALIGN - 1))) & (PIE_ALIGN - 1)) / sizeof(uint16_t);
+    return head < n ? head : n;
+}
+
+void adc_block_minmax(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max)
+{
+    *min = samples[0];
+    *max = samples[0];
+    size_t head = unaligned_head(samples, n);
+    minmax_scalar(samples, head, min, max);
+    size_t vectors = (n - head) / 8;
+    if (vectors > 0) {
+        // PIE only compares signed 16-bit lanes, so samples are biased
+        uint16_t lanes[16] __attribute__((aligned(PIE_ALIGN)));
+        const uint16_t *p = samples + head;
+        uint16_t *out = lanes;
+        size_t count = vectors - 1;
+        __asm__ volatile(
+            "ee.vld.128.ip q4, %[bias], 0\n"
+            "ee.vld.128.ip q2, %[p], 16\n"
+            "ee.xorq q2, q2, q4\n"
+            "ee.orq q3, q2, q2\n"
+            "beqz %[count], 2f\n"
+            "1:\n"
+            "ee.vld.128.ip q0, %[p], 16\n"
+            "addi %[count], %[count], -1\n"
+            "ee.xorq q0, q0, q4\n"
+            "ee.vmin.s16 q2, q2, q0\n"
+            "ee.vmax.s16 q3, q3, q0\n"
+            "bnez %[count], 1b\n"
+            "2:\n"
+            "ee.xorq q2, q2, q4\n"
+            "ee.xorq q3, q3, q4\n"
+            "ee.vst.128.ip q2, %[out], 16\n"
+            "ee.vst.128.ip q3, %[out], 16\n"
+            : [p] "+r"(p), [count] "+r"(count), [out] "+r"(out)
+            : [bias] "r"(pie_bias)
+            : "memory");
+        minmax_scalar(lanes, 16, min, max);
+    }
+    size_t tail = head + vectors * 8;
+    minmax_scalar(samples + tail, n - tail, min, max);
+}
+
+void adc_block_fir(const uint16_t *in, uint16_t *out, size_t n, const int16_t *coeffs, unsigned taps, unsigned shift)
+{
+    if (n >= taps) {
+        fir_scalar(in, out, n - taps + 1, coeffs, taps, shift);
+    }
+}
+
+#else
+
+const char *adc_block_impl(void)
+{
+    return "scalar";
+}
+
+void adc_block_minmax(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max)
+{
+    *min = samples[0];
+    *max = samples[0];
+    minmax_scalar(samples, n, min, max);
+}
+
+void adc_block_fir(const uint16_t *in, uint16_t *out, size_t n, const int16_t *coeffs, unsigned taps, unsigned shift)
+{
+    if (n >= taps) {
+        fir_scalar(in, out, n - taps + 1, coeffs, taps, shift);
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_BLOCK_H__
+#define __ADC_BLOCK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Vectorized kernels over blocks of 16-bit samples.  The implementation is
+// chosen at build time: ESP32-S3 PIE instructions when
+// CONFIG_AVM_ADC_BLOCK_PIE is set, SSE2 or NEON (AArch64) on the host, and
+// plain C otherwise.  Every implementation gives the same results.
+//
+
+//
+// Name of the implementation, e.g. "sse2".
+//
+const char *adc_block_impl(void);
+
+//
+// Smallest and largest of n > 0 samples.
+//
+void adc_block_minmax(const uint16_t *samples, size_t n, uint16_t *min, uint16_t *max);
+
+//
+// FIR filter over the n - taps + 1 windows that fit in the block:
+//
+//     out[i] = (sum(coeffs[j] * in[i + j]) + 2^(shift - 1)) >> shift
+//
+// clamped to 0..65535.  Samples must be below 16384, and the sum of the
+// absolute values of the coefficients at most 65536, so that sums fit in 32
+// bits.  shift must be between 1 and 30.
+//
+void adc_block_fir(const uint16_t *in, uint16_t *out, size_t n, const int16_t *coeffs, unsigned taps, unsigned shift);
+
+#endif
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_cal.h"
+#include "adc_acq.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "atomvm_adc"
+#define DEFAULT_VREF 1100
+#define CAL_TASK_STACK_SIZE 3072
+
+struct cal_entry
+{
+    bool ready;
+    esp_adc_cal_value_t val_type;
+    esp_adc_cal_characteristics_t chars;
+};
+
+struct cal_job
+{
+    size_t n;
+    struct adc_cal_key keys[];
+};
+
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct cal_entry cache[ADC_ACQ_UNITS][ADC_ATTEN_MAX][ADC_WIDTH_MAX];
+
+static struct cal_entry *entry_for(adc_unit_t adc_unit, adc_atten_t atten, adc_bits_width_t bit_width)
+{
+    int unit = adc_unit == ADC_UNIT_1 ? 0 : 1;
+    if ((adc_unit != ADC_UNIT_1 && adc_unit != ADC_UNIT_2) || unit >= ADC_ACQ_UNITS || atten >= ADC_ATTEN_MAX || bit_width >= ADC_WIDTH_MAX) {
+        return NULL;
+    }
+    return &cache[unit][atten][bit_width];
+}
+
+void adc_cal_get(adc_unit_t adc_unit, adc_atten_t atten, adc_bits_width_t bit_width, esp_adc_cal_characteristics_t *chars, esp_adc_cal_value_t *val_type)
+{
+    struct cal_entry *entry = entry_for(adc_unit, atten, bit_width);
+    bool ready = false;
+    esp_adc_cal_value_t type = ESP_ADC_CAL_VAL_DEFAULT_VREF;
+    if (entry != NULL) {
+        portENTER_CRITICAL(&cache_lock);
+        ready = entry->ready;
+        if (ready) {
+            *chars = entry->chars;
+            type = entry->val_type;
+        }
+        portEXIT_CRITICAL(&cache_lock);
+    }
+    if (!ready) {
+        // concurrent misses on the same key compute identical values, so
+        // whichever is stored last does not matter
+        type = esp_adc_cal_characterize(adc_unit, atten, bit_width, DEFAULT_VREF, chars);
+        if (entry != NULL) {
+            portENTER_CRITICAL(&cache_lock);
+            entry->chars = *chars;
+            entry->val_type = type;
+            entry->ready = true;
+            portEXIT_CRITICAL(&cache_lock);
+        }
+    }
+    if (val_type != NULL) {
+        *val_type = type;
+    }
+}
+
+static void prepare_keys(const struct adc_cal_key *keys, size_t n)
+{
+    esp_adc_cal_characteristics_t chars;
+    for (size_t i = 0; i < n; ++i) {
+        adc_cal_get(keys[i].adc_unit, keys[i].atten, keys[i].bit_width, &chars, NULL);
+    }
+}
+
+#ifndef CONFIG_FREERTOS_UNICORE
+static void cal_task(void *arg)
+{
+    struct cal_job *job = (struct cal_job *) arg;
+    prepare_keys(job->keys, job->n);
+    free(job);
+    vTaskDelete(NULL);
+}
+#endif
+
+esp_err_t adc_cal_prepare(const struct adc_cal_key *keys, size_t n)
+{
+#ifdef CONFIG_FREERTOS_UNICORE
+    prepare_keys(keys, n);
+    return ESP_OK;
+#else
+    struct cal_job *job = malloc(sizeof(struct cal_job) + n * sizeof(struct adc_cal_key));
+    if (job == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    job->n = n;
+    memcpy(job->keys, keys, n * sizeof(struct adc_cal_key));
+    BaseType_t other_core = xPortGetCoreID() == 0 ? 1 : 0;
+    if (xTaskCreatePinnedToCore(cal_task, "adc_cal", CAL_TASK_STACK_SIZE, job, CONFIG_AVM_ADC_ACQ_TASK_PRIORITY, NULL, other_core) != pdPASS) {
+        ESP_LOGE(TAG, "Unable to create calibration task");
+        free(job);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_CAL_H__
+#define __ADC_CAL_H__
+
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+#include <stddef.h>
+
+//
+// Cache of calibration characteristics, one entry per unit, attenuation and
+// bit width.  Characterizing reads the calibration eFuses, so entries are
+// only computed once, either on first use or ahead of time by
+// adc_cal_prepare.
+//
+
+struct adc_cal_key
+{
+    adc_unit_t adc_unit;
+    adc_atten_t atten;
+    adc_bits_width_t bit_width;
+};
+
+//
+// Copy the characteristics for a key into chars, computing them if needed.
+// val_type, if not NULL, is set to the source of the calibration.
+//
+void adc_cal_get(adc_unit_t adc_unit, adc_atten_t atten, adc_bits_width_t bit_width, esp_adc_cal_characteristics_t *chars, esp_adc_cal_value_t *val_type);
+
+//
+// Compute the characteristics for n keys in the background, on the core the
+// caller is not running on.  On single core targets they are computed
+// before returning.
+//
+esp_err_t adc_cal_prepare(const struct adc_cal_key *keys, size_t n);
+
+#endif
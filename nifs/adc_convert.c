@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_convert.h"
+
+void adc_convert_linear_block(const struct adc_convert_linear *linear, const uint16_t *raw, uint16_t *mv, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        mv[i] = adc_convert_linear_to_mv(linear, raw[i]);
+    }
+}
+
+size_t adc_convert_lut_size(unsigned bit_width)
+{
+    return sizeof(struct adc_convert_lut) + ((size_t) 1 << bit_width) * sizeof(uint16_t);
+}
+
+void adc_convert_lut_build(struct adc_convert_lut *lut, unsigned bit_width, adc_convert_fun_t convert, const void *arg)
+{
+    lut->entries = 1 << bit_width;
+    for (uint32_t raw = 0; raw < lut->entries; ++raw) {
+        uint32_t mv = convert(raw, arg);
+        lut->mv[raw] = mv > UINT16_MAX ? UINT16_MAX : mv;
+    }
+}
+
+void adc_convert_lut_block(const struct adc_convert_lut *lut, const uint16_t *raw, uint16_t *mv, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        mv[i] = adc_convert_lut_to_mv(lut, raw[i]);
+    }
+}
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_CONVERT_H__
+#define __ADC_CONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Conversion of raw readings to millivolts, in blocks.
+//
+// The linear conversion is the one esp_adc_cal_raw_to_voltage applies to
+// the characteristics it computes: readings are scaled to 12 bits, and
+// mv = (coeff_a * raw + 2^15) / 2^16 + coeff_b.  The additional low-voltage
+// correction the ESP32 applies at 11 dB is not reproduced.
+//
+// A lookup table has one entry per raw value, built from any conversion
+// function, e.g. from esp_adc_cal_raw_to_voltage itself on the device.
+//
+
+struct adc_convert_linear
+{
+    uint32_t coeff_a;
+    uint32_t coeff_b;
+    // number of bits below 12 of the readings
+    uint8_t shift;
+};
+
+static inline uint32_t adc_convert_linear_to_mv(const struct adc_convert_linear *linear, uint32_t raw)
+{
+    return ((linear->coeff_a * (raw << linear->shift) + (1 << 15)) >> 16) + linear->coeff_b;
+}
+
+void adc_convert_linear_block(const struct adc_convert_linear *linear, const uint16_t *raw, uint16_t *mv, size_t n);
+
+struct adc_convert_lut
+{
+    uint32_t entries;
+    uint16_t mv[];
+};
+
+typedef uint32_t (*adc_convert_fun_t)(uint32_t raw, const void *arg);
+
+//
+// Size of a table for readings of bit_width bits.
+//
+size_t adc_convert_lut_size(unsigned bit_width);
+void adc_convert_lut_build(struct adc_convert_lut *lut, unsigned bit_width, adc_convert_fun_t convert, const void *arg);
+
+static inline uint32_t adc_convert_lut_to_mv(const struct adc_convert_lut *lut, uint32_t raw)
+{
+    return lut->mv[raw < lut->entries ? raw : lut->entries - 1];
+}
+
+void adc_convert_lut_block(const struct adc_convert_lut *lut, const uint16_t *raw, uint16_t *mv, size_t n);
+
+#endif
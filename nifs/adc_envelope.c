@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_envelope.h"
+
+#include <math.h>
+#include <string.h>
+
+#define Q16_ONE 65536
+
+// one pole smoothing coefficient for a time constant, in Q16
+static int32_t time_constant_coeff(int64_t period_us, int64_t tau_us)
+{
+    if (tau_us <= 0) {
+        return Q16_ONE;
+    }
+    int32_t coeff = (int32_t) lroundf((1.0f - expf(-(float) period_us / (float) tau_us)) * Q16_ONE);
+    return coeff < 1 ? 1 : coeff;
+}
+
+void adc_envelope_init(struct adc_envelope *env, int64_t period_us, int64_t attack_us, int64_t decay_us,
+    int32_t center_mv, uint32_t threshold_mv, int64_t separation_us)
+{
+    memset(env, 0, sizeof(struct adc_envelope));
+    env->tracking_center = center_mv == ADC_ENVELOPE_AUTO_CENTER;
+    env->center = env->tracking_center ? 0 : (int64_t) center_mv << 16;
+    env->attack = time_constant_coeff(period_us, attack_us);
+    env->decay = time_constant_coeff(period_us, decay_us);
+    env->threshold = (int64_t) threshold_mv << 16;
+    env->separation_us = separation_us;
+}
+
+bool adc_envelope_update(struct adc_envelope *env, int64_t timestamp_us, uint32_t mv, struct adc_peak *peak)
+{
+    int64_t x = (int64_t) mv << 16;
+    if (!env->initialized) {
+        if (env->tracking_center) {
+            env->center = x;
+        }
+        env->initialized = true;
+    } else if (env->tracking_center) {
+        env->center += (x - env->center) >> ADC_ENVELOPE_DC_SHIFT;
+    }
+
+    int64_t rectified = x - env->center;
+    if (rectified < 0) {
+        rectified = -rectified;
+    }
+    bool rising = rectified > env->envelope;
+    int32_t coeff = rising ? env->attack : env->decay;
+    env->envelope += (coeff * (rectified - env->envelope)) >> 16;
+
+    bool confirmed = false;
+    if (env->candidate && timestamp_us - env->candidate_us >= env->separation_us) {
+        // nothing higher followed the candidate within the separation
+        peak->timestamp_us = env->candidate_us;
+        peak->amplitude_mv = (uint32_t) ((env->candidate_value + (Q16_ONE / 2)) >> 16);
+        env->candidate = false;
+        confirmed = true;
+    }
+    // only a rising envelope can make a new local maximum, which keeps the
+    // decaying tail of a peak from being reported as another one
+    if (rising && env->envelope >= env->threshold && (!env->candidate || env->envelope > env->candidate_value)) {
+        env->candidate = true;
+        env->candidate_us = timestamp_us;
+        env->candidate_value = env->envelope;
+    }
+    return confirmed;
+}
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_ENVELOPE_H__
+#define __ADC_ENVELOPE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Amplitude envelope and peak detector.  Samples are rectified around a
+// center voltage (fixed, or tracked as the signal's DC level), and the
+// envelope follows the rectified signal with separate attack and decay
+// time constants.  Peaks are local maxima of the envelope above a threshold,
+// at least a minimum separation apart.  State is in Q16 millivolts.
+//
+
+#define ADC_ENVELOPE_AUTO_CENTER -1
+// time constant of the DC tracker, as a power of two number of samples
+#define ADC_ENVELOPE_DC_SHIFT 10
+
+struct adc_envelope
+{
+    bool initialized;
+    bool tracking_center;
+    int64_t center;
+    int64_t envelope;
+    int32_t attack;
+    int32_t decay;
+    int64_t threshold;
+    int64_t separation_us;
+
+    // current candidate peak, if any
+    bool candidate;
+    int64_t candidate_us;
+    int64_t candidate_value;
+};
+
+struct adc_peak
+{
+    int64_t timestamp_us;
+    uint32_t amplitude_mv;
+};
+
+//
+// Set up an envelope for samples taken every period_us.  Time constants are
+// in microseconds, center and threshold in mV; center may be
+// ADC_ENVELOPE_AUTO_CENTER.
+//
+void adc_envelope_init(struct adc_envelope *env, int64_t period_us, int64_t attack_us, int64_t decay_us,
+    int32_t center_mv, uint32_t threshold_mv, int64_t separation_us);
+
+//
+// Update the envelope with a sample; returns true, and fills in peak, when
+// a peak has been confirmed.  Peaks are confirmed separation_us after they
+// occurred.
+//
+bool adc_envelope_update(struct adc_envelope *env, int64_t timestamp_us, uint32_t mv, struct adc_peak *peak);
+
+#endif
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_filter.h"
+
+#include <string.h>
+
+// time constant of the residual variance estimate of the alpha-beta filter,
+// as a power of two number of samples
+#define RESIDUAL_VARIANCE_SHIFT 5
+
+void adc_filter_init_kalman(struct adc_filter *filter, int64_t q, int64_t r)
+{
+    memset(filter, 0, sizeof(struct adc_filter));
+    filter->type = ADC_FILTER_KALMAN;
+    filter->q = q;
+    filter->r = r > 0 ? r : 1;
+}
+
+void adc_filter_init_alpha_beta(struct adc_filter *filter, int32_t alpha, int32_t beta)
+{
+    memset(filter, 0, sizeof(struct adc_filter));
+    filter->type = ADC_FILTER_ALPHA_BETA;
+    filter->alpha = alpha;
+    filter->beta = beta;
+}
+
+static void kalman_update(struct adc_filter *filter, int64_t z)
+{
+    // predict: the state is modelled as constant, with process noise q
+    int64_t p = filter->p + filter->q;
+    // update: k = p / (p + r)
+    int64_t k = (p << 16) / (p + filter->r);
+    filter->x += (k * (z - filter->x)) >> 16;
+    filter->p = ((ADC_FILTER_ONE - k) * p) >> 16;
+}
+
+static void alpha_beta_update(struct adc_filter *filter, int64_t z)
+{
+    int64_t predicted = filter->x + filter->v;
+    int64_t residual = z - predicted;
+    filter->x = predicted + ((filter->alpha * residual) >> 16);
+    filter->v += (filter->beta * residual) >> 16;
+
+    // bound the residual so its square stays well within 64 bits
+    if (residual > ((int64_t) 1 << 30)) {
+        residual = (int64_t) 1 << 30;
+    } else if (residual < -((int64_t) 1 << 30)) {
+        residual = -((int64_t) 1 << 30);
+    }
+    int64_t square = (residual * residual) >> 16;
+    filter->p += (square - filter->p) >> RESIDUAL_VARIANCE_SHIFT;
+}
+
+void adc_filter_update(struct adc_filter *filter, int32_t mv)
+{
+    int64_t z = (int64_t) mv << 16;
+    if (!filter->initialized) {
+        filter->x = z;
+        filter->v = 0;
+        filter->p = filter->type == ADC_FILTER_KALMAN ? filter->r : 0;
+        filter->initialized = true;
+        return;
+    }
+    if (filter->type == ADC_FILTER_KALMAN) {
+        kalman_update(filter, z);
+    } else {
+        alpha_beta_update(filter, z);
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_FILTER_H__
+#define __ADC_FILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Tracking filters for slowly varying signals.  All state is kept in Q16
+// fixed point (1.0 == 65536), in millivolts.
+//
+
+#define ADC_FILTER_ONE 65536
+
+typedef enum
+{
+    ADC_FILTER_KALMAN,
+    ADC_FILTER_ALPHA_BETA
+} adc_filter_type_t;
+
+struct adc_filter
+{
+    adc_filter_type_t type;
+    bool initialized;
+    // estimate, mV
+    int64_t x;
+    // rate of change, mV per sample (alpha-beta only)
+    int64_t v;
+    // estimate variance (Kalman) or residual variance (alpha-beta), mV^2
+    int64_t p;
+    // process and measurement noise variances, mV^2 (Kalman only)
+    int64_t q;
+    int64_t r;
+    // gains (alpha-beta only)
+    int32_t alpha;
+    int32_t beta;
+};
+
+void adc_filter_init_kalman(struct adc_filter *filter, int64_t q, int64_t r);
+void adc_filter_init_alpha_beta(struct adc_filter *filter, int32_t alpha, int32_t beta);
+void adc_filter_update(struct adc_filter *filter, int32_t mv);
+
+#endif
@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_frame.h"
+
+#include <string.h>
+
+// CRC-32 of every nibble, reflected polynomial 0xEDB88320; two lookups per
+// byte keep the table small enough for flash
+static const uint32_t crc32_nibbles[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t adc_frame_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc32_nibbles[crc & 0xf];
+        crc = (crc >> 4) ^ crc32_nibbles[crc & 0xf];
+    }
+    return ~crc;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static inline void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, v);
+    put_u32(p + 4, v >> 32);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void encode_header(const struct adc_frame_info *info, uint32_t samples, uint32_t length, uint8_t header[ADC_FRAME_HEADER_SIZE])
+{
+    memcpy(header, ADC_FRAME_MAGIC, 4);
+    header[4] = ADC_FRAME_VERSION;
+    header[5] = info->type;
+    put_u16(header + 6, info->source);
+    put_u32(header + 8, info->sequence);
+    put_u32(header + 12, samples);
+    put_u32(header + 16, length);
+    put_u64(header + 20, info->timestamp_us);
+    put_u32(header + 28, info->period_us);
+}
+
+void adc_frame_encode_header(const struct adc_frame_info *info, size_t n, uint8_t header[ADC_FRAME_HEADER_SIZE])
+{
+    encode_header(info, n, n * sizeof(uint16_t), header);
+}
+
+void adc_frame_encode_trailer(const uint8_t header[ADC_FRAME_HEADER_SIZE], const uint16_t *samples, size_t n, uint8_t trailer[ADC_FRAME_TRAILER_SIZE])
+{
+    uint32_t crc = adc_frame_crc32(0, header + 4, ADC_FRAME_HEADER_SIZE - 4);
+    put_u32(trailer, adc_frame_crc32(crc, (const uint8_t *) samples, n * sizeof(uint16_t)));
+}
+
+size_t adc_frame_encode(const struct adc_frame_info *info, const uint16_t *samples, size_t n, uint8_t *out)
+{
+    adc_frame_encode_header(info, n, out);
+    uint8_t *payload = out + ADC_FRAME_HEADER_SIZE;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(payload, samples, n * sizeof(uint16_t));
+#else
+    for (size_t i = 0; i < n; ++i) {
+        put_u16(payload + 2 * i, samples[i]);
+    }
+#endif
+    size_t end = ADC_FRAME_HEADER_SIZE + n * sizeof(uint16_t);
+    put_u32(out + end, adc_frame_crc32(0, out + 4, end - 4));
+    return end + ADC_FRAME_TRAILER_SIZE;
+}
+
+size_t adc_frame_length(const uint8_t header[ADC_FRAME_HEADER_SIZE])
+{
+    if (memcmp(header, ADC_FRAME_MAGIC, 4) != 0 || header[4] != ADC_FRAME_VERSION) {
+        return 0;
+    }
+    return ADC_FRAME_HEADER_SIZE + get_u32(header + 16) + ADC_FRAME_TRAILER_SIZE;
+}
+
+void adc_frame_encode_gap(const struct adc_frame_info *info, const struct adc_frame_gap *gap, uint8_t out[ADC_FRAME_GAP_SIZE])
+{
+    struct adc_frame_info gap_info = *info;
+    gap_info.type = ADC_FRAME_GAP;
+    gap_info.timestamp_us = gap->timestamp_us;
+    encode_header(&gap_info, gap->samples, 8, out);
+    // with no frames lost, the range starts at the gap record
+    put_u32(out + ADC_FRAME_HEADER_SIZE, gap->frames > 0 ? gap->first : info->sequence);
+    put_u32(out + ADC_FRAME_HEADER_SIZE + 4, gap->frames);
+    put_u32(out + ADC_FRAME_HEADER_SIZE + 8, adc_frame_crc32(0, out + 4, ADC_FRAME_HEADER_SIZE + 8 - 4));
+}
+
+void adc_frame_encode_config(const struct adc_frame_info *info, uint8_t atten, uint16_t oversample, uint8_t out[ADC_FRAME_CONFIG_SIZE])
+{
+    struct adc_frame_info config_info = *info;
+    config_info.type = ADC_FRAME_CONFIG;
+    encode_header(&config_info, 0, 4, out);
+    out[ADC_FRAME_HEADER_SIZE] = atten;
+    out[ADC_FRAME_HEADER_SIZE + 1] = 0;
+    put_u16(out + ADC_FRAME_HEADER_SIZE + 2, oversample);
+    put_u32(out + ADC_FRAME_HEADER_SIZE + 4, adc_frame_crc32(0, out + 4, ADC_FRAME_HEADER_SIZE + 4 - 4));
+}
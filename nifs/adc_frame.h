@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_FRAME_H__
+#define __ADC_FRAME_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Binary frames of samples, as written to sinks.
+//
+// All fields are little endian:
+//
+//   offset  size
+//        0     4  magic, "ADCF"
+//        4     1  version, ADC_FRAME_VERSION
+//        5     1  type, adc_frame_type_t
+//        6     2  source, the GPIO pin of the sampler
+//        8     4  sequence number
+//       12     4  sample count; for gap records, the samples lost
+//       16     4  payload length, in bytes
+//       20     8  timestamp of the first sample, in microseconds
+//       28     4  sample period, in microseconds
+//       32     n  payload
+//     32+n     4  CRC-32 (IEEE 802.3) of bytes 4 to 32+n
+//
+// The payload of sample frames is the samples, as 16-bit voltages in
+// millivolts.  Frames are usually full blocks, but a block is cut short
+// when samples are lost, so that the timestamps of its samples stay right.
+//
+// Every frame of a source, sample frame or gap record, takes the next
+// sequence number, whether it is delivered or lost.  A gap record is sent
+// once frames or samples were lost, before the next sample frame; its
+// payload is the first sequence number lost and the number of sequence
+// numbers lost (both 32 bits), which may be 0 if only samples were lost.
+// So every sequence number a reader does not receive is either reported
+// lost by a gap record, or was lost after the frame left the device.
+//
+// A config record marks where a sampler was reconfigured: frames after it
+// were taken with the new configuration.  Its timestamp is the time from
+// which the configuration applies, its period the new sample period, and
+// its payload the new attenuation (8 bits, 0 to 3 for 0, 2.5, 6 and 11 dB),
+// a reserved byte and the conversions averaged per sample (16 bits).
+//
+// Readers resynchronize after corrupted or lost bytes by scanning for the
+// magic and checking the CRC.
+//
+
+#define ADC_FRAME_MAGIC "ADCF"
+#define ADC_FRAME_VERSION 2
+#define ADC_FRAME_HEADER_SIZE 32
+#define ADC_FRAME_TRAILER_SIZE 4
+#define ADC_FRAME_GAP_SIZE (ADC_FRAME_HEADER_SIZE + 8 + ADC_FRAME_TRAILER_SIZE)
+#define ADC_FRAME_CONFIG_SIZE (ADC_FRAME_HEADER_SIZE + 4 + ADC_FRAME_TRAILER_SIZE)
+
+typedef enum
+{
+    ADC_FRAME_SAMPLES = 0,
+    ADC_FRAME_GAP = 1,
+    ADC_FRAME_CONFIG = 2
+} adc_frame_type_t;
+
+struct adc_frame_info
+{
+    adc_frame_type_t type;
+    uint16_t source;
+    uint32_t sequence;
+    int64_t timestamp_us;
+    uint32_t period_us;
+};
+
+//
+// Losses not yet reported in a gap record: a range of sequence numbers,
+// and the samples lost since timestamp_us.
+//
+struct adc_frame_gap
+{
+    uint32_t first;
+    uint32_t frames;
+    uint32_t samples;
+    int64_t timestamp_us;
+};
+
+static inline bool adc_frame_gap_pending(const struct adc_frame_gap *gap)
+{
+    return gap->frames > 0 || gap->samples > 0;
+}
+
+//
+// Record a lost frame with the given sequence number, and its samples, if
+// any, starting at timestamp_us.  Frames must be lost in sequence order,
+// with no frame delivered in between.
+//
+static inline void adc_frame_gap_add_frame(struct adc_frame_gap *gap, uint32_t sequence, uint32_t samples, int64_t timestamp_us)
+{
+    if (gap->frames == 0) {
+        gap->first = sequence;
+    }
+    gap->frames++;
+    if (gap->samples == 0) {
+        gap->timestamp_us = timestamp_us;
+    }
+    gap->samples += samples;
+}
+
+//
+// Record samples lost before they made it into a frame.
+//
+static inline void adc_frame_gap_add_samples(struct adc_frame_gap *gap, uint32_t samples, int64_t timestamp_us)
+{
+    if (gap->samples == 0) {
+        gap->timestamp_us = timestamp_us;
+    }
+    gap->samples += samples;
+}
+
+static inline size_t adc_frame_size(size_t samples)
+{
+    return ADC_FRAME_HEADER_SIZE + samples * sizeof(uint16_t) + ADC_FRAME_TRAILER_SIZE;
+}
+
+//
+// Encode a frame of n samples into out, which must hold adc_frame_size(n)
+// bytes.  Returns the size of the frame.
+//
+size_t adc_frame_encode(const struct adc_frame_info *info, const uint16_t *samples, size_t n, uint8_t *out);
+
+//
+// Encode a gap record into out, which must hold ADC_FRAME_GAP_SIZE bytes.
+// The sequence number is the one of the gap record itself.
+//
+void adc_frame_encode_gap(const struct adc_frame_info *info, const struct adc_frame_gap *gap, uint8_t out[ADC_FRAME_GAP_SIZE]);
+
+//
+// Encode a config record into out, which must hold ADC_FRAME_CONFIG_SIZE
+// bytes.  The timestamp and period of info are those of the new
+// configuration.
+//
+void adc_frame_encode_config(const struct adc_frame_info *info, uint8_t atten, uint16_t oversample, uint8_t out[ADC_FRAME_CONFIG_SIZE]);
+
+//
+// Encode the header and trailer of a frame separately, for writers that
+// copy the samples without assembling the frame first.  The payload is the
+// in-memory representation of the samples, so this is only valid on little
+// endian targets.
+//
+void adc_frame_encode_header(const struct adc_frame_info *info, size_t n, uint8_t header[ADC_FRAME_HEADER_SIZE]);
+void adc_frame_encode_trailer(const uint8_t header[ADC_FRAME_HEADER_SIZE], const uint16_t *samples, size_t n, uint8_t trailer[ADC_FRAME_TRAILER_SIZE]);
+
+//
+// Total size of the frame starting with header, or 0 if it is not the
+// header of a frame of this version.
+//
+size_t adc_frame_length(const uint8_t header[ADC_FRAME_HEADER_SIZE]);
+
+//
+// Update a CRC-32 with len bytes; start with crc 0.
+//
+uint32_t adc_frame_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif
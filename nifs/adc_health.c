@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_health.h"
+
+#include <string.h>
+
+static void reset_window(struct adc_health *health)
+{
+    health->n = 0;
+    health->at_low = 0;
+    health->at_high = 0;
+    health->min_raw = UINT32_MAX;
+    health->max_seen_raw = 0;
+    health->sum = 0;
+    health->sum_squares = 0;
+}
+
+void adc_health_init(struct adc_health *health, uint32_t window, uint32_t max_raw, uint32_t noise_mv)
+{
+    memset(health, 0, sizeof(struct adc_health));
+    health->window = window;
+    health->max_raw = max_raw;
+    health->noise_variance = (uint64_t) noise_mv * noise_mv;
+    health->state = ADC_HEALTH_UNKNOWN;
+    health->pending = ADC_HEALTH_UNKNOWN;
+    reset_window(health);
+}
+
+static adc_health_state_t classify(const struct adc_health *health)
+{
+    uint32_t saturated = (health->n * ADC_HEALTH_SATURATED_PER_MILLE) / 1000;
+    if (health->at_high >= saturated) {
+        return ADC_HEALTH_SATURATED_HIGH;
+    }
+    if (health->at_low >= saturated) {
+        return ADC_HEALTH_SATURATED_LOW;
+    }
+    if (health->min_raw == health->max_seen_raw) {
+        return ADC_HEALTH_STUCK;
+    }
+    // n^2 var = n sum(x^2) - sum(x)^2
+    uint64_t n = health->n;
+    uint64_t scaled_variance = n * health->sum_squares - (uint64_t) (health->sum * health->sum);
+    if (scaled_variance > n * n * health->noise_variance) {
+        return ADC_HEALTH_OPEN;
+    }
+    return ADC_HEALTH_OK;
+}
+
+bool adc_health_update(struct adc_health *health, uint32_t raw, uint32_t mv)
+{
+    if (raw == 0) {
+        health->at_low++;
+    } else if (raw >= health->max_raw) {
+        health->at_high++;
+    }
+    if (raw < health->min_raw) {
+        health->min_raw = raw;
+    }
+    if (raw > health->max_seen_raw) {
+        health->max_seen_raw = raw;
+    }
+    health->sum += mv;
+    health->sum_squares += (uint64_t) mv * mv;
+
+    if (++health->n < health->window) {
+        return false;
+    }
+    adc_health_state_t state = classify(health);
+    reset_window(health);
+
+    if (state == health->state) {
+        health->pending_windows = 0;
+        return false;
+    }
+    if (state != health->pending) {
+        health->pending = state;
+        health->pending_windows = 0;
+    }
+    // the first classification is taken as is
+    if (++health->pending_windows < ADC_HEALTH_CONFIRM_WINDOWS && health->state != ADC_HEALTH_UNKNOWN) {
+        return false;
+    }
+    health->state = state;
+    health->pending_windows = 0;
+    return true;
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_HEALTH_H__
+#define __ADC_HEALTH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Pin health, classified from the running statistics of each window of
+// samples.  A new state only takes effect once it has been seen in
+// ADC_HEALTH_CONFIRM_WINDOWS consecutive windows, so a single odd window
+// does not cause a change.
+//
+
+#define ADC_HEALTH_CONFIRM_WINDOWS 2
+// fraction of a window at a rail for the pin to be saturated, in per-mille
+#define ADC_HEALTH_SATURATED_PER_MILLE 900
+
+typedef enum
+{
+    ADC_HEALTH_UNKNOWN,
+    ADC_HEALTH_OK,
+    // identical readings over a whole window
+    ADC_HEALTH_STUCK,
+    // readings pinned at the bottom or top of the range
+    ADC_HEALTH_SATURATED_LOW,
+    ADC_HEALTH_SATURATED_HIGH,
+    // readings too noisy for a driven input
+    ADC_HEALTH_OPEN
+} adc_health_state_t;
+
+struct adc_health
+{
+    uint32_t window;
+    uint32_t max_raw;
+    uint64_t noise_variance;
+
+    adc_health_state_t state;
+    adc_health_state_t pending;
+    uint32_t pending_windows;
+
+    uint32_t n;
+    uint32_t at_low;
+    uint32_t at_high;
+    uint32_t min_raw;
+    uint32_t max_seen_raw;
+    int64_t sum;
+    uint64_t sum_squares;
+};
+
+//
+// Set up health checks over windows of samples, for raw readings up to
+// max_raw, with an open input above a standard deviation of noise_mv.
+//
+void adc_health_init(struct adc_health *health, uint32_t window, uint32_t max_raw, uint32_t noise_mv);
+
+//
+// Update with a sample; returns true when the state has changed.
+//
+bool adc_health_update(struct adc_health *health, uint32_t raw, uint32_t mv);
+
+#endif
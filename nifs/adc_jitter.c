@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_jitter.h"
+
+#include <math.h>
+#include <string.h>
+
+void adc_jitter_init(struct adc_jitter *jitter, int64_t period_us)
+{
+    memset(jitter, 0, sizeof(struct adc_jitter));
+    jitter->period_us = period_us;
+    jitter->last_us = -1;
+    jitter->min_us = INT64_MAX;
+}
+
+static unsigned bucket(uint64_t deviation)
+{
+    unsigned k = 0;
+    while (deviation != 0 && k < ADC_JITTER_BUCKETS - 1) {
+        deviation >>= 1;
+        ++k;
+    }
+    return k;
+}
+
+void adc_jitter_update(struct adc_jitter *jitter, int64_t timestamp_us)
+{
+    int64_t last = jitter->last_us;
+    jitter->last_us = timestamp_us;
+    if (last < 0) {
+        return;
+    }
+    int64_t interval = timestamp_us - last;
+    if (interval < jitter->min_us) {
+        jitter->min_us = interval;
+    }
+    if (interval > jitter->max_us) {
+        jitter->max_us = interval;
+    }
+    int64_t deviation = interval - jitter->period_us;
+    jitter->sum_deviation += deviation;
+    jitter->sum_deviation_squares += (uint64_t) (deviation * deviation);
+    jitter->histogram[bucket(deviation < 0 ? -deviation : deviation)]++;
+    jitter->intervals++;
+}
+
+void adc_jitter_missed(struct adc_jitter *jitter, uint32_t samples)
+{
+    jitter->missed += samples;
+}
+
+void adc_jitter_moments(const struct adc_jitter *jitter, float *mean, float *stddev)
+{
+    if (jitter->intervals == 0) {
+        *mean = 0.0f;
+        *stddev = 0.0f;
+        return;
+    }
+    double n = jitter->intervals;
+    double mean_deviation = (double) jitter->sum_deviation / n;
+    double variance = (double) jitter->sum_deviation_squares / n - mean_deviation * mean_deviation;
+    *mean = (float) (jitter->period_us + mean_deviation);
+    *stddev = variance > 0.0 ? (float) sqrt(variance) : 0.0f;
+}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_JITTER_H__
+#define __ADC_JITTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Sampling jitter analysis.  Records the interval between consecutive
+// samples, and a histogram of its deviation from the nominal period: bucket
+// 0 counts exact intervals, and bucket k > 0 deviations from 2^(k-1) up to
+// 2^k - 1 us, with the last bucket open ended.
+//
+
+#define ADC_JITTER_BUCKETS 16
+
+struct adc_jitter
+{
+    int64_t period_us;
+    int64_t last_us;
+    uint32_t intervals;
+    int64_t min_us;
+    int64_t max_us;
+    // deviations from the period, which stay small, so their squares do not
+    // overflow
+    int64_t sum_deviation;
+    uint64_t sum_deviation_squares;
+    uint32_t missed;
+    uint32_t histogram[ADC_JITTER_BUCKETS];
+};
+
+void adc_jitter_init(struct adc_jitter *jitter, int64_t period_us);
+void adc_jitter_update(struct adc_jitter *jitter, int64_t timestamp_us);
+
+//
+// Count samples skipped because the sampler could not keep up.
+//
+void adc_jitter_missed(struct adc_jitter *jitter, uint32_t samples);
+
+//
+// Mean and standard deviation of the intervals, in us.
+//
+void adc_jitter_moments(const struct adc_jitter *jitter, float *mean, float *stddev);
+
+#endif
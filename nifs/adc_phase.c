@@ -0,0 +1,197 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_phase.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COEFF_SHIFT 30
+
+static void reset_window(struct adc_phase *phase)
+{
+    phase->n = 0;
+    phase->skew_sum_us = 0;
+    memset(phase->s1, 0, sizeof(phase->s1));
+    memset(phase->s2, 0, sizeof(phase->s2));
+}
+
+bool adc_phase_init(struct adc_phase *phase, adc_phase_method_t method, int64_t period_us, unsigned frequency, unsigned cycles, uint32_t max_lag)
+{
+    memset(phase, 0, sizeof(struct adc_phase));
+    if (period_us <= 0 || frequency == 0 || cycles == 0) {
+        return false;
+    }
+    double rate = 1e6 / (double) period_us;
+    if (frequency >= rate / 2.0) {
+        return false;
+    }
+    phase->method = method;
+    phase->window = (uint32_t) lround(cycles * rate / frequency);
+    phase->frequency = frequency;
+    phase->period_us = period_us;
+    if (phase->window > ADC_PHASE_MAX_WINDOW) {
+        return false;
+    }
+
+    if (method == ADC_PHASE_GOERTZEL) {
+        phase->coeff = llround(2.0 * cos(2.0 * M_PI * frequency / rate) * (double) (1LL << COEFF_SHIFT));
+    } else {
+        if (max_lag == 0 || max_lag >= phase->window) {
+            return false;
+        }
+        phase->max_lag = max_lag;
+        for (int c = 0; c < 2; ++c) {
+            phase->samples[c] = malloc(phase->window * sizeof(uint16_t));
+            if (phase->samples[c] == NULL) {
+                return false;
+            }
+        }
+    }
+    reset_window(phase);
+    return true;
+}
+
+void adc_phase_destroy(struct adc_phase *phase)
+{
+    free(phase->samples[0]);
+    free(phase->samples[1]);
+}
+
+static double normalize_degrees(double degrees)
+{
+    degrees = fmod(degrees, 360.0);
+    if (degrees > 180.0) {
+        degrees -= 360.0;
+    } else if (degrees <= -180.0) {
+        degrees += 360.0;
+    }
+    return degrees;
+}
+
+static double goertzel_lag_degrees(const struct adc_phase *phase)
+{
+    // both bins carry the same phase offset from the window length, which
+    // cancels out in arg(Y_a conj(Y_b)); Y = s1 - s2 e^(-jw)
+    double w = 2.0 * M_PI * phase->frequency * (double) phase->period_us / 1e6;
+    double re[2];
+    double im[2];
+    for (int c = 0; c < 2; ++c) {
+        re[c] = (double) phase->s1[c] - (double) phase->s2[c] * cos(w);
+        im[c] = (double) phase->s2[c] * sin(w);
+    }
+    double cross_re = re[0] * re[1] + im[0] * im[1];
+    double cross_im = im[0] * re[1] - re[0] * im[1];
+    return atan2(cross_im, cross_re) * 180.0 / M_PI;
+}
+
+static double xcorr_lag_samples(const struct adc_phase *phase)
+{
+    const uint16_t *a = phase->samples[0];
+    const uint16_t *b = phase->samples[1];
+    int32_t n = phase->window;
+    int64_t sum_a = 0;
+    int64_t sum_b = 0;
+    for (int32_t i = 0; i < n; ++i) {
+        sum_a += a[i];
+        sum_b += b[i];
+    }
+    int32_t mean_a = (int32_t) (sum_a / n);
+    int32_t mean_b = (int32_t) (sum_b / n);
+
+    // r(lag) = sum (a[i] - mean_a) (b[i + lag] - mean_b), normalized by the
+    // number of overlapping samples
+    int32_t max_lag = phase->max_lag;
+    double best = -INFINITY;
+    double before = 0.0;
+    double after = 0.0;
+    int32_t best_lag = 0;
+    double previous = -INFINITY;
+    bool capture_after = false;
+    for (int32_t lag = -max_lag; lag <= max_lag; ++lag) {
+        int32_t start = lag < 0 ? -lag : 0;
+        int32_t end = lag > 0 ? n - lag : n;
+        int64_t acc = 0;
+        for (int32_t i = start; i < end; ++i) {
+            acc += (int64_t) (a[i] - mean_a) * (b[i + lag] - mean_b);
+        }
+        double r = (double) acc / (end - start);
+        if (capture_after) {
+            after = r;
+            capture_after = false;
+        }
+        if (r > best) {
+            best = r;
+            best_lag = lag;
+            before = previous;
+            capture_after = true;
+        }
+        previous = r;
+    }
+
+    // parabolic interpolation around the peak, when it is not at the edge
+    if (best_lag > -max_lag && best_lag < max_lag) {
+        double denominator = before - 2.0 * best + after;
+        if (denominator < 0.0) {
+            return best_lag + 0.5 * (before - after) / denominator;
+        }
+    }
+    return best_lag;
+}
+
+bool adc_phase_update(struct adc_phase *phase, int64_t timestamp_us, uint32_t mv_a, uint32_t mv_b, int64_t skew_us, struct adc_phase_report *report)
+{
+    if (phase->n == 0) {
+        phase->start_us = timestamp_us;
+    }
+    uint16_t x[2] = { mv_a > UINT16_MAX ? UINT16_MAX : mv_a, mv_b > UINT16_MAX ? UINT16_MAX : mv_b };
+    if (phase->method == ADC_PHASE_GOERTZEL) {
+        for (int c = 0; c < 2; ++c) {
+            int64_t s = x[c] + ((phase->coeff * phase->s1[c]) >> COEFF_SHIFT) - phase->s2[c];
+            phase->s2[c] = phase->s1[c];
+            phase->s1[c] = s;
+        }
+    } else {
+        phase->samples[0][phase->n] = x[0];
+        phase->samples[1][phase->n] = x[1];
+    }
+    phase->skew_sum_us += skew_us;
+
+    if (++phase->n < phase->window) {
+        return false;
+    }
+
+    double skew = (double) phase->skew_sum_us / phase->n;
+    double degrees_per_us = 360.0 * phase->frequency / 1e6;
+    double lag_us;
+    if (phase->method == ADC_PHASE_GOERTZEL) {
+        // the second channel is sampled skew later, so it appears to lead by
+        // that much
+        lag_us = goertzel_lag_degrees(phase) / degrees_per_us + skew;
+    } else {
+        lag_us = xcorr_lag_samples(phase) * phase->period_us + skew;
+    }
+    double degrees = normalize_degrees(lag_us * degrees_per_us);
+
+    report->timestamp_us = phase->start_us;
+    report->lag_us = (float) lag_us;
+    report->phase = (float) degrees;
+    report->power_factor = (float) cos(degrees * M_PI / 180.0);
+    reset_window(phase);
+    return true;
+}
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_PHASE_H__
+#define __ADC_PHASE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Phase difference between two channels sampled in pairs, over windows of a
+// whole number of cycles of a nominal frequency.  The phase is either
+// measured directly, from the Goertzel bins of both channels at the
+// fundamental, or derived from the lag of the peak of their
+// cross-correlation.  The second channel of each pair is converted skew_us
+// after the first, which is compensated for.
+//
+
+typedef enum
+{
+    ADC_PHASE_GOERTZEL,
+    ADC_PHASE_XCORR
+} adc_phase_method_t;
+
+#define ADC_PHASE_MAX_WINDOW 4096
+
+struct adc_phase
+{
+    adc_phase_method_t method;
+    uint32_t window;
+    uint32_t n;
+    unsigned frequency;
+    int64_t period_us;
+    int64_t start_us;
+    int64_t skew_sum_us;
+
+    // Goertzel only; coefficient in Q30
+    int64_t coeff;
+    int64_t s1[2];
+    int64_t s2[2];
+
+    // cross-correlation only
+    uint32_t max_lag;
+    uint16_t *samples[2];
+};
+
+struct adc_phase_report
+{
+    int64_t timestamp_us;
+    // how much the second channel lags the first, in microseconds and in
+    // degrees of the nominal frequency, from -180 to 180
+    float lag_us;
+    float phase;
+    // cosine of the phase
+    float power_factor;
+};
+
+//
+// Set up phase measurement for pairs sampled every period_us; max_lag is
+// the largest lag considered by cross-correlation, in samples.
+//
+bool adc_phase_init(struct adc_phase *phase, adc_phase_method_t method, int64_t period_us, unsigned frequency, unsigned cycles, uint32_t max_lag);
+void adc_phase_destroy(struct adc_phase *phase);
+
+//
+// Update with a pair of samples; returns true, and fills in report, at the
+// end of each window.
+//
+bool adc_phase_update(struct adc_phase *phase, int64_t timestamp_us, uint32_t mv_a, uint32_t mv_b, int64_t skew_us, struct adc_phase_report *report);
+
+#endif
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_power.h"
+
+#include <math.h>
+#include <string.h>
+
+#define COEFF_SHIFT 28
+#define CENTER_MV ((ADC_POWER_MAX_MV + 1) / 2)
+
+static void reset_window(struct adc_power *power)
+{
+    power->n = 0;
+    memset(power->s1, 0, sizeof(power->s1));
+    memset(power->s2, 0, sizeof(power->s2));
+    power->sum = 0;
+    power->sum_squares = 0;
+    power->min = UINT16_MAX;
+    power->max = 0;
+}
+
+// whether the filter states for cycles_per_sample stay below
+// ADC_POWER_MAX_STATE over window samples, see adc_power.h
+static bool state_bounded(double window, double cycles_per_sample)
+{
+    return window * CENTER_MV < ADC_POWER_MAX_STATE * sin(2.0 * M_PI * cycles_per_sample);
+}
+
+bool adc_power_init(struct adc_power *power, int64_t period_us, unsigned frequency, unsigned cycles, unsigned harmonics)
+{
+    if (period_us <= 0 || frequency == 0 || cycles == 0) {
+        return false;
+    }
+    double rate = 1e6 / (double) period_us;
+    double window = round(cycles * rate / frequency);
+    if (harmonics > ADC_POWER_MAX_HARMONICS) {
+        harmonics = ADC_POWER_MAX_HARMONICS;
+    }
+    // |sin w| is smallest for the fundamental or for the highest harmonic
+    if (!state_bounded(window, frequency / rate)) {
+        return false;
+    }
+    while (harmonics > 0 && ((double) harmonics * frequency >= rate / 2.0 || !state_bounded(window, harmonics * frequency / rate))) {
+        --harmonics;
+    }
+    if (harmonics == 0) {
+        return false;
+    }
+
+    memset(power, 0, sizeof(struct adc_power));
+    power->window = (uint32_t) window;
+    power->harmonics = harmonics;
+    for (unsigned h = 0; h < harmonics; ++h) {
+        double w = 2.0 * M_PI * (double) (h + 1) * frequency / rate;
+        power->coeff[h] = llround(2.0 * cos(w) * (double) (1LL << COEFF_SHIFT));
+    }
+    reset_window(power);
+    return true;
+}
+
+static void report_window(const struct adc_power *power, struct adc_power_report *report)
+{
+    double n = power->n;
+    double mean = (double) power->sum / n;
+    double variance = (double) power->sum_squares / n - mean * mean;
+    double rms = variance > 0.0 ? sqrt(variance) : 0.0;
+
+    // amplitude of harmonic h is 2 |X_h| / n
+    double amplitude_squared[ADC_POWER_MAX_HARMONICS];
+    for (unsigned h = 0; h < power->harmonics; ++h) {
+        double s1 = (double) power->s1[h];
+        double s2 = (double) power->s2[h];
+        double c = (double) power->coeff[h] / (double) (1LL << COEFF_SHIFT);
+        double magnitude_squared = s1 * s1 + s2 * s2 - c * s1 * s2;
+        amplitude_squared[h] = 4.0 * (magnitude_squared > 0.0 ? magnitude_squared : 0.0) / (n * n);
+    }
+    double harmonics_squared = 0.0;
+    for (unsigned h = 1; h < power->harmonics; ++h) {
+        harmonics_squared += amplitude_squared[h];
+    }
+
+    double peak = fmax((double) power->max - mean, mean - (double) power->min);
+    report->timestamp_us = power->start_us;
+    report->rms = (float) rms;
+    report->fundamental = (float) sqrt(amplitude_squared[0]);
+    report->thd = amplitude_squared[0] > 0.0 ? (float) sqrt(harmonics_squared / amplitude_squared[0]) : 0.0f;
+    report->crest_factor = rms > 0.0 ? (float) (peak / rms) : 0.0f;
+}
+
+bool adc_power_update(struct adc_power *power, int64_t timestamp_us, uint32_t mv, struct adc_power_report *report)
+{
+    if (power->n == 0) {
+        power->start_us = timestamp_us;
+    }
+    uint16_t x = mv > ADC_POWER_MAX_MV ? ADC_POWER_MAX_MV : mv;
+    // centered, which keeps the filter states small, see adc_power.h
+    int32_t centered = (int32_t) x - CENTER_MV;
+    for (unsigned h = 0; h < power->harmonics; ++h) {
+        int64_t s = centered + ((power->coeff[h] * power->s1[h]) >> COEFF_SHIFT) - power->s2[h];
+        power->s2[h] = power->s1[h];
+        power->s1[h] = s;
+    }
+    power->sum += x;
+    power->sum_squares += (uint32_t) x * x;
+    if (x < power->min) {
+        power->min = x;
+    }
+    if (x > power->max) {
+        power->max = x;
+    }
+
+    if (++power->n < power->window) {
+        return false;
+    }
+    report_window(power, report);
+    reset_window(power);
+    return true;
+}
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_POWER_H__
+#define __ADC_POWER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Power quality metrics of an AC signal, over windows of a whole number of
+// cycles of the nominal line frequency.  The fundamental and its harmonics
+// are measured with one Goertzel filter each, run in fixed point on every
+// sample; everything else is derived once per window.
+//
+// Samples are clamped to ADC_POWER_MAX_MV, and centered, before they enter
+// the filters.  The filter states then stay within n * 2^11 / sin(w) for a
+// window of n samples and a harmonic at w radians per sample, which must
+// stay below ADC_POWER_MAX_STATE for the fixed point products not to
+// overflow; windows that are too long for their frequency are rejected.
+//
+
+#define ADC_POWER_MAX_HARMONICS 15
+#define ADC_POWER_MAX_MV 4095
+#define ADC_POWER_MAX_STATE (1LL << 33)
+
+struct adc_power
+{
+    uint32_t window;
+    uint32_t n;
+    uint8_t harmonics;
+    int64_t start_us;
+    // Goertzel coefficients 2 cos(2 pi h f / fs) in Q28, and filter states
+    int64_t coeff[ADC_POWER_MAX_HARMONICS];
+    int64_t s1[ADC_POWER_MAX_HARMONICS];
+    int64_t s2[ADC_POWER_MAX_HARMONICS];
+    int64_t sum;
+    uint64_t sum_squares;
+    uint16_t min;
+    uint16_t max;
+};
+
+struct adc_power_report
+{
+    int64_t timestamp_us;
+    // AC RMS and fundamental amplitude, in mV
+    float rms;
+    float fundamental;
+    // total harmonic distortion, relative to the fundamental
+    float thd;
+    // peak deviation from the mean, relative to the RMS
+    float crest_factor;
+};
+
+//
+// Set up metrics for samples taken every period_us, for a line frequency in
+// Hz, reported every cycles cycles.  Harmonics above the Nyquist frequency,
+// or too close to it for the window, are dropped; returns false if the
+// fundamental is not measurable either, e.g. because the window is too
+// long.
+//
+bool adc_power_init(struct adc_power *power, int64_t period_us, unsigned frequency, unsigned cycles, unsigned harmonics);
+
+//
+// Update the metrics with a sample; returns true, and fills in report, at
+// the end of each window.
+//
+bool adc_power_update(struct adc_power *power, int64_t timestamp_us, uint32_t mv, struct adc_power_report *report);
+
+#endif
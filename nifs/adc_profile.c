@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_profile.h"
+
+#include <math.h>
+
+#define KELVIN_OFFSET 273.15f
+#define NTC_MIN_MILLI_C -55000
+#define NTC_MAX_MILLI_C 150000
+
+// Typical Li-ion open circuit voltage (mV per cell) to state of charge (per-mille)
+static const int16_t li_ion_curve[][2] = {
+    { 3270, 0 },
+    { 3610, 50 },
+    { 3690, 100 },
+    { 3710, 150 },
+    { 3730, 200 },
+    { 3750, 250 },
+    { 3770, 300 },
+    { 3790, 350 },
+    { 3800, 400 },
+    { 3820, 450 },
+    { 3840, 500 },
+    { 3850, 550 },
+    { 3870, 600 },
+    { 3910, 650 },
+    { 3950, 700 },
+    { 3980, 750 },
+    { 4020, 800 },
+    { 4080, 850 },
+    { 4110, 900 },
+    { 4150, 950 },
+    { 4200, 1000 }
+};
+
+#define LI_ION_CURVE_POINTS (sizeof(li_ion_curve) / sizeof(li_ion_curve[0]))
+
+static uint8_t lut_shift(uint32_t max_mv)
+{
+    uint8_t shift = 0;
+    while ((max_mv >> shift) + 2 > ADC_LUT_MAX_POINTS) {
+        ++shift;
+    }
+    return shift;
+}
+
+size_t adc_lut_size(uint32_t max_mv)
+{
+    uint8_t shift = lut_shift(max_mv);
+    size_t points = (max_mv >> shift) + 2;
+    return sizeof(struct adc_lut) + points * sizeof(int32_t);
+}
+
+static int32_t clamp_milli_c(float milli_c)
+{
+    if (milli_c < NTC_MIN_MILLI_C) {
+        return NTC_MIN_MILLI_C;
+    }
+    if (milli_c > NTC_MAX_MILLI_C) {
+        return NTC_MAX_MILLI_C;
+    }
+    return (int32_t) lroundf(milli_c);
+}
+
+static int32_t ntc_eval(const struct adc_profile *profile, float mv)
+{
+    float supply = profile->ntc.supply_mv;
+    // keep away from the rails, where the thermistor resistance is 0 or infinite
+    if (mv < 1.0f) {
+        mv = 1.0f;
+    } else if (mv > supply - 1.0f) {
+        mv = supply - 1.0f;
+    }
+    float r;
+    if (profile->ntc.high_side) {
+        r = profile->ntc.series * (supply - mv) / mv;
+    } else {
+        r = profile->ntc.series * mv / (supply - mv);
+    }
+
+    float inv_t;
+    if (profile->type == ADC_PROFILE_NTC_BETA) {
+        inv_t = 1.0f / (profile->ntc.t0 + KELVIN_OFFSET) + logf(r / profile->ntc.r0) / profile->ntc.beta;
+    } else {
+        float ln_r = logf(r);
+        inv_t = profile->ntc.a + profile->ntc.b * ln_r + profile->ntc.c * ln_r * ln_r * ln_r;
+    }
+    if (inv_t <= 0.0f) {
+        return NTC_MAX_MILLI_C;
+    }
+    return clamp_milli_c((1.0f / inv_t - KELVIN_OFFSET) * 1000.0f);
+}
+
+static int32_t divider_eval(uint32_t r_top, uint32_t r_bottom, float mv)
+{
+    if (r_bottom == 0) {
+        return (int32_t) lroundf(mv);
+    }
+    return (int32_t) lroundf(mv * ((float) r_top + (float) r_bottom) / (float) r_bottom);
+}
+
+static int32_t li_ion_eval(const struct adc_profile *profile, float mv)
+{
+    float cell_mv = (float) divider_eval(profile->li_ion.r_top, profile->li_ion.r_bottom, mv) / (float) profile->li_ion.cells;
+    if (cell_mv <= li_ion_curve[0][0]) {
+        return li_ion_curve[0][1];
+    }
+    for (size_t i = 1; i < LI_ION_CURVE_POINTS; ++i) {
+        if (cell_mv <= li_ion_curve[i][0]) {
+            float x0 = li_ion_curve[i - 1][0];
+            float y0 = li_ion_curve[i - 1][1];
+            float x1 = li_ion_curve[i][0];
+            float y1 = li_ion_curve[i][1];
+            return (int32_t) lroundf(y0 + (y1 - y0) * (cell_mv - x0) / (x1 - x0));
+        }
+    }
+    return li_ion_curve[LI_ION_CURVE_POINTS - 1][1];
+}
+
+int32_t adc_profile_eval(const struct adc_profile *profile, float mv)
+{
+    switch (profile->type) {
+        case ADC_PROFILE_NTC_BETA:
+        case ADC_PROFILE_NTC_STEINHART_HART:
+            return ntc_eval(profile, mv);
+        case ADC_PROFILE_DIVIDER:
+            return divider_eval(profile->divider.r_top, profile->divider.r_bottom, mv);
+        case ADC_PROFILE_LI_ION:
+            return li_ion_eval(profile, mv);
+        default:
+            return 0;
+    }
+}
+
+void adc_lut_compile(const struct adc_profile *profile, uint32_t max_mv, struct adc_lut *lut)
+{
+    lut->shift = lut_shift(max_mv);
+    lut->points = (max_mv >> lut->shift) + 2;
+    for (uint16_t i = 0; i < lut->points; ++i) {
+        lut->y[i] = adc_profile_eval(profile, (float) ((uint32_t) i << lut->shift));
+    }
+}
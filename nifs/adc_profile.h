@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_PROFILE_H__
+#define __ADC_PROFILE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADC_LUT_MAX_POINTS 129
+
+typedef enum
+{
+    ADC_PROFILE_NTC_BETA,
+    ADC_PROFILE_NTC_STEINHART_HART,
+    ADC_PROFILE_DIVIDER,
+    ADC_PROFILE_LI_ION
+} adc_profile_type_t;
+
+//
+// Conversion profile, as configured by the application.  Profiles are only
+// evaluated (in floating point) when a lookup table is compiled; readings are
+// converted with adc_lut_lookup.
+//
+// Output units are milli-degrees Celsius for NTC thermistors, millivolts for
+// voltage dividers, and per-mille state of charge for Li-ion batteries.
+//
+struct adc_profile
+{
+    adc_profile_type_t type;
+    union
+    {
+        struct
+        {
+            float beta;
+            float r0;
+            float t0;
+            // Steinhart-Hart coefficients
+            float a;
+            float b;
+            float c;
+            float series;
+            float supply_mv;
+            // thermistor between the supply and the ADC pin, instead of
+            // between the ADC pin and ground
+            bool high_side;
+        } ntc;
+        struct
+        {
+            uint32_t r_top;
+            uint32_t r_bottom;
+        } divider;
+        struct
+        {
+            uint32_t cells;
+            uint32_t r_top;
+            uint32_t r_bottom;
+        } li_ion;
+    };
+};
+
+//
+// Piecewise linear table over millivolts.  Point i is at i << shift mV.
+//
+struct adc_lut
+{
+    uint8_t shift;
+    uint16_t points;
+    int32_t y[];
+};
+
+size_t adc_lut_size(uint32_t max_mv);
+void adc_lut_compile(const struct adc_profile *profile, uint32_t max_mv, struct adc_lut *lut);
+
+//
+// The profile evaluated in floating point at mv, as stored in the table
+// points; only used when compiling tables, and to check them.
+//
+int32_t adc_profile_eval(const struct adc_profile *profile, float mv);
+
+static inline int32_t adc_lut_lookup(const struct adc_lut *lut, int32_t mv)
+{
+    if (mv <= 0) {
+        return lut->y[0];
+    }
+    uint32_t i = (uint32_t) mv >> lut->shift;
+    if (i >= (uint32_t) lut->points - 1) {
+        return lut->y[lut->points - 1];
+    }
+    int32_t frac = mv & ((1 << lut->shift) - 1);
+    int32_t y0 = lut->y[i];
+    int32_t y1 = lut->y[i + 1];
+    return y0 + (int32_t) (((int64_t) (y1 - y0) * frac) >> lut->shift);
+}
+
+#endif
@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_pulse.h"
+
+#include <string.h>
+
+static void stats_reset(struct adc_pulse_stats *stats)
+{
+    memset(stats, 0, sizeof(struct adc_pulse_stats));
+    stats->min_us = INT64_MAX;
+}
+
+static void stats_add(struct adc_pulse_stats *stats, int64_t us)
+{
+    stats->count++;
+    stats->sum_us += us;
+    if (us < stats->min_us) {
+        stats->min_us = us;
+    }
+    if (us > stats->max_us) {
+        stats->max_us = us;
+    }
+}
+
+void adc_pulse_init(struct adc_pulse *pulse, uint32_t low_mv, uint32_t high_mv, int64_t window_us)
+{
+    memset(pulse, 0, sizeof(struct adc_pulse));
+    pulse->low_mv = low_mv;
+    pulse->high_mv = high_mv;
+    pulse->window_us = window_us;
+    pulse->rise_us = -1;
+    stats_reset(&pulse->widths);
+    stats_reset(&pulse->periods);
+}
+
+bool adc_pulse_update(struct adc_pulse *pulse, int64_t timestamp_us, uint32_t mv, struct adc_pulse_report *report)
+{
+    if (!pulse->initialized) {
+        // the level before the first sample is unknown, so the first edges
+        // are only counted once the signal has been on the other side
+        pulse->high = mv >= pulse->high_mv;
+        pulse->window_start_us = timestamp_us;
+        pulse->last_us = timestamp_us;
+        pulse->initialized = true;
+        return false;
+    }
+
+    if (pulse->high) {
+        pulse->high_us += timestamp_us - pulse->last_us;
+    }
+    pulse->last_us = timestamp_us;
+
+    if (!pulse->high && mv >= pulse->high_mv) {
+        pulse->high = true;
+        if (pulse->rise_us >= 0) {
+            stats_add(&pulse->periods, timestamp_us - pulse->rise_us);
+        }
+        pulse->rise_us = timestamp_us;
+    } else if (pulse->high && mv <= pulse->low_mv) {
+        pulse->high = false;
+        if (pulse->rise_us >= 0) {
+            stats_add(&pulse->widths, timestamp_us - pulse->rise_us);
+        }
+    }
+
+    int64_t elapsed = timestamp_us - pulse->window_start_us;
+    if (elapsed < pulse->window_us) {
+        return false;
+    }
+    report->timestamp_us = pulse->window_start_us;
+    report->widths = pulse->widths;
+    report->periods = pulse->periods;
+    report->duty = elapsed > 0 ? (uint32_t) ((pulse->high_us * 1000 + elapsed / 2) / elapsed) : 0;
+    if (report->widths.count == 0) {
+        report->widths.min_us = 0;
+    }
+    if (report->periods.count == 0) {
+        report->periods.min_us = 0;
+    }
+
+    // edges carry over into the next window, so pulses spanning windows are
+    // still measured
+    pulse->window_start_us = timestamp_us;
+    pulse->high_us = 0;
+    stats_reset(&pulse->widths);
+    stats_reset(&pulse->periods);
+    return true;
+}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_PULSE_H__
+#define __ADC_PULSE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Pulse measurement on an analog signal.  The signal is high once it rises
+// to the high threshold, and low once it falls to the low threshold.  Pulse
+// widths (high times) and periods (rising edge to rising edge) are
+// accumulated over a window of time, and reported at its end.
+//
+
+struct adc_pulse_stats
+{
+    uint32_t count;
+    int64_t min_us;
+    int64_t max_us;
+    int64_t sum_us;
+};
+
+struct adc_pulse
+{
+    uint32_t high_mv;
+    uint32_t low_mv;
+    int64_t window_us;
+
+    bool initialized;
+    bool high;
+    int64_t window_start_us;
+    // last rising edge, or -1 if none yet
+    int64_t rise_us;
+    // time high within the window
+    int64_t high_us;
+    int64_t last_us;
+
+    struct adc_pulse_stats widths;
+    struct adc_pulse_stats periods;
+};
+
+struct adc_pulse_report
+{
+    int64_t timestamp_us;
+    struct adc_pulse_stats widths;
+    struct adc_pulse_stats periods;
+    // time high over the whole window, in per-mille
+    uint32_t duty;
+};
+
+void adc_pulse_init(struct adc_pulse *pulse, uint32_t low_mv, uint32_t high_mv, int64_t window_us);
+
+//
+// Update with a sample; returns true, and fills in report, at the end of
+// each window.
+//
+bool adc_pulse_update(struct adc_pulse *pulse, int64_t timestamp_us, uint32_t mv, struct adc_pulse_report *report);
+
+#endif
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_quantile.h"
+
+#include <string.h>
+
+bool adc_quantiles_init(struct adc_quantiles *quantiles, const float *p, unsigned n)
+{
+    if (n == 0 || n > ADC_QUANTILES_MAX) {
+        return false;
+    }
+    memset(quantiles, 0, sizeof(struct adc_quantiles));
+    quantiles->n = n;
+    for (unsigned i = 0; i < n; ++i) {
+        if (!(p[i] > 0.0f && p[i] < 1.0f)) {
+            return false;
+        }
+        struct adc_p2 *e = &quantiles->estimators[i];
+        e->p = p[i];
+        for (int j = 0; j < 5; ++j) {
+            e->positions[j] = j + 1;
+        }
+        e->increments[0] = 0.0f;
+        e->increments[1] = p[i] / 2.0f;
+        e->increments[2] = p[i];
+        e->increments[3] = (1.0f + p[i]) / 2.0f;
+        e->increments[4] = 1.0f;
+    }
+    return true;
+}
+
+static void insert_sorted(float *heights, unsigned count, float x)
+{
+    unsigned i = count;
+    while (i > 0 && heights[i - 1] > x) {
+        heights[i] = heights[i - 1];
+        --i;
+    }
+    heights[i] = x;
+}
+
+// Marker positions only enter as differences, which are small, so the
+// interpolations stay in single precision
+static float parabolic(const struct adc_p2 *e, int i, int d)
+{
+    const float *q = e->heights;
+    const int64_t *n = e->positions;
+    float below = (float) (n[i] - n[i - 1]);
+    float above = (float) (n[i + 1] - n[i]);
+    return q[i] + (float) d / (below + above)
+        * ((below + d) * (q[i + 1] - q[i]) / above
+            + (above - d) * (q[i] - q[i - 1]) / below);
+}
+
+static float linear(const struct adc_p2 *e, int i, int d)
+{
+    return e->heights[i] + d * (e->heights[i + d] - e->heights[i]) / (float) (e->positions[i + d] - e->positions[i]);
+}
+
+// count is the number of samples including x
+static void p2_update(struct adc_p2 *e, float x, uint64_t count)
+{
+    float *q = e->heights;
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (x >= q[k + 1]) {
+            ++k;
+        }
+    }
+    for (int i = k + 1; i < 5; ++i) {
+        e->positions[i]++;
+    }
+
+    // move the middle markers towards their desired positions; in double,
+    // as positions outgrow the 24 bit mantissa of a float after 2^24
+    // samples, under half an hour at 10 kHz
+    for (int i = 1; i < 4; ++i) {
+        double desired = 1.0 + (double) (count - 1) * e->increments[i];
+        float delta = (float) (desired - (double) e->positions[i]);
+        if ((delta >= 1.0f && e->positions[i + 1] - e->positions[i] > 1)
+            || (delta <= -1.0f && e->positions[i - 1] - e->positions[i] < -1)) {
+            int d = delta > 0.0f ? 1 : -1;
+            float candidate = parabolic(e, i, d);
+            if (q[i - 1] < candidate && candidate < q[i + 1]) {
+                q[i] = candidate;
+            } else {
+                q[i] = linear(e, i, d);
+            }
+            e->positions[i] += d;
+        }
+    }
+}
+
+void adc_quantiles_update(struct adc_quantiles *quantiles, float x)
+{
+    uint64_t count = quantiles->count;
+    for (unsigned i = 0; i < quantiles->n; ++i) {
+        struct adc_p2 *e = &quantiles->estimators[i];
+        if (count < 5) {
+            // the first five samples become the initial markers
+            insert_sorted(e->heights, count, x);
+        } else {
+            p2_update(e, x, count + 1);
+        }
+    }
+    quantiles->count = count + 1;
+}
+
+float adc_quantiles_get(const struct adc_quantiles *quantiles, unsigned i)
+{
+    const struct adc_p2 *e = &quantiles->estimators[i];
+    if (quantiles->count < 5) {
+        // nearest rank over the samples so far
+        unsigned rank = (unsigned) (e->p * quantiles->count);
+        if (rank >= quantiles->count) {
+            rank = quantiles->count - 1;
+        }
+        return e->heights[rank];
+    }
+    return e->heights[2];
+}
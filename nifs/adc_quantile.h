@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_QUANTILE_H__
+#define __ADC_QUANTILE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// Streaming quantile estimation with the P-square algorithm (Jain and
+// Chlamtac, 1985), which keeps five markers per quantile instead of the
+// samples themselves.
+//
+
+#define ADC_QUANTILES_MAX 8
+
+struct adc_p2
+{
+    float p;
+    float heights[5];
+    int64_t positions[5];
+    // desired positions are 1 + (count - 1) * increment, computed from the
+    // count on every sample, as sums of increments lose precision
+    float increments[5];
+};
+
+struct adc_quantiles
+{
+    uint64_t count;
+    uint8_t n;
+    struct adc_p2 estimators[ADC_QUANTILES_MAX];
+};
+
+//
+// Set up estimators for n quantiles, each strictly between 0 and 1.
+//
+bool adc_quantiles_init(struct adc_quantiles *quantiles, const float *p, unsigned n);
+void adc_quantiles_update(struct adc_quantiles *quantiles, float x);
+
+//
+// The current estimate of the ith quantile; exact while there are fewer
+// than five samples.  There must be at least one sample.
+//
+float adc_quantiles_get(const struct adc_quantiles *quantiles, unsigned i);
+
+#endif
@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_reduce.h"
+
+uint32_t adc_reduce_mean(const uint16_t *samples, size_t n)
+{
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += samples[i];
+    }
+    return (sum + n / 2) / n;
+}
+
+static inline void swap(uint16_t *a, uint16_t *b)
+{
+    uint16_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// Hoare's selection: afterwards samples[k] is the k-th smallest sample, with
+// no larger sample before it and no smaller one after it
+static void select_kth(uint16_t *samples, size_t n, size_t k)
+{
+    size_t lo = 0;
+    size_t hi = n - 1;
+    while (lo < hi) {
+        // median of three pivot, which also guards both scans
+        size_t mid = lo + (hi - lo) / 2;
+        if (samples[mid] < samples[lo]) {
+            swap(&samples[mid], &samples[lo]);
+        }
+        if (samples[hi] < samples[lo]) {
+            swap(&samples[hi], &samples[lo]);
+        }
+        if (samples[hi] < samples[mid]) {
+            swap(&samples[hi], &samples[mid]);
+        }
+        uint16_t pivot = samples[mid];
+        size_t i = lo;
+        size_t j = hi;
+        while (i <= j) {
+            while (samples[i] < pivot) {
+                ++i;
+            }
+            while (samples[j] > pivot) {
+                --j;
+            }
+            if (i <= j) {
+                swap(&samples[i], &samples[j]);
+                ++i;
+                if (j == 0) {
+                    break;
+                }
+                --j;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return;
+        }
+    }
+}
+
+uint32_t adc_reduce_median(uint16_t *samples, size_t n)
+{
+    if (n == 0) {
+        return 0;
+    }
+    size_t half = n / 2;
+    select_kth(samples, n, half);
+    if (n & 1) {
+        return samples[half];
+    }
+    // the lower middle sample is the largest of the lower half
+    uint16_t lower = samples[0];
+    for (size_t i = 1; i < half; ++i) {
+        if (samples[i] > lower) {
+            lower = samples[i];
+        }
+    }
+    return ((uint32_t) lower + samples[half] + 1) / 2;
+}
+
+uint32_t adc_reduce_trimmed_mean(uint16_t *samples, size_t n, unsigned trim_per_mille)
+{
+    if (trim_per_mille >= 500) {
+        return adc_reduce_median(samples, n);
+    }
+    size_t trim = n * trim_per_mille / 1000;
+    if (trim == 0) {
+        return adc_reduce_mean(samples, n);
+    }
+    // the trim smallest samples go before trim, then the n - 2 * trim
+    // smallest of the rest right after them
+    select_kth(samples, n, trim);
+    select_kth(samples + trim, n - trim, n - 2 * trim - 1);
+    return adc_reduce_mean(samples + trim, n - 2 * trim);
+}
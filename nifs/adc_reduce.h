@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_REDUCE_H__
+#define __ADC_REDUCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Reductions of blocks of samples to a single value.  The median and the
+// trimmed mean select in place, and so reorder the block.  Results are
+// rounded to the nearest integer.
+//
+
+uint32_t adc_reduce_mean(const uint16_t *samples, size_t n);
+uint32_t adc_reduce_median(uint16_t *samples, size_t n);
+
+//
+// Mean of the samples left after dropping trim_per_mille of the samples at
+// each end, e.g. 250 for the interquartile mean.
+//
+uint32_t adc_reduce_trimmed_mean(uint16_t *samples, size_t n, unsigned trim_per_mille);
+
+#endif
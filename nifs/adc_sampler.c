@@ -0,0 +1,693 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_sampler.h"
+
+#include <defaultatoms.h>
+#include <interop.h>
+#include <memory.h>
+#include <term.h>
+
+// #define ENABLE_TRACE
+#include <trace.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS_SIZE(n) ((n) * (CONS_SIZE + TUPLE_SIZE(2) + FLOAT_SIZE))
+#define POWER_METRICS 4
+#define POWER_EVENT_SIZE (TUPLE_SIZE(3) + BOXED_INT64_SIZE + METRICS_SIZE(POWER_METRICS))
+// {Min, Mean, Max}
+#define PULSE_STATS_SIZE (TUPLE_SIZE(3) + 3 * BOXED_INT64_SIZE)
+#define PULSE_EVENT_SIZE (TUPLE_SIZE(3) + BOXED_INT64_SIZE + 4 * (CONS_SIZE + TUPLE_SIZE(2)) + 2 * PULSE_STATS_SIZE)
+#define HEALTH_EVENT_SIZE (TUPLE_SIZE(3) + BOXED_INT64_SIZE)
+#define PHASE_METRICS 3
+#define PHASE_EVENT_SIZE (TUPLE_SIZE(3) + BOXED_INT64_SIZE + METRICS_SIZE(PHASE_METRICS))
+
+#if defined(CONFIG_AVM_ADC_STREAM_ENABLE) || defined(CONFIG_AVM_ADC_ENVELOPE_ENABLE) || defined(CONFIG_AVM_ADC_POWER_ENABLE) \
+    || defined(CONFIG_AVM_ADC_PHASE_ENABLE) || defined(CONFIG_AVM_ADC_PULSE_ENABLE) || defined(CONFIG_AVM_ADC_HEALTH_ENABLE)
+#define SAMPLER_EVENTS
+#endif
+
+struct adc_sampler *adc_sampler_new(void)
+{
+    struct adc_sampler *sampler = calloc(1, sizeof(struct adc_sampler));
+    if (IS_NULL_PTR(sampler)) {
+        return NULL;
+    }
+    portMUX_INITIALIZE(&sampler->lock);
+#ifdef CONFIG_PM_ENABLE
+    // keep the APB clock (and so the sample timing) stable while the sampler runs
+    if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "adc_sampler", &sampler->pm_lock) == ESP_OK) {
+        esp_pm_lock_acquire(sampler->pm_lock);
+    } else {
+        sampler->pm_lock = NULL;
+    }
+#endif
+    return sampler;
+}
+
+void adc_sampler_destroy(struct adc_sampler *sampler)
+{
+#ifdef CONFIG_PM_ENABLE
+    if (sampler->pm_lock != NULL) {
+        esp_pm_lock_release(sampler->pm_lock);
+        esp_pm_lock_delete(sampler->pm_lock);
+    }
+#endif
+    if (sampler->pending != NULL) {
+        free(sampler->pending->filter);
+        free(sampler->pending);
+    }
+    free(sampler->filter);
+    free(sampler->quantiles);
+    free(sampler->jitter);
+    free(sampler->envelope);
+    free(sampler->power);
+    free(sampler->pulse);
+    free(sampler->health);
+#ifdef CONFIG_AVM_ADC_PHASE_ENABLE
+    if (sampler->phase != NULL) {
+        adc_phase_destroy(sampler->phase);
+        free(sampler->phase);
+    }
+#endif
+    free(sampler->block);
+    free(sampler->smoothed);
+    free(sampler->smooth);
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+    if (sampler->sink != NULL) {
+        adc_sink_release(sampler->sink);
+    }
+#endif
+    free(sampler);
+}
+
+bool adc_sampler_set_stream(struct adc_sampler *sampler, size_t block_size, struct adc_smooth *smooth)
+{
+    sampler->block = malloc(block_size * sizeof(uint16_t));
+    if (smooth != NULL) {
+        sampler->smoothed = malloc(block_size * sizeof(uint16_t));
+    }
+    sampler->smooth = smooth;
+    if (IS_NULL_PTR(sampler->block) || (smooth != NULL && IS_NULL_PTR(sampler->smoothed))) {
+        return false;
+    }
+    sampler->block_size = block_size;
+    sampler->block_fill = 0;
+    return true;
+}
+
+#ifdef SAMPLER_EVENTS
+typedef term (*make_event_t)(struct adc_sampler *sampler, const void *data, Heap *heap);
+
+static void send_event(struct adc_sampler *sampler, size_t event_size, make_event_t make_event, const void *data)
+{
+    GlobalContext *global = sampler->global;
+
+    // {adc_sampler, Ref, Event}
+    BEGIN_WITH_STACK_HEAP(TUPLE_SIZE(3) + REF_SIZE + event_size, heap)
+    term msg = term_alloc_tuple(3, &heap);
+    term_put_tuple_element(msg, 0, globalcontext_make_atom(global, ATOM_STR("\xb", "adc_sampler")));
+    term_put_tuple_element(msg, 1, term_from_ref_ticks(sampler->ref_ticks, &heap));
+    term_put_tuple_element(msg, 2, make_event(sampler, data, &heap));
+    globalcontext_send_message(global, sampler->owner, msg);
+    END_WITH_STACK_HEAP(heap, global)
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+// {block, Sequence, Timestamp, Samples}
+#define BLOCK_EVENT_SIZE(n) (TUPLE_SIZE(4) + 2 * BOXED_INT64_SIZE + term_binary_heap_size((n) * sizeof(uint16_t)))
+// {gap, Sequence, Timestamp, LostSamples}
+#define GAP_EVENT_SIZE (TUPLE_SIZE(4) + 3 * BOXED_INT64_SIZE)
+// {reconfigured, Sequence, Timestamp}
+#define CONFIG_EVENT_SIZE (TUPLE_SIZE(3) + 2 * BOXED_INT64_SIZE)
+
+// a sample frame, a gap record or a config record, by info.type
+struct stream_frame
+{
+    struct adc_frame_info info;
+    const uint16_t *samples;
+    size_t n;
+    const struct adc_frame_gap *gap;
+};
+
+static term make_block_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct stream_frame *frame = (const struct stream_frame *) data;
+
+    term event = term_alloc_tuple(4, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(sampler->global, ATOM_STR("\x5", "block")));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(frame->info.sequence, heap));
+    term_put_tuple_element(event, 2, term_make_maybe_boxed_int64(frame->info.timestamp_us, heap));
+    term_put_tuple_element(event, 3, term_from_literal_binary(frame->samples, frame->n * sizeof(uint16_t), heap, sampler->global));
+    return event;
+}
+
+static term make_gap_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct stream_frame *frame = (const struct stream_frame *) data;
+
+    term event = term_alloc_tuple(4, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(sampler->global, ATOM_STR("\x3", "gap")));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(frame->info.sequence, heap));
+    term_put_tuple_element(event, 2, term_make_maybe_boxed_int64(frame->info.timestamp_us, heap));
+    term_put_tuple_element(event, 3, term_make_maybe_boxed_int64(frame->gap->samples, heap));
+    return event;
+}
+
+static term make_config_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct stream_frame *frame = (const struct stream_frame *) data;
+
+    term event = term_alloc_tuple(3, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(sampler->global, ATOM_STR("\xc", "reconfigured")));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(frame->info.sequence, heap));
+    term_put_tuple_element(event, 2, term_make_maybe_boxed_int64(frame->info.timestamp_us, heap));
+    return event;
+}
+
+// Returns false if the frame was dropped
+static bool stream_write(struct adc_sampler *sampler, const struct stream_frame *frame)
+{
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+    if (sampler->sink != NULL) {
+        // a full sink drops the frame and counts it, sampling goes on
+        switch (frame->info.type) {
+            case ADC_FRAME_GAP:
+                return adc_sink_write_gap(sampler->sink, &frame->info, frame->gap);
+            case ADC_FRAME_CONFIG:
+                return adc_sink_write_config(sampler->sink, &frame->info, sampler->atten, sampler->oversample);
+            default:
+                return adc_sink_write(sampler->sink, &frame->info, frame->samples, frame->n);
+        }
+    }
+#endif
+    switch (frame->info.type) {
+        case ADC_FRAME_GAP:
+            send_event(sampler, GAP_EVENT_SIZE, make_gap_event, frame);
+            break;
+        case ADC_FRAME_CONFIG:
+            send_event(sampler, CONFIG_EVENT_SIZE, make_config_event, frame);
+            break;
+        default:
+            send_event(sampler, BLOCK_EVENT_SIZE(frame->n), make_block_event, frame);
+            break;
+    }
+    return true;
+}
+
+static void stream_lose(struct adc_sampler *sampler, const struct stream_frame *frame)
+{
+    adc_frame_gap_add_frame(&sampler->gap, frame->info.sequence, frame->n, frame->info.timestamp_us);
+
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->stream_stats.lost_frames++;
+    sampler->stream_stats.lost_samples += frame->n;
+    portEXIT_CRITICAL(&sampler->lock);
+}
+
+static void stream_gap(struct adc_sampler *sampler)
+{
+    struct stream_frame frame = {
+        .info = {
+            .type = ADC_FRAME_GAP,
+            .source = sampler->source,
+            .sequence = sampler->sequence++,
+            .timestamp_us = sampler->gap.timestamp_us,
+            .period_us = sampler->period_us },
+        .gap = &sampler->gap
+    };
+    if (!stream_write(sampler, &frame)) {
+        // reported by the next gap record instead
+        stream_lose(sampler, &frame);
+        return;
+    }
+    memset(&sampler->gap, 0, sizeof(sampler->gap));
+
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->stream_stats.gaps++;
+    portEXIT_CRITICAL(&sampler->lock);
+}
+
+static void stream_block(struct adc_sampler *sampler, size_t n)
+{
+    const uint16_t *samples = sampler->block;
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+    if (sampler->smooth != NULL) {
+        adc_smooth_apply(sampler->smooth, sampler->block, sampler->smoothed, n);
+        samples = sampler->smoothed;
+    }
+#endif
+    if (adc_frame_gap_pending(&sampler->gap)) {
+        stream_gap(sampler);
+    }
+    struct stream_frame frame = {
+        .info = {
+            .type = ADC_FRAME_SAMPLES,
+            .source = sampler->source,
+            .sequence = sampler->sequence++,
+            .timestamp_us = sampler->block_start_us,
+            .period_us = sampler->period_us },
+        .samples = samples,
+        .n = n
+    };
+    // no frame overtakes a gap that is not reported yet
+    if (adc_frame_gap_pending(&sampler->gap) || !stream_write(sampler, &frame)) {
+        stream_lose(sampler, &frame);
+        return;
+    }
+
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->stream_stats.frames++;
+    portEXIT_CRITICAL(&sampler->lock);
+}
+
+static void stream_sample(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t mv)
+{
+    if (sampler->block_fill == 0) {
+        sampler->block_start_us = timestamp_us;
+    }
+    sampler->block[sampler->block_fill++] = mv > UINT16_MAX ? UINT16_MAX : mv;
+    if (sampler->block_fill == sampler->block_size) {
+        stream_block(sampler, sampler->block_fill);
+        sampler->block_fill = 0;
+    }
+}
+
+// Send the block collected so far, cut short
+static void stream_cut(struct adc_sampler *sampler)
+{
+    if (sampler->block_fill > 0) {
+        stream_block(sampler, sampler->block_fill);
+        sampler->block_fill = 0;
+    }
+}
+
+// Mark where the configuration changed, from timestamp_us on
+static void stream_config(struct adc_sampler *sampler, int64_t timestamp_us)
+{
+    if (adc_frame_gap_pending(&sampler->gap)) {
+        stream_gap(sampler);
+    }
+    struct stream_frame frame = {
+        .info = {
+            .type = ADC_FRAME_CONFIG,
+            .source = sampler->source,
+            .sequence = sampler->sequence++,
+            .timestamp_us = timestamp_us,
+            .period_us = sampler->period_us }
+    };
+    if (adc_frame_gap_pending(&sampler->gap) || !stream_write(sampler, &frame)) {
+        stream_lose(sampler, &frame);
+    }
+}
+
+static void stream_skip(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t skipped)
+{
+    // cut the block short, so that the timestamps of its samples stay right
+    stream_cut(sampler);
+    adc_frame_gap_add_samples(&sampler->gap, skipped, timestamp_us);
+
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->stream_stats.lost_samples += skipped;
+    portEXIT_CRITICAL(&sampler->lock);
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_ENVELOPE_ENABLE
+static term make_peak_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct adc_peak *peak = (const struct adc_peak *) data;
+
+    // {peak, Timestamp, Amplitude}
+    term event = term_alloc_tuple(3, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(sampler->global, ATOM_STR("\x4", "peak")));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(peak->timestamp_us, heap));
+    term_put_tuple_element(event, 2, term_from_int32(peak->amplitude_mv));
+    return event;
+}
+#endif
+
+#if defined(CONFIG_AVM_ADC_POWER_ENABLE) || defined(CONFIG_AVM_ADC_PHASE_ENABLE)
+// [{Key, Float}, ...]
+static term make_metrics(GlobalContext *global, const char *const keys[], const float values[], int n, Heap *heap)
+{
+    term metrics = term_nil();
+    for (int i = n - 1; i >= 0; --i) {
+        term metric = term_alloc_tuple(2, heap);
+        term_put_tuple_element(metric, 0, globalcontext_make_atom(global, keys[i]));
+        term_put_tuple_element(metric, 1, term_from_float(values[i], heap));
+        metrics = term_list_prepend(metric, metrics, heap);
+    }
+    return metrics;
+}
+#endif
+
+#if defined(CONFIG_AVM_ADC_POWER_ENABLE) || defined(CONFIG_AVM_ADC_PHASE_ENABLE) || defined(CONFIG_AVM_ADC_PULSE_ENABLE)
+static term make_metrics_event(GlobalContext *global, AtomString name, int64_t timestamp_us, term metrics, Heap *heap)
+{
+    term event = term_alloc_tuple(3, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(global, name));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(timestamp_us, heap));
+    term_put_tuple_element(event, 2, metrics);
+    return event;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_POWER_ENABLE
+static term make_power_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct adc_power_report *report = (const struct adc_power_report *) data;
+
+    // {power, Timestamp, [{rms, RMS}, {fundamental, Amplitude}, {thd, THD}, {crest_factor, CrestFactor}]}
+    static const char *const keys[POWER_METRICS] = {
+        ATOM_STR("\x3", "rms"),
+        ATOM_STR("\xb", "fundamental"),
+        ATOM_STR("\x3", "thd"),
+        ATOM_STR("\xc", "crest_factor")
+    };
+    const float values[POWER_METRICS] = { report->rms, report->fundamental, report->thd, report->crest_factor };
+    term metrics = make_metrics(sampler->global, keys, values, POWER_METRICS, heap);
+    return make_metrics_event(sampler->global, ATOM_STR("\x5", "power"), report->timestamp_us, metrics, heap);
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_PULSE_ENABLE
+static term make_pulse_stats(const struct adc_pulse_stats *stats, Heap *heap)
+{
+    term ret = term_alloc_tuple(3, heap);
+    term_put_tuple_element(ret, 0, term_make_maybe_boxed_int64(stats->min_us, heap));
+    term_put_tuple_element(ret, 1, term_make_maybe_boxed_int64(stats->count > 0 ? stats->sum_us / stats->count : 0, heap));
+    term_put_tuple_element(ret, 2, term_make_maybe_boxed_int64(stats->max_us, heap));
+    return ret;
+}
+
+static term make_pulse_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct adc_pulse_report *report = (const struct adc_pulse_report *) data;
+    GlobalContext *global = sampler->global;
+
+    // {pulse, Timestamp, [{pulses, N}, {width, Stats}, {period, Stats}, {duty, PerMille}]}
+    const char *const keys[] = {
+        ATOM_STR("\x6", "pulses"),
+        ATOM_STR("\x5", "width"),
+        ATOM_STR("\x6", "period"),
+        ATOM_STR("\x4", "duty")
+    };
+    term values[] = {
+        term_from_int32(report->widths.count),
+        make_pulse_stats(&report->widths, heap),
+        make_pulse_stats(&report->periods, heap),
+        term_from_int32(report->duty)
+    };
+    term metrics = term_nil();
+    for (int i = 3; i >= 0; --i) {
+        term metric = term_alloc_tuple(2, heap);
+        term_put_tuple_element(metric, 0, globalcontext_make_atom(global, keys[i]));
+        term_put_tuple_element(metric, 1, values[i]);
+        metrics = term_list_prepend(metric, metrics, heap);
+    }
+    return make_metrics_event(global, ATOM_STR("\x5", "pulse"), report->timestamp_us, metrics, heap);
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_HEALTH_ENABLE
+static const char *const health_atoms[] = {
+    [ADC_HEALTH_UNKNOWN] = ATOM_STR("\x7", "unknown"),
+    [ADC_HEALTH_OK] = ATOM_STR("\x2", "ok"),
+    [ADC_HEALTH_STUCK] = ATOM_STR("\x5", "stuck"),
+    [ADC_HEALTH_SATURATED_LOW] = ATOM_STR("\xd", "saturated_low"),
+    [ADC_HEALTH_SATURATED_HIGH] = ATOM_STR("\xe", "saturated_high"),
+    [ADC_HEALTH_OPEN] = ATOM_STR("\x4", "open")
+};
+
+static term make_health_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const int64_t *timestamp_us = (const int64_t *) data;
+
+    // {health, Timestamp, State}
+    term event = term_alloc_tuple(3, heap);
+    term_put_tuple_element(event, 0, globalcontext_make_atom(sampler->global, ATOM_STR("\x6", "health")));
+    term_put_tuple_element(event, 1, term_make_maybe_boxed_int64(*timestamp_us, heap));
+    term_put_tuple_element(event, 2, globalcontext_make_atom(sampler->global, health_atoms[sampler->health->state]));
+    return event;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_PHASE_ENABLE
+static term make_phase_event(struct adc_sampler *sampler, const void *data, Heap *heap)
+{
+    const struct adc_phase_report *report = (const struct adc_phase_report *) data;
+
+    // {phase, Timestamp, [{lag, Microseconds}, {phase, Degrees}, {power_factor, PowerFactor}]}
+    static const char *const keys[PHASE_METRICS] = {
+        ATOM_STR("\x3", "lag"),
+        ATOM_STR("\x5", "phase"),
+        ATOM_STR("\xc", "power_factor")
+    };
+    const float values[PHASE_METRICS] = { report->lag_us, report->phase, report->power_factor };
+    term metrics = make_metrics(sampler->global, keys, values, PHASE_METRICS, heap);
+    return make_metrics_event(sampler->global, ATOM_STR("\x5", "phase"), report->timestamp_us, metrics, heap);
+}
+
+#endif
+
+void adc_sampler_process_pair(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t mv, uint32_t mv2, int64_t skew_us)
+{
+#ifdef CONFIG_AVM_ADC_PHASE_ENABLE
+    struct adc_phase_report report;
+    if (adc_phase_update(sampler->phase, timestamp_us, mv, mv2, skew_us, &report)) {
+        send_event(sampler, PHASE_EVENT_SIZE, make_phase_event, &report);
+    }
+#else
+    UNUSED(sampler);
+    UNUSED(timestamp_us);
+    UNUSED(mv);
+    UNUSED(mv2);
+    UNUSED(skew_us);
+#endif
+}
+
+void adc_sampler_get_config(struct adc_sampler *sampler, struct adc_sampler_config *config)
+{
+    portENTER_CRITICAL(&sampler->lock);
+    if (sampler->pending != NULL) {
+        *config = *sampler->pending;
+    } else {
+        config->atten = sampler->atten;
+        config->adc_chars = sampler->adc_chars;
+        config->period_us = sampler->period_us;
+        config->oversample = sampler->oversample;
+    }
+    portEXIT_CRITICAL(&sampler->lock);
+    config->set_filter = false;
+    config->filter = NULL;
+}
+
+void adc_sampler_reconfigure(struct adc_sampler *sampler, struct adc_sampler_config *config)
+{
+    portENTER_CRITICAL(&sampler->lock);
+    struct adc_sampler_config *replaced = sampler->pending;
+    if (replaced != NULL && replaced->set_filter && !config->set_filter) {
+        // keep the filter of the replaced configuration
+        config->set_filter = true;
+        config->filter = replaced->filter;
+        replaced->filter = NULL;
+    }
+    sampler->pending = config;
+    portEXIT_CRITICAL(&sampler->lock);
+
+    if (replaced != NULL) {
+        free(replaced->filter);
+        free(replaced);
+    }
+}
+
+void adc_sampler_apply_config(struct adc_sampler *sampler, int64_t timestamp_us)
+{
+    // unused when streaming is not built in
+    UNUSED(timestamp_us);
+
+    portENTER_CRITICAL(&sampler->lock);
+    struct adc_sampler_config *config = sampler->pending;
+    sampler->pending = NULL;
+    portEXIT_CRITICAL(&sampler->lock);
+    if (config == NULL) {
+        return;
+    }
+
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    // samples taken before and after the change never share a block
+    if (sampler->block != NULL) {
+        stream_cut(sampler);
+    }
+#endif
+    if (config->atten != sampler->atten) {
+        adc_acq_config_atten(&sampler->ch, config->atten);
+    }
+
+    struct adc_filter *replaced = NULL;
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->atten = config->atten;
+    sampler->adc_chars = config->adc_chars;
+    sampler->oversample = config->oversample;
+    if (config->set_filter) {
+        replaced = sampler->filter;
+        sampler->filter = config->filter;
+    }
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+    if (sampler->jitter != NULL && config->period_us != sampler->period_us) {
+        // the statistics are relative to the period
+        adc_jitter_init(sampler->jitter, config->period_us);
+    }
+#endif
+    sampler->period_us = config->period_us;
+    portEXIT_CRITICAL(&sampler->lock);
+    // NIFs only read the filter while holding the lock
+    free(replaced);
+    free(config);
+
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (sampler->block != NULL) {
+        stream_config(sampler, timestamp_us);
+    }
+#endif
+}
+
+void adc_sampler_tick(struct adc_sampler *sampler, int64_t timestamp_us)
+{
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+    if (sampler->jitter != NULL) {
+        portENTER_CRITICAL(&sampler->lock);
+        adc_jitter_update(sampler->jitter, timestamp_us);
+        portEXIT_CRITICAL(&sampler->lock);
+    }
+#else
+    UNUSED(sampler);
+    UNUSED(timestamp_us);
+#endif
+}
+
+void adc_sampler_overrun(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t skipped)
+{
+    // unused when neither jitter nor streaming is built in
+    UNUSED(sampler);
+    UNUSED(timestamp_us);
+    UNUSED(skipped);
+
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+    if (sampler->jitter != NULL) {
+        portENTER_CRITICAL(&sampler->lock);
+        adc_jitter_missed(sampler->jitter, skipped);
+        portEXIT_CRITICAL(&sampler->lock);
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (sampler->block != NULL) {
+        stream_skip(sampler, timestamp_us, skipped);
+    }
+#endif
+}
+
+void adc_sampler_error(struct adc_sampler *sampler, int64_t timestamp_us)
+{
+    // unused when streaming is not built in
+    UNUSED(timestamp_us);
+
+    portENTER_CRITICAL(&sampler->lock);
+    sampler->errors++;
+    portEXIT_CRITICAL(&sampler->lock);
+
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (sampler->block != NULL) {
+        stream_skip(sampler, timestamp_us, 1);
+    }
+#endif
+}
+
+void adc_sampler_flush(struct adc_sampler *sampler)
+{
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (sampler->block == NULL) {
+        return;
+    }
+    // the samples collected so far go out as a short block, or are counted lost
+    stream_cut(sampler);
+    if (adc_frame_gap_pending(&sampler->gap)) {
+        stream_gap(sampler);
+    }
+#else
+    UNUSED(sampler);
+#endif
+}
+
+void adc_sampler_process(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t raw, uint32_t mv)
+{
+    // unused when none of the processors using them are built in
+    UNUSED(timestamp_us);
+    UNUSED(raw);
+
+    portENTER_CRITICAL(&sampler->lock);
+#ifdef CONFIG_AVM_ADC_FILTER_ENABLE
+    if (sampler->filter != NULL) {
+        adc_filter_update(sampler->filter, mv);
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_QUANTILES_ENABLE
+    if (sampler->quantiles != NULL) {
+        adc_quantiles_update(sampler->quantiles, mv);
+    }
+#endif
+    portEXIT_CRITICAL(&sampler->lock);
+
+#ifdef CONFIG_AVM_ADC_ENVELOPE_ENABLE
+    if (sampler->envelope != NULL) {
+        struct adc_peak peak;
+        if (adc_envelope_update(sampler->envelope, timestamp_us, mv, &peak)) {
+            send_event(sampler, TUPLE_SIZE(3) + BOXED_INT64_SIZE, make_peak_event, &peak);
+        }
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_POWER_ENABLE
+    if (sampler->power != NULL) {
+        struct adc_power_report report;
+        if (adc_power_update(sampler->power, timestamp_us, mv, &report)) {
+            send_event(sampler, POWER_EVENT_SIZE, make_power_event, &report);
+        }
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_HEALTH_ENABLE
+    if (sampler->health != NULL && adc_health_update(sampler->health, raw, mv)) {
+        send_event(sampler, HEALTH_EVENT_SIZE, make_health_event, &timestamp_us);
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_PULSE_ENABLE
+    if (sampler->pulse != NULL) {
+        struct adc_pulse_report report;
+        if (adc_pulse_update(sampler->pulse, timestamp_us, mv, &report)) {
+            send_event(sampler, PULSE_EVENT_SIZE, make_pulse_event, &report);
+        }
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (sampler->block != NULL) {
+        stream_sample(sampler, timestamp_us, mv);
+    }
+#endif
+}
@@ -0,0 +1,208 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_SAMPLER_H__
+#define __ADC_SAMPLER_H__
+
+#include "adc_acq.h"
+#include "adc_envelope.h"
+#include "adc_filter.h"
+#include "adc_health.h"
+#include "adc_jitter.h"
+#include "adc_phase.h"
+#include "adc_power.h"
+#include "adc_pulse.h"
+#include "adc_quantile.h"
+#include "adc_sink.h"
+#include "adc_smooth.h"
+
+#include <globalcontext.h>
+
+#include <esp_adc_cal.h>
+#include <freertos/FreeRTOS.h>
+#include <sdkconfig.h>
+#ifdef CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ADC_SAMPLER_MAX_RATE 10000
+#define ADC_SAMPLER_MAX_BLOCK 4096
+
+//
+// Cumulative stream counters.  Frames and gaps count the sample frames and
+// gap records delivered, lost_frames those dropped because the sink buffer
+// was full (delivery to the owner never fails), and lost_samples all samples
+// that did not make it into a delivered frame, whether the frame was
+// dropped, or the samples were never taken because of overruns or
+// conversion errors.
+//
+struct adc_stream_stats
+{
+    uint64_t frames;
+    uint64_t gaps;
+    uint64_t lost_frames;
+    uint64_t lost_samples;
+};
+
+//
+// A configuration for a running sampler, set with adc_sampler_reconfigure
+// and applied by the acquisition task in between two samples.  The filter
+// replaces the sampler's, or removes it if NULL, when set_filter is true.
+//
+struct adc_sampler_config
+{
+    adc_atten_t atten;
+    esp_adc_cal_characteristics_t adc_chars;
+    int64_t period_us;
+    avm_int_t oversample;
+    bool set_filter;
+    struct adc_filter *filter;
+};
+
+//
+// A background sampler.  Samplers are periodically serviced by the
+// acquisition task, which owns them from adc_acq_sampler_start until they
+// are destroyed after adc_acq_sampler_stop.
+//
+// Each sample is passed through the processors enabled for the sampler.
+// Processor state is updated by the acquisition task and read by NIFs, so
+// it must only be accessed while holding `lock', as must the configuration
+// (attenuation, calibration, period and oversampling) outside of the
+// acquisition task, and the pending configuration.  Envelopes, power metrics,
+// pulse and phase measurements, health checks and stream blocks are only
+// touched by the acquisition task, except for the stream counters.
+//
+struct adc_sampler
+{
+    struct adc_sampler *next;
+    GlobalContext *global;
+    int32_t owner;
+    uint64_t ref_ticks;
+
+    struct adc_acq_channel ch;
+    adc_atten_t atten;
+    esp_adc_cal_characteristics_t adc_chars;
+    avm_int_t oversample;
+    int64_t period_us;
+    int64_t next_due_us;
+    volatile bool stopping;
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock;
+#endif
+
+    portMUX_TYPE lock;
+    struct adc_sampler_config *pending;
+    uint32_t errors;
+    // processors; NULL when not enabled
+    struct adc_filter *filter;
+    struct adc_quantiles *quantiles;
+    struct adc_jitter *jitter;
+    struct adc_envelope *envelope;
+    struct adc_power *power;
+    struct adc_pulse *pulse;
+    struct adc_health *health;
+    // two channel processors, over pairs of ch and ch2
+    struct adc_acq_channel ch2;
+    esp_adc_cal_characteristics_t adc_chars2;
+    struct adc_phase *phase;
+
+    // streaming; block is NULL when not enabled.  Blocks are written to sink
+    // as frames from `source' instead of sent to the owner when it is set.
+    // Losses are held in gap until they are reported
+    uint16_t *block;
+    uint16_t *smoothed;
+    size_t block_size;
+    size_t block_fill;
+    int64_t block_start_us;
+    struct adc_smooth *smooth;
+    struct adc_sink *sink;
+    uint16_t source;
+    uint32_t sequence;
+    struct adc_frame_gap gap;
+    struct adc_stream_stats stream_stats;
+};
+
+struct adc_sampler *adc_sampler_new(void);
+void adc_sampler_destroy(struct adc_sampler *sampler);
+
+//
+// Enable streaming of blocks of block_size samples to the owner, optionally
+// smoothed.  Takes ownership of smooth.
+//
+bool adc_sampler_set_stream(struct adc_sampler *sampler, size_t block_size, struct adc_smooth *smooth);
+
+//
+// Get the configuration of a sampler, including changes not applied yet.
+// The filter is not part of it; set_filter is false.
+//
+void adc_sampler_get_config(struct adc_sampler *sampler, struct adc_sampler_config *config);
+
+//
+// Change the configuration of a running sampler.  Takes ownership of config,
+// which must be allocated with malloc, and of its filter.  The acquisition
+// task applies it before the next sample; changes made in the meantime are
+// merged into it.
+//
+void adc_sampler_reconfigure(struct adc_sampler *sampler, struct adc_sampler_config *config);
+
+//
+// Called by the acquisition task before it services a sampler, to apply a
+// pending configuration from timestamp_us on.
+//
+void adc_sampler_apply_config(struct adc_sampler *sampler, int64_t timestamp_us);
+
+//
+// Called by the acquisition task for every sample, with the sample time,
+// the (oversampled) raw value and the calibrated voltage.
+//
+void adc_sampler_process(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t raw, uint32_t mv);
+
+//
+// Called by the acquisition task when a sample is due, with the time it is
+// taken, whether or not the conversion succeeds.
+//
+void adc_sampler_tick(struct adc_sampler *sampler, int64_t timestamp_us);
+
+//
+// Called by the acquisition task when it fell behind and skipped samples,
+// the first of which was due at timestamp_us.
+//
+void adc_sampler_overrun(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t skipped);
+
+//
+// Called by the acquisition task when the conversion of a sample due at
+// timestamp_us failed.
+//
+void adc_sampler_error(struct adc_sampler *sampler, int64_t timestamp_us);
+
+//
+// Called by the acquisition task before it destroys a stopped sampler, to
+// report losses not reported yet.
+//
+void adc_sampler_flush(struct adc_sampler *sampler);
+
+//
+// Called by the acquisition task for samplers with two channel processors,
+// before adc_sampler_process, with the calibrated voltages of both channels
+// and the time between the start of their conversions.
+//
+void adc_sampler_process_pair(struct adc_sampler *sampler, int64_t timestamp_us, uint32_t mv, uint32_t mv2, int64_t skew_us);
+
+#endif
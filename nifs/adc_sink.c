@@ -0,0 +1,571 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_sink.h"
+
+#include <driver/uart.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#include <soc/soc_caps.h>
+#if SOC_USB_SERIAL_JTAG_SUPPORTED
+#include <driver/usb_serial_jtag.h>
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+#include <lwip/sockets.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "atomvm_adc"
+#define SINK_TASK_STACK_SIZE 3072
+// below the acquisition task, which must never wait for a sink
+#define SINK_TASK_PRIORITY (CONFIG_AVM_ADC_ACQ_TASK_PRIORITY > 1 ? CONFIG_AVM_ADC_ACQ_TASK_PRIORITY - 1 : 1)
+#define SINK_CHUNK_SIZE 512
+#define SINK_POLL_MS 100
+#define SINK_WRITE_TIMEOUT_MS 100
+// frames are queued whole by the acquisition task, so the rest of a frame
+// is never far behind its first bytes
+#define SINK_FRAME_TIMEOUT_MS 100
+// longest a connection attempt takes, and time between attempts
+#define SINK_CONNECT_RETRY_MS 1000
+// longest time a frame waits for more to fill a datagram
+#define SINK_BATCH_MS 20
+#define UART_RX_BUFFER_SIZE 256
+
+struct adc_sink
+{
+    struct adc_sink_config config;
+    StreamBufferHandle_t buffer;
+    TaskHandle_t task;
+    volatile bool closing;
+    // ADC_SINK_UDP and ADC_SINK_TCP, -1 while not connected
+    int sock;
+
+    portMUX_TYPE lock;
+    uint32_t refs;
+    struct adc_sink_stats stats;
+};
+
+static void count_write(struct adc_sink *sink, size_t bytes, bool failed)
+{
+    portENTER_CRITICAL(&sink->lock);
+    sink->stats.bytes += bytes;
+    if (bytes > 0) {
+        sink->stats.sends++;
+    }
+    if (failed) {
+        sink->stats.errors++;
+    }
+    portEXIT_CRITICAL(&sink->lock);
+}
+
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+static int net_socket(const struct adc_sink_config *config, struct sockaddr_in *addr)
+{
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(config->addr_port);
+    addr->sin_addr.s_addr = config->addr;
+    return socket(AF_INET, config->type == ADC_SINK_TCP ? SOCK_STREAM : SOCK_DGRAM, 0);
+}
+
+// TCP sinks connect, and reconnect after errors, from the sink task; frames
+// are dropped while there is no connection
+static bool tcp_connect(struct adc_sink *sink)
+{
+    if (sink->sock >= 0) {
+        return true;
+    }
+    struct sockaddr_in addr = { 0 };
+    int sock = net_socket(&sink->config, &addr);
+    if (sock < 0) {
+        return false;
+    }
+    // without blocking, as an unreachable peer would keep the sink from
+    // closing until lwIP gives up
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    bool connected = connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+    if (!connected && errno == EINPROGRESS) {
+        for (int waited = 0; waited < SINK_CONNECT_RETRY_MS && !sink->closing; waited += SINK_POLL_MS) {
+            fd_set writable;
+            FD_ZERO(&writable);
+            FD_SET(sock, &writable);
+            struct timeval poll = { .tv_sec = 0, .tv_usec = SINK_POLL_MS * 1000 };
+            int ret = select(sock + 1, NULL, &writable, NULL, &poll);
+            if (ret < 0) {
+                break;
+            }
+            if (ret > 0) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                connected = getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+                break;
+            }
+        }
+    }
+    if (!connected) {
+        close(sock);
+        return false;
+    }
+    fcntl(sock, F_SETFL, flags);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // so that a stalled peer cannot keep the sink from closing
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = SINK_WRITE_TIMEOUT_MS * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    sink->sock = sock;
+
+    portENTER_CRITICAL(&sink->lock);
+    sink->stats.connects++;
+    portEXIT_CRITICAL(&sink->lock);
+    return true;
+}
+
+static int tcp_write(struct adc_sink *sink, const uint8_t *data, size_t len)
+{
+    for (;;) {
+        int ret = send(sink->sock, data, len, 0);
+        if (ret >= 0) {
+            return ret;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && !sink->closing) {
+            // the peer is slow; the buffer fills up and frames get dropped
+            continue;
+        }
+        ESP_LOGW(TAG, "Sink connection lost (%i)", errno);
+        close(sink->sock);
+        sink->sock = -1;
+        return -1;
+    }
+}
+#endif
+
+static int port_write(struct adc_sink *sink, const uint8_t *data, size_t len)
+{
+    switch (sink->config.type) {
+        case ADC_SINK_UART:
+            return uart_write_bytes(sink->config.port, data, len);
+#if SOC_USB_SERIAL_JTAG_SUPPORTED
+        case ADC_SINK_USB_CDC:
+            // nobody may be listening on the USB side, so do not wait forever
+            return usb_serial_jtag_write_bytes(data, len, pdMS_TO_TICKS(SINK_WRITE_TIMEOUT_MS));
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+        case ADC_SINK_TCP:
+            return tcp_write(sink, data, len);
+#endif
+        default:
+            return -1;
+    }
+}
+
+static bool port_ready(struct adc_sink *sink)
+{
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+    if (sink->config.type == ADC_SINK_TCP) {
+        return tcp_connect(sink);
+    }
+#endif
+    (void) sink;
+    return true;
+}
+
+static esp_err_t port_open(struct adc_sink *sink)
+{
+    const struct adc_sink_config *config = &sink->config;
+    switch (config->type) {
+        case ADC_SINK_UART: {
+            if (config->port < 0 || config->port >= SOC_UART_NUM) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            const uart_config_t uart_config = {
+                .baud_rate = config->baud_rate,
+                .data_bits = UART_DATA_8_BITS,
+                .parity = UART_PARITY_DISABLE,
+                .stop_bits = UART_STOP_BITS_1,
+                .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+            };
+            esp_err_t err = uart_param_config(config->port, &uart_config);
+            if (err == ESP_OK) {
+                err = uart_set_pin(config->port, config->tx_pin, config->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+            }
+            if (err == ESP_OK) {
+                // the sink buffer absorbs bursts, so the driver only needs a
+                // small transmit buffer of its own
+                err = uart_driver_install(config->port, UART_RX_BUFFER_SIZE, 2 * SINK_CHUNK_SIZE, 0, NULL, 0);
+            }
+            return err;
+        }
+#if SOC_USB_SERIAL_JTAG_SUPPORTED
+        case ADC_SINK_USB_CDC: {
+            usb_serial_jtag_driver_config_t usb_config = {
+                .tx_buffer_size = 2 * SINK_CHUNK_SIZE,
+                .rx_buffer_size = 64
+            };
+            return usb_serial_jtag_driver_install(&usb_config);
+        }
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+        case ADC_SINK_UDP: {
+            struct sockaddr_in addr = { 0 };
+            sink->sock = net_socket(config, &addr);
+            if (sink->sock < 0) {
+                return ESP_FAIL;
+            }
+            // a connected UDP socket, so that datagrams are sent with send
+            if (connect(sink->sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+                close(sink->sock);
+                sink->sock = -1;
+                return ESP_FAIL;
+            }
+            return ESP_OK;
+        }
+        case ADC_SINK_TCP:
+            return ESP_OK;
+#endif
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+static void port_close(struct adc_sink *sink)
+{
+    const struct adc_sink_config *config = &sink->config;
+    switch (config->type) {
+        case ADC_SINK_UART:
+            uart_wait_tx_done(config->port, pdMS_TO_TICKS(SINK_WRITE_TIMEOUT_MS));
+            uart_driver_delete(config->port);
+            break;
+#if SOC_USB_SERIAL_JTAG_SUPPORTED
+        case ADC_SINK_USB_CDC:
+            usb_serial_jtag_driver_uninstall();
+            break;
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+        case ADC_SINK_UDP:
+        case ADC_SINK_TCP:
+            if (sink->sock >= 0) {
+                close(sink->sock);
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+// byte streams: UART, USB-CDC and TCP
+static void stream_loop(struct adc_sink *sink)
+{
+    uint8_t chunk[SINK_CHUNK_SIZE];
+
+    for (;;) {
+        if (!port_ready(sink)) {
+            // wait for the next attempt, but not for closing
+            for (int waited = 0; waited < SINK_CONNECT_RETRY_MS && !sink->closing; waited += SINK_POLL_MS) {
+                vTaskDelay(pdMS_TO_TICKS(SINK_POLL_MS));
+            }
+            if (sink->closing) {
+                break;
+            }
+            continue;
+        }
+        size_t n = xStreamBufferReceive(sink->buffer, chunk, sizeof(chunk), pdMS_TO_TICKS(SINK_POLL_MS));
+        if (n == 0) {
+            if (sink->closing) {
+                break;
+            }
+            continue;
+        }
+        size_t written = 0;
+        while (written < n) {
+            int ret = port_write(sink, chunk + written, n - written);
+            if (ret <= 0) {
+                break;
+            }
+            written += ret;
+        }
+        count_write(sink, written, written < n);
+    }
+}
+
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+static bool receive_all(struct adc_sink *sink, uint8_t *out, size_t len)
+{
+    size_t received = 0;
+    while (received < len) {
+        size_t n = xStreamBufferReceive(sink->buffer, out + received, len - received, pdMS_TO_TICKS(SINK_FRAME_TIMEOUT_MS));
+        if (n == 0) {
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+// Discard bytes until the magic of a frame, which is left at the start of
+// header; header[0] holds the first byte already received.
+static bool skip_to_magic(struct adc_sink *sink, uint8_t *header)
+{
+    size_t n = 1;
+    for (;;) {
+        if (n == 4) {
+            if (memcmp(header, ADC_FRAME_MAGIC, 4) == 0) {
+                return true;
+            }
+            memmove(header, header + 1, 3);
+            n = 3;
+        }
+        if (xStreamBufferReceive(sink->buffer, header + n, 1, pdMS_TO_TICKS(SINK_FRAME_TIMEOUT_MS)) == 0) {
+            return false;
+        }
+        n++;
+    }
+}
+
+static void send_datagram(struct adc_sink *sink, const uint8_t *data, size_t len)
+{
+    int ret = send(sink->sock, data, len, 0);
+    count_write(sink, ret > 0 ? ret : 0, ret != (int) len);
+}
+
+// UDP: whole frames, batched into datagrams of at most datagram_size bytes
+// or SINK_BATCH_MS worth of frames, whichever comes first.  Larger frames
+// are sent on their own, fragmented by IP.
+static void datagram_loop(struct adc_sink *sink)
+{
+    size_t limit = sink->config.datagram_size;
+    size_t capacity = limit;
+    uint8_t *batch = malloc(capacity);
+    if (batch == NULL) {
+        ESP_LOGE(TAG, "Out of memory in sink task");
+        return;
+    }
+    size_t fill = 0;
+    TickType_t batch_start = 0;
+    bool synced = true;
+
+    for (;;) {
+        TickType_t wait = pdMS_TO_TICKS(SINK_POLL_MS);
+        if (fill > 0) {
+            TickType_t elapsed = xTaskGetTickCount() - batch_start;
+            wait = elapsed < pdMS_TO_TICKS(SINK_BATCH_MS) ? pdMS_TO_TICKS(SINK_BATCH_MS) - elapsed : 0;
+        }
+        uint8_t header[ADC_FRAME_HEADER_SIZE];
+        if (xStreamBufferReceive(sink->buffer, header, 1, wait) == 0) {
+            if (fill > 0) {
+                send_datagram(sink, batch, fill);
+                fill = 0;
+            } else if (sink->closing) {
+                break;
+            }
+            continue;
+        }
+        size_t have = 1;
+        if (!synced) {
+            if (!skip_to_magic(sink, header)) {
+                continue;
+            }
+            have = 4;
+            synced = true;
+        }
+        size_t size = 0;
+        if (receive_all(sink, header + have, sizeof(header) - have)) {
+            size = adc_frame_length(header);
+        }
+        if (size < sizeof(header) + ADC_FRAME_TRAILER_SIZE || size > sink->config.buffer_size) {
+            // cannot happen, as only whole frames are queued.  The
+            // acquisition task may be writing, so the buffer cannot be reset;
+            // skip to the next frame instead
+            ESP_LOGE(TAG, "Sink buffer out of sync");
+            synced = false;
+            continue;
+        }
+        if (fill > 0 && fill + size > limit) {
+            send_datagram(sink, batch, fill);
+            fill = 0;
+        }
+        if (size > capacity) {
+            uint8_t *larger = realloc(batch, size);
+            if (larger == NULL) {
+                ESP_LOGE(TAG, "Out of memory in sink task");
+                break;
+            }
+            batch = larger;
+            capacity = size;
+        }
+        if (!receive_all(sink, batch + fill + sizeof(header), size - sizeof(header))) {
+            ESP_LOGE(TAG, "Sink buffer out of sync");
+            synced = false;
+            continue;
+        }
+        memcpy(batch + fill, header, sizeof(header));
+        if (fill == 0) {
+            batch_start = xTaskGetTickCount();
+        }
+        fill += size;
+        // full, or a single frame larger than a datagram
+        if (fill >= limit) {
+            send_datagram(sink, batch, fill);
+            fill = 0;
+        }
+    }
+    free(batch);
+}
+#endif
+
+static void sink_task_loop(void *arg)
+{
+    struct adc_sink *sink = (struct adc_sink *) arg;
+
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+    if (sink->config.type == ADC_SINK_UDP) {
+        datagram_loop(sink);
+    } else {
+        stream_loop(sink);
+    }
+#else
+    stream_loop(sink);
+#endif
+
+    port_close(sink);
+    vStreamBufferDelete(sink->buffer);
+    free(sink);
+    vTaskDelete(NULL);
+}
+
+esp_err_t adc_sink_open(const struct adc_sink_config *config, struct adc_sink **out)
+{
+    struct adc_sink *sink = calloc(1, sizeof(struct adc_sink));
+    if (sink == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    sink->config = *config;
+    sink->sock = -1;
+    portMUX_INITIALIZE(&sink->lock);
+    sink->refs = 1;
+
+    sink->buffer = xStreamBufferCreate(config->buffer_size, 1);
+    if (sink->buffer == NULL) {
+        free(sink);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = port_open(sink);
+    if (err != ESP_OK) {
+        vStreamBufferDelete(sink->buffer);
+        free(sink);
+        return err;
+    }
+    if (xTaskCreatePinnedToCore(sink_task_loop, "adc_sink", SINK_TASK_STACK_SIZE, sink, SINK_TASK_PRIORITY, &sink->task, tskNO_AFFINITY) != pdPASS) {
+        ESP_LOGE(TAG, "Unable to create sink task");
+        port_close(sink);
+        vStreamBufferDelete(sink->buffer);
+        free(sink);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = sink;
+    return ESP_OK;
+}
+void adc_sink_retain(struct adc_sink *sink)
+{
+    portENTER_CRITICAL(&sink->lock);
+    sink->refs++;
+    portEXIT_CRITICAL(&sink->lock);
+}
+
+void adc_sink_release(struct adc_sink *sink)
+{
+    portENTER_CRITICAL(&sink->lock);
+    bool last = --sink->refs == 0;
+    portEXIT_CRITICAL(&sink->lock);
+    if (last) {
+        // the sink task frees the sink once the buffer is written out
+        sink->closing = true;
+    }
+}
+
+bool adc_sink_write(struct adc_sink *sink, const struct adc_frame_info *info, const uint16_t *samples, size_t n)
+{
+    // the acquisition task is the only writer, so the space can only grow
+    // until the whole frame is queued, and the frame is never split by
+    // another one
+    bool queued = xStreamBufferSpacesAvailable(sink->buffer) >= adc_frame_size(n);
+    if (queued) {
+        uint8_t header[ADC_FRAME_HEADER_SIZE];
+        uint8_t trailer[ADC_FRAME_TRAILER_SIZE];
+        adc_frame_encode_header(info, n, header);
+        adc_frame_encode_trailer(header, samples, n, trailer);
+        xStreamBufferSend(sink->buffer, header, sizeof(header), 0);
+        xStreamBufferSend(sink->buffer, samples, n * sizeof(uint16_t), 0);
+        xStreamBufferSend(sink->buffer, trailer, sizeof(trailer), 0);
+    }
+
+    portENTER_CRITICAL(&sink->lock);
+    if (queued) {
+        sink->stats.frames++;
+    } else {
+        sink->stats.dropped++;
+    }
+    portEXIT_CRITICAL(&sink->lock);
+    return queued;
+}
+
+bool adc_sink_write_gap(struct adc_sink *sink, const struct adc_frame_info *info, const struct adc_frame_gap *gap)
+{
+    bool queued = xStreamBufferSpacesAvailable(sink->buffer) >= ADC_FRAME_GAP_SIZE;
+    if (queued) {
+        uint8_t record[ADC_FRAME_GAP_SIZE];
+        adc_frame_encode_gap(info, gap, record);
+        xStreamBufferSend(sink->buffer, record, sizeof(record), 0);
+    }
+
+    portENTER_CRITICAL(&sink->lock);
+    if (queued) {
+        sink->stats.gaps++;
+    } else {
+        sink->stats.dropped++;
+    }
+    portEXIT_CRITICAL(&sink->lock);
+    return queued;
+}
+
+bool adc_sink_write_config(struct adc_sink *sink, const struct adc_frame_info *info, uint8_t atten, uint16_t oversample)
+{
+    bool queued = xStreamBufferSpacesAvailable(sink->buffer) >= ADC_FRAME_CONFIG_SIZE;
+    if (queued) {
+        uint8_t record[ADC_FRAME_CONFIG_SIZE];
+        adc_frame_encode_config(info, atten, oversample, record);
+        xStreamBufferSend(sink->buffer, record, sizeof(record), 0);
+    } else {
+        portENTER_CRITICAL(&sink->lock);
+        sink->stats.dropped++;
+        portEXIT_CRITICAL(&sink->lock);
+    }
+    return queued;
+}
+
+void adc_sink_get_stats(struct adc_sink *sink, struct adc_sink_stats *stats)
+{
+    portENTER_CRITICAL(&sink->lock);
+    *stats = sink->stats;
+    portEXIT_CRITICAL(&sink->lock);
+}
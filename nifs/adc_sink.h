@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_SINK_H__
+#define __ADC_SINK_H__
+
+#include "adc_frame.h"
+
+#include <esp_err.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// A sink writes frames of samples straight to a port or socket, without
+// involving the VM.  Frames are queued by the acquisition task into a byte buffer,
+// and written out by a sink task, so a slow port never delays sampling:
+// frames that do not fit in the buffer are dropped, and counted.
+//
+// Sinks are reference counted.  The last adc_sink_release lets the sink
+// task write out what is left in the buffer, and free the sink.
+//
+
+typedef enum
+{
+    ADC_SINK_UART,
+    ADC_SINK_USB_CDC,
+    ADC_SINK_UDP,
+    ADC_SINK_TCP
+} adc_sink_type_t;
+
+struct adc_sink_config
+{
+    adc_sink_type_t type;
+    size_t buffer_size;
+    // ADC_SINK_UART
+    int port;
+    int baud_rate;
+    int tx_pin;
+    int rx_pin;
+    // ADC_SINK_UDP and ADC_SINK_TCP, IPv4 address in network byte order
+    uint32_t addr;
+    uint16_t addr_port;
+    // ADC_SINK_UDP, largest datagram payload frames are batched into
+    size_t datagram_size;
+};
+
+struct adc_sink_stats
+{
+    // sample frames and gap records queued, and frames of any kind dropped,
+    // by the acquisition task.  Samplers stop writing frames after
+    // a dropped one until they can write a gap record, so the losses of a
+    // sampler are in its stream counters
+    uint64_t frames;
+    uint64_t gaps;
+    uint64_t dropped;
+    // bytes written, successful writes (datagrams for UDP), failed or short
+    // writes, and TCP connections made, by the sink task
+    uint64_t bytes;
+    uint64_t sends;
+    uint32_t errors;
+    uint32_t connects;
+};
+
+struct adc_sink;
+
+esp_err_t adc_sink_open(const struct adc_sink_config *config, struct adc_sink **sink);
+void adc_sink_retain(struct adc_sink *sink);
+void adc_sink_release(struct adc_sink *sink);
+
+//
+// Queue a frame of n samples.  Returns false if the frame was dropped.
+// Must only be called from the acquisition task.
+//
+bool adc_sink_write(struct adc_sink *sink, const struct adc_frame_info *info, const uint16_t *samples, size_t n);
+
+//
+// Queue a gap record.  Returns false if it was dropped.  Must only be called
+// from the acquisition task.
+//
+bool adc_sink_write_gap(struct adc_sink *sink, const struct adc_frame_info *info, const struct adc_frame_gap *gap);
+
+//
+// Queue a config record.  Returns false if it was dropped.  Must only be
+// called from the acquisition task.
+//
+bool adc_sink_write_config(struct adc_sink *sink, const struct adc_frame_info *info, uint8_t atten, uint16_t oversample);
+
+void adc_sink_get_stats(struct adc_sink *sink, struct adc_sink_stats *stats);
+
+#endif
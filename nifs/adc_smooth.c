@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_smooth.h"
+
+#include "adc_block.h"
+
+#include <string.h>
+
+static inline uint16_t sample_at(const uint16_t *in, size_t n, ptrdiff_t i)
+{
+    if (i < 0) {
+        return in[0];
+    }
+    if ((size_t) i >= n) {
+        return in[n - 1];
+    }
+    return in[i];
+}
+
+static inline uint16_t clamp_sample(int64_t value)
+{
+    if (value < 0) {
+        return 0;
+    }
+    if (value > UINT16_MAX) {
+        return UINT16_MAX;
+    }
+    return (uint16_t) value;
+}
+
+bool adc_smooth_init_moving_average(struct adc_smooth *smooth, unsigned window)
+{
+    if (window < 1 || window > ADC_SMOOTH_MAX_WINDOW || (window & 1) == 0) {
+        return false;
+    }
+    memset(smooth, 0, sizeof(struct adc_smooth));
+    smooth->type = ADC_SMOOTH_MOVING_AVERAGE;
+    smooth->window = window;
+    return true;
+}
+
+//
+// The smoothing coefficients of a Savitzky-Golay filter are the first row of
+// the pseudo-inverse of the Vandermonde matrix J, where J[i][j] = i^j for
+// i in -m..m and j in 0..order: c = e0^T (J^T J)^-1 J^T.  This solves
+// (J^T J) y = e0 with Gaussian elimination, then evaluates c_i = J[i] . y.
+//
+bool adc_smooth_init_savitzky_golay(struct adc_smooth *smooth, unsigned window, unsigned order)
+{
+    if (window < 3 || window > ADC_SMOOTH_MAX_WINDOW || (window & 1) == 0 || order > ADC_SMOOTH_MAX_ORDER || order >= window) {
+        return false;
+    }
+    int m = window / 2;
+    int k = order + 1;
+
+    double a[ADC_SMOOTH_MAX_ORDER + 1][ADC_SMOOTH_MAX_ORDER + 2];
+    for (int r = 0; r < k; ++r) {
+        for (int c = 0; c < k; ++c) {
+            // sum of i^(r + c); odd powers cancel out
+            double sum = 0.0;
+            if (((r + c) & 1) == 0) {
+                for (int i = -m; i <= m; ++i) {
+                    double p = 1.0;
+                    for (int e = 0; e < r + c; ++e) {
+                        p *= i;
+                    }
+                    sum += p;
+                }
+            }
+            a[r][c] = sum;
+        }
+        a[r][k] = r == 0 ? 1.0 : 0.0;
+    }
+    for (int col = 0; col < k; ++col) {
+        int pivot = col;
+        for (int r = col + 1; r < k; ++r) {
+            double x = a[r][col] < 0 ? -a[r][col] : a[r][col];
+            double y = a[pivot][col] < 0 ? -a[pivot][col] : a[pivot][col];
+            if (x > y) {
+                pivot = r;
+            }
+        }
+        if (a[pivot][col] == 0.0) {
+            return false;
+        }
+        for (int c = 0; c <= k; ++c) {
+            double t = a[col][c];
+            a[col][c] = a[pivot][c];
+            a[pivot][c] = t;
+        }
+        for (int r = 0; r < k; ++r) {
+            if (r != col) {
+                double f = a[r][col] / a[col][col];
+                for (int c = col; c <= k; ++c) {
+                    a[r][c] -= f * a[col][c];
+                }
+            }
+        }
+    }
+
+    memset(smooth, 0, sizeof(struct adc_smooth));
+    smooth->type = ADC_SMOOTH_SAVITZKY_GOLAY;
+    smooth->window = window;
+    int32_t total = 0;
+    int32_t magnitude = 0;
+    for (int i = -m; i <= m; ++i) {
+        double c = 0.0;
+        double p = 1.0;
+        for (int j = 0; j < k; ++j) {
+            c += p * a[j][k] / a[j][j];
+            p *= i;
+        }
+        double scaled = c * (1 << ADC_SMOOTH_SHIFT);
+        int32_t coeff = (int32_t) (scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+        smooth->coeffs[i + m] = coeff;
+        total += coeff;
+    }
+    // absorb the rounding error in the center tap, so that DC passes unchanged
+    smooth->coeffs[m] += (1 << ADC_SMOOTH_SHIFT) - total;
+    for (unsigned i = 0; i < window; ++i) {
+        magnitude += smooth->coeffs[i] < 0 ? -smooth->coeffs[i] : smooth->coeffs[i];
+    }
+    smooth->fir = magnitude <= 65536;
+    return true;
+}
+
+static void moving_average(unsigned window, const uint16_t *in, uint16_t *out, size_t n)
+{
+    ptrdiff_t m = window / 2;
+    uint32_t sum = 0;
+    for (ptrdiff_t i = -m; i <= m; ++i) {
+        sum += sample_at(in, n, i);
+    }
+    uint32_t half = window / 2;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = (sum + half) / window;
+        sum += sample_at(in, n, (ptrdiff_t) i + m + 1);
+        sum -= sample_at(in, n, (ptrdiff_t) i - m);
+    }
+}
+
+static void savitzky_golay_range(const struct adc_smooth *smooth, const uint16_t *in, uint16_t *out, size_t n, size_t from, size_t to)
+{
+    ptrdiff_t m = smooth->window / 2;
+    const int16_t *coeffs = smooth->coeffs + m;
+    for (size_t i = from; i < to; ++i) {
+        int64_t acc = 0;
+        if ((size_t) m <= i && i + m < n) {
+            const uint16_t *x = in + i;
+            for (ptrdiff_t j = -m; j <= m; ++j) {
+                acc += (int64_t) coeffs[j] * x[j];
+            }
+        } else {
+            for (ptrdiff_t j = -m; j <= m; ++j) {
+                acc += (int64_t) coeffs[j] * sample_at(in, n, (ptrdiff_t) i + j);
+            }
+        }
+        out[i] = clamp_sample((acc + (1 << (ADC_SMOOTH_SHIFT - 1))) >> ADC_SMOOTH_SHIFT);
+    }
+}
+
+static void savitzky_golay(const struct adc_smooth *smooth, const uint16_t *in, uint16_t *out, size_t n)
+{
+    if (smooth->fir && n >= smooth->window) {
+        uint16_t min;
+        uint16_t max;
+        adc_block_minmax(in, n, &min, &max);
+        if (max < 16384) {
+            // the windows which fit in the block are a plain FIR filter
+            size_t m = smooth->window / 2;
+            savitzky_golay_range(smooth, in, out, n, 0, m);
+            adc_block_fir(in, out + m, n, smooth->coeffs, smooth->window, ADC_SMOOTH_SHIFT);
+            savitzky_golay_range(smooth, in, out, n, n - m, n);
+            return;
+        }
+    }
+    savitzky_golay_range(smooth, in, out, n, 0, n);
+}
+
+void adc_smooth_apply(const struct adc_smooth *smooth, const uint16_t *in, uint16_t *out, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    if (smooth->type == ADC_SMOOTH_MOVING_AVERAGE) {
+        moving_average(smooth->window, in, out, n);
+    } else {
+        savitzky_golay(smooth, in, out, n);
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_SMOOTH_H__
+#define __ADC_SMOOTH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Smoothing of sample blocks.  Windows are centered and of odd length; at
+// the edges of a block, the first and last samples are repeated.
+//
+
+#define ADC_SMOOTH_MAX_WINDOW 65
+#define ADC_SMOOTH_MAX_ORDER 6
+// Savitzky-Golay coefficients are scaled so that they sum to 1 << ADC_SMOOTH_SHIFT
+#define ADC_SMOOTH_SHIFT 14
+
+typedef enum
+{
+    ADC_SMOOTH_MOVING_AVERAGE,
+    ADC_SMOOTH_SAVITZKY_GOLAY
+} adc_smooth_type_t;
+
+struct adc_smooth
+{
+    adc_smooth_type_t type;
+    uint16_t window;
+    // Savitzky-Golay only, from -window / 2 to window / 2
+    int16_t coeffs[ADC_SMOOTH_MAX_WINDOW];
+    // whether the coefficients are within the limits of adc_block_fir
+    bool fir;
+};
+
+bool adc_smooth_init_moving_average(struct adc_smooth *smooth, unsigned window);
+bool adc_smooth_init_savitzky_golay(struct adc_smooth *smooth, unsigned window, unsigned order);
+
+//
+// Smooth n samples from in to out, which must not overlap.
+//
+void adc_smooth_apply(const struct adc_smooth *smooth, const uint16_t *in, uint16_t *out, size_t n);
+
+#endif
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "adc_trace.h"
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string.h>
+
+#ifdef CONFIG_AVM_ADC_TRACE_ENABLE
+
+// records copied out per critical section while draining
+#define DRAIN_BATCH 64
+
+volatile bool adc_trace_enabled;
+
+static struct adc_trace_record ring[CONFIG_AVM_ADC_TRACE_RECORDS];
+static size_t head;
+static size_t count;
+static uint32_t dropped;
+// tasks that recorded events, numbered from 1 in the records
+static TaskHandle_t tasks[ADC_TRACE_MAX_TASKS];
+static size_t task_count;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Called with ring_lock held
+static uint8_t task_number(TaskHandle_t task)
+{
+    for (size_t i = 0; i < task_count; ++i) {
+        if (tasks[i] == task) {
+            return i + 1;
+        }
+    }
+    if (task_count == ADC_TRACE_MAX_TASKS) {
+        return 0;
+    }
+    tasks[task_count++] = task;
+    return task_count;
+}
+
+void adc_trace_record(adc_trace_event_t event, uint16_t arg0, uint32_t arg1)
+{
+    uint32_t timestamp_us = (uint32_t) esp_timer_get_time();
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&ring_lock);
+    size_t tail = head + count;
+    if (tail >= CONFIG_AVM_ADC_TRACE_RECORDS) {
+        tail -= CONFIG_AVM_ADC_TRACE_RECORDS;
+    }
+    struct adc_trace_record *record = &ring[tail];
+    record->timestamp_us = timestamp_us;
+    record->event = event;
+    record->task = task_number(task);
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    if (count < CONFIG_AVM_ADC_TRACE_RECORDS) {
+        count++;
+    } else {
+        // overwrote the oldest record
+        head = head + 1 == CONFIG_AVM_ADC_TRACE_RECORDS ? 0 : head + 1;
+        dropped++;
+    }
+    portEXIT_CRITICAL(&ring_lock);
+}
+
+void adc_trace_enable(bool enable)
+{
+    adc_trace_enabled = enable;
+}
+
+size_t adc_trace_count(void)
+{
+    portENTER_CRITICAL(&ring_lock);
+    size_t n = count;
+    portEXIT_CRITICAL(&ring_lock);
+    return n;
+}
+
+size_t adc_trace_drain(void *buf, size_t max_records)
+{
+    struct adc_trace_header *header = (struct adc_trace_header *) buf;
+    struct adc_trace_record *records = (struct adc_trace_record *) (header + 1);
+
+    // in batches, so that interrupts on this core are only held off for
+    // the copy of a few records, however large the ring
+    size_t n = 0;
+    uint32_t lost = 0;
+    while (n < max_records) {
+        portENTER_CRITICAL(&ring_lock);
+        size_t batch = max_records - n;
+        if (batch > DRAIN_BATCH) {
+            batch = DRAIN_BATCH;
+        }
+        if (batch > count) {
+            batch = count;
+        }
+        size_t first = batch;
+        if (head + first > CONFIG_AVM_ADC_TRACE_RECORDS) {
+            first = CONFIG_AVM_ADC_TRACE_RECORDS - head;
+        }
+        memcpy(records + n, &ring[head], first * sizeof(struct adc_trace_record));
+        memcpy(records + n + first, ring, (batch - first) * sizeof(struct adc_trace_record));
+        head = (head + batch) % CONFIG_AVM_ADC_TRACE_RECORDS;
+        count -= batch;
+        lost += dropped;
+        dropped = 0;
+        portEXIT_CRITICAL(&ring_lock);
+        if (batch == 0) {
+            break;
+        }
+        n += batch;
+    }
+    header->dropped = lost;
+
+    memcpy(header->magic, ADC_TRACE_MAGIC, sizeof(header->magic));
+    header->version = ADC_TRACE_VERSION;
+    header->record_size = sizeof(struct adc_trace_record);
+    header->records = n;
+    return sizeof(struct adc_trace_header) + n * sizeof(struct adc_trace_record);
+}
+
+#else
+
+void adc_trace_enable(bool enable)
+{
+    (void) enable;
+}
+
+size_t adc_trace_count(void)
+{
+    return 0;
+}
+
+size_t adc_trace_drain(void *buf, size_t max_records)
+{
+    (void) max_records;
+
+    struct adc_trace_header *header = (struct adc_trace_header *) buf;
+    memcpy(header->magic, ADC_TRACE_MAGIC, sizeof(header->magic));
+    header->version = ADC_TRACE_VERSION;
+    header->record_size = sizeof(struct adc_trace_record);
+    header->records = 0;
+    header->dropped = 0;
+    return sizeof(struct adc_trace_header);
+}
+
+#endif
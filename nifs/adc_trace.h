@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2020 dushin.net
+// All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __ADC_TRACE_H__
+#define __ADC_TRACE_H__
+
+#include <sdkconfig.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// Binary trace ring.  Recording an event costs a timestamp and a few stores
+// under a spinlock, so tracing can stay enabled in production; when the
+// ring is full, the oldest records are overwritten.  The ring is drained as
+// a binary with adc:trace_dump/0, and decoded on the host with
+// tools/adc_trace_decode.py, which must be kept in sync with the events
+// below.
+//
+// Dump format, little endian:
+//   header: "ADCT", version:16, record size:16, records:32, dropped:32
+//   records, oldest first: timestamp (us, low 32 bits):32, event:8, task:8,
+//     arg0:16, arg1:32
+//
+// The task is a small number identifying the FreeRTOS task that recorded
+// the event, e.g. one of several VM schedulers, numbered from 1 in the
+// order the tasks first recorded an event since boot; 0 if there are more
+// than ADC_TRACE_MAX_TASKS tasks.
+//
+
+#define ADC_TRACE_MAGIC "ADCT"
+#define ADC_TRACE_VERSION 2
+#define ADC_TRACE_MAX_TASKS 15
+
+typedef enum
+{
+    // synchronous readings and scans, in the calling Erlang process
+    ADC_TRACE_READ_SLICE_BEGIN = 0, // channel, samples taken
+    ADC_TRACE_READ_SLICE_END = 1, // esp_err_t, samples taken
+    ADC_TRACE_READ_DONE = 2, // samples, raw reading
+    ADC_TRACE_SCAN_BEGIN = 3, // channels, samples per channel
+    ADC_TRACE_SCAN_END = 4, // esp_err_t, conversions
+    ADC_TRACE_SUBMIT = 5, // priority, samples
+    // acquisition task
+    ADC_TRACE_CHUNK_BEGIN = 6, // priority, chunk samples
+    ADC_TRACE_CHUNK_END = 7, // esp_err_t, samples taken
+    ADC_TRACE_COMPLETE = 8, // priority, deadline missed
+    ADC_TRACE_PREEMPT = 9, // priority of the preempting read
+    ADC_TRACE_SAMPLERS_BEGIN = 10, // -, -
+    ADC_TRACE_SAMPLERS_END = 11, // -, samples taken
+    ADC_TRACE_SAMPLER_OVERRUN = 12 // -, time past the skipped samples in us
+} adc_trace_event_t;
+
+struct adc_trace_record
+{
+    uint32_t timestamp_us;
+    uint8_t event;
+    uint8_t task;
+    uint16_t arg0;
+    uint32_t arg1;
+};
+
+struct adc_trace_header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t records;
+    uint32_t dropped;
+};
+
+#ifdef CONFIG_AVM_ADC_TRACE_ENABLE
+
+extern volatile bool adc_trace_enabled;
+
+void adc_trace_record(adc_trace_event_t event, uint16_t arg0, uint32_t arg1);
+
+#define ADC_TRACE(event, arg0, arg1)                                        \
+    do {                                                                    \
+        if (__builtin_expect(adc_trace_enabled, 0)) {                       \
+            adc_trace_record((event), (uint16_t) (arg0), (uint32_t) (arg1)); \
+        }                                                                   \
+    } while (0)
+
+#else
+
+#define ADC_TRACE(event, arg0, arg1) \
+    do {                             \
+    } while (0)
+
+#endif
+
+void adc_trace_enable(bool enable);
+
+//
+// The number of records currently in the ring.
+//
+size_t adc_trace_count(void);
+
+//
+// Write a dump of at most max_records records to buf, which must hold
+// sizeof(struct adc_trace_header) + max_records records, and remove them
+// from the ring.  The ring is only locked for a batch of records at a time,
+// so records may be overwritten, and counted as dropped, while draining.
+// Returns the number of bytes written.
+//
+size_t adc_trace_drain(void *buf, size_t max_records);
+
+#endif
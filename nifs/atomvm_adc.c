@@ -20,9 +20,18 @@
 //
 
 #include "atomvm_adc.h"
+#include "adc_acq.h"
+#include "adc_cal.h"
+#include "adc_profile.h"
+#include "adc_sampler.h"
+#include "adc_sink.h"
+#include "adc_smooth.h"
+#include "adc_trace.h"
 
 #include <context.h>
 #include <defaultatoms.h>
+#include <erl_nif.h>
+#include <erl_nif_priv.h>
 #include <interop.h>
 #include <nifs.h>
 #include <term.h>
@@ -34,13 +43,38 @@
 #include <esp32_sys.h>
 #include <esp_adc_cal.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <sdkconfig.h>
+#include <soc/soc_caps.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #define TAG "atomvm_adc"
 #define DEFAULT_SAMPLES 64
-#define DEFAULT_VREF 1100
+#define MAX_SCAN_CHANNELS 20
+// a scan is taken in a single NIF call, so it must stay short
+#define MAX_SCAN_SAMPLES 64
+#define MAX_CONFIGURE_PINS 20
+#define DEFAULT_SAMPLER_RATE 100
+#define DEFAULT_ENVELOPE_ATTACK 5
+#define DEFAULT_ENVELOPE_DECAY 100
+#define DEFAULT_ENVELOPE_SEPARATION 100
+#define DEFAULT_POWER_FREQUENCY 50
+#define DEFAULT_POWER_CYCLES 10
+#define DEFAULT_POWER_HARMONICS 7
+#define DEFAULT_PULSE_WINDOW 1000
+#define DEFAULT_HEALTH_WINDOW 100
+#define MAX_HEALTH_WINDOW 10000
+#define DEFAULT_HEALTH_NOISE 50
+#define DEFAULT_SINK_BAUD_RATE 921600
+#define DEFAULT_SINK_BUFFER 16384
+#define MIN_SINK_BUFFER 1024
+#define DEFAULT_SINK_MTU 1500
+// IPv4 and UDP headers
+#define SINK_UDP_OVERHEAD 28
 
 
 static const AtomStringIntPair bit_width_table[] = {
@@ -65,6 +99,13 @@ static const AtomStringIntPair attenuation_table[] = {
     SELECT_INT_DEFAULT(ADC_ATTEN_MAX)
 };
 
+static const AtomStringIntPair priority_table[] = {
+    { ATOM_STR("\x4", "high"), ADC_ACQ_PRIORITY_HIGH },
+    { ATOM_STR("\x6", "normal"), ADC_ACQ_PRIORITY_NORMAL },
+    { ATOM_STR("\x3", "low"), ADC_ACQ_PRIORITY_LOW },
+    SELECT_INT_DEFAULT(ADC_ACQ_PRIORITY_MAX)
+};
+
 static const char *const invalid_pin_atom   = ATOM_STR("\xb", "invalid_pin");
 static const char *const invalid_width_atom = ATOM_STR("\xd", "invalid_width");
 static const char *const invalid_db_atom    = ATOM_STR("\xa", "invalid_db");
@@ -72,174 +113,164 @@ static const char *const invalid_db_atom    = ATOM_STR("\xa", "invalid_db");
 static const char *const timeout_atom = ATOM_STR("\x7", "timeout");
 #endif
 
-static adc_unit_t adc_unit_from_pin(int pin_val)
+static const char *const continue_atom = ATOM_STR("\x8", "continue");
+
+struct read_options
 {
-    switch (pin_val) {
-#if CONFIG_IDF_TARGET_ESP32
-        case 32:
-        case 33:
-        case 34:
-        case 35:
-        case 36:
-        case 37:
-        case 38:
-        case 39:
-#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 1:
-        case 2:
-        case 3:
-        case 4:
-        case 5:
-        case 6:
-        case 7:
-        case 8:
-        case 9:
-        case 10:
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 0:
-        case 1:
-        case 2:
-        case 3:
-        case 4:
+    avm_int_t samples;
+    avm_int_t discard;
+    bool raw;
+    bool voltage;
+    bool value;
+    // profile lookup table (a resource object), or NULL
+    struct adc_lut *lut;
+};
+
+struct reading_state
+{
+    struct adc_acq_channel ch;
+    adc_atten_t atten;
+    struct read_options opts;
+    avm_int_t taken;
+    uint64_t sum;
+};
+
+static void reading_resource_dtor(ErlNifEnv *caller_env, void *obj);
+
+static ErlNifResourceType *reading_resource_type;
+static const ErlNifResourceTypeInit reading_resource_type_init = {
+    .members = 1,
+    .dtor = reading_resource_dtor
+};
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+static void sampler_resource_dtor(ErlNifEnv *caller_env, void *obj);
+static void sampler_resource_down(ErlNifEnv *caller_env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon);
+
+struct sampler_resource
+{
+    struct adc_sampler *sampler;
+    // of the owner, which is sent the sampler's messages
+    ErlNifMonitor monitor;
+};
+
+// protects sampler_resource.sampler and sink_resource.sink
+static SemaphoreHandle_t sampler_resource_lock;
+
+static ErlNifResourceType *sampler_resource_type;
+static const ErlNifResourceTypeInit sampler_resource_type_init = {
+    .members = 3,
+    .dtor = sampler_resource_dtor,
+    .down = sampler_resource_down
+};
 #endif
-            return ADC_UNIT_1;
-#ifdef CONFIG_AVM_ADC2_ENABLE
-#if CONFIG_IDF_TARGET_ESP32
-        case 0:
-        case 2:
-        case 4:
-        case 12:
-        case 13:
-        case 14:
-        case 15:
-        case 25:
-        case 26:
-        case 27:
-#elif CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32S2
-        case 11:
-        case 12:
-        case 13:
-        case 14:
-        case 15:
-        case 16:
-        case 17:
-        case 18:
-        case 19:
-        case 20:
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 5:
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+static void sink_resource_dtor(ErlNifEnv *caller_env, void *obj);
+
+struct sink_resource
+{
+    struct adc_sink *sink;
+};
+
+static ErlNifResourceType *sink_resource_type;
+static const ErlNifResourceTypeInit sink_resource_type_init = {
+    .members = 1,
+    .dtor = sink_resource_dtor
+};
 #endif
-            return ADC_UNIT_2;
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+static ErlNifResourceType *profile_resource_type;
+static const ErlNifResourceTypeInit profile_resource_type_init = {
+    .members = 0
+};
 #endif
-        default:
-            return ADC_UNIT_MAX;
-    }
-}
 
-static adc_channel_t get_channel(avm_int_t pin_val)
+struct adc_pin
 {
-    switch (pin_val) {
+    uint8_t pin;
+    uint8_t adc_unit;
+    uint8_t channel;
+};
+
+//
+// GPIO to ADC channel map of the target, limited to the enabled units
+//
+static const struct adc_pin pin_table[] = {
 #if CONFIG_IDF_TARGET_ESP32
-        case 32:
-            return ADC1_CHANNEL_4;
-        case 33:
-            return ADC1_CHANNEL_5;
-        case 34:
-            return ADC1_CHANNEL_6;
-        case 35:
-            return ADC1_CHANNEL_7;
-        case 36:
-            return ADC1_CHANNEL_0;
-        case 37:
-            return ADC1_CHANNEL_1;
-        case 38:
-            return ADC1_CHANNEL_2;
-        case 39:
-            return ADC1_CHANNEL_3;
-#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 1:
-            return ADC1_CHANNEL_0;
-        case 2:
-            return ADC1_CHANNEL_1;
-        case 3:
-            return ADC1_CHANNEL_2;
-        case 4:
-            return ADC1_CHANNEL_3;
-        case 5:
-            return ADC1_CHANNEL_4;
-        case 6:
-            return ADC1_CHANNEL_5;
-        case 7:
-            return ADC1_CHANNEL_6;
-        case 8:
-            return ADC1_CHANNEL_7;
-        case 9:
-            return ADC1_CHANNEL_8;
-        case 10:
-            return ADC1_CHANNEL_9;
-#elif CONFIG_IDF_TARGET_ESP32C3
-        case 0:
-            return ADC1_CHANNEL_0;
-        case 1:
-            return ADC1_CHANNEL_1;
-        case 2:
-            return ADC1_CHANNEL_2;
-        case 3:
-            return ADC1_CHANNEL_3;
-        case 4:
-            return ADC1_CHANNEL_4;
-#endif
+    { 32, ADC_UNIT_1, ADC1_CHANNEL_4 },
+    { 33, ADC_UNIT_1, ADC1_CHANNEL_5 },
+    { 34, ADC_UNIT_1, ADC1_CHANNEL_6 },
+    { 35, ADC_UNIT_1, ADC1_CHANNEL_7 },
+    { 36, ADC_UNIT_1, ADC1_CHANNEL_0 },
+    { 37, ADC_UNIT_1, ADC1_CHANNEL_1 },
+    { 38, ADC_UNIT_1, ADC1_CHANNEL_2 },
+    { 39, ADC_UNIT_1, ADC1_CHANNEL_3 },
 #ifdef CONFIG_AVM_ADC2_ENABLE
-#if CONFIG_IDF_TARGET_ESP32
-        case 0:
-            return ADC2_CHANNEL_1;
-        case 2:
-            return ADC2_CHANNEL_2;
-        case 4:
-            return ADC2_CHANNEL_0;
-        case 12:
-            return ADC2_CHANNEL_5;
-        case 13:
-            return ADC2_CHANNEL_4;
-        case 14:
-            return ADC2_CHANNEL_6;
-        case 15:
-            return ADC2_CHANNEL_3;
-        case 25:
-            return ADC2_CHANNEL_8;
-        case 26:
-            return ADC2_CHANNEL_9;
-        case 27:
-            return ADC2_CHANNEL_7;
+    { 0, ADC_UNIT_2, ADC2_CHANNEL_1 },
+    { 2, ADC_UNIT_2, ADC2_CHANNEL_2 },
+    { 4, ADC_UNIT_2, ADC2_CHANNEL_0 },
+    { 12, ADC_UNIT_2, ADC2_CHANNEL_5 },
+    { 13, ADC_UNIT_2, ADC2_CHANNEL_4 },
+    { 14, ADC_UNIT_2, ADC2_CHANNEL_6 },
+    { 15, ADC_UNIT_2, ADC2_CHANNEL_3 },
+    { 25, ADC_UNIT_2, ADC2_CHANNEL_8 },
+    { 26, ADC_UNIT_2, ADC2_CHANNEL_9 },
+    { 27, ADC_UNIT_2, ADC2_CHANNEL_7 },
+#endif
 #elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3
-        case 11:
-            return ADC2_CHANNEL_0;
-        case 12:
-            return ADC2_CHANNEL_1;
-        case 13:
-            return ADC2_CHANNEL_2;
-        case 14:
-            return ADC2_CHANNEL_3;
-        case 15:
-            return ADC2_CHANNEL_4;
-        case 16:
-            return ADC2_CHANNEL_5;
-        case 17:
-            return ADC2_CHANNEL_6;
-        case 18:
-            return ADC2_CHANNEL_7;
-        case 19:
-            return ADC2_CHANNEL_8;
-        case 20:
-            return ADC2_CHANNEL_9;
+    { 1, ADC_UNIT_1, ADC1_CHANNEL_0 },
+    { 2, ADC_UNIT_1, ADC1_CHANNEL_1 },
+    { 3, ADC_UNIT_1, ADC1_CHANNEL_2 },
+    { 4, ADC_UNIT_1, ADC1_CHANNEL_3 },
+    { 5, ADC_UNIT_1, ADC1_CHANNEL_4 },
+    { 6, ADC_UNIT_1, ADC1_CHANNEL_5 },
+    { 7, ADC_UNIT_1, ADC1_CHANNEL_6 },
+    { 8, ADC_UNIT_1, ADC1_CHANNEL_7 },
+    { 9, ADC_UNIT_1, ADC1_CHANNEL_8 },
+    { 10, ADC_UNIT_1, ADC1_CHANNEL_9 },
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    { 11, ADC_UNIT_2, ADC2_CHANNEL_0 },
+    { 12, ADC_UNIT_2, ADC2_CHANNEL_1 },
+    { 13, ADC_UNIT_2, ADC2_CHANNEL_2 },
+    { 14, ADC_UNIT_2, ADC2_CHANNEL_3 },
+    { 15, ADC_UNIT_2, ADC2_CHANNEL_4 },
+    { 16, ADC_UNIT_2, ADC2_CHANNEL_5 },
+    { 17, ADC_UNIT_2, ADC2_CHANNEL_6 },
+    { 18, ADC_UNIT_2, ADC2_CHANNEL_7 },
+    { 19, ADC_UNIT_2, ADC2_CHANNEL_8 },
+    { 20, ADC_UNIT_2, ADC2_CHANNEL_9 },
+#endif
 #elif CONFIG_IDF_TARGET_ESP32C3
-        case 5:
-            return ADC2_CHANNEL_0;
+    { 0, ADC_UNIT_1, ADC1_CHANNEL_0 },
+    { 1, ADC_UNIT_1, ADC1_CHANNEL_1 },
+    { 2, ADC_UNIT_1, ADC1_CHANNEL_2 },
+    { 3, ADC_UNIT_1, ADC1_CHANNEL_3 },
+    { 4, ADC_UNIT_1, ADC1_CHANNEL_4 },
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    { 5, ADC_UNIT_2, ADC2_CHANNEL_0 },
 #endif
 #endif
-        default:
-            return ADC_CHANNEL_MAX;
+};
+
+static const struct adc_pin *find_pin(avm_int_t pin_val)
+{
+    for (size_t i = 0; i < sizeof(pin_table) / sizeof(pin_table[0]); ++i) {
+        if (pin_table[i].pin == pin_val) {
+            return &pin_table[i];
+        }
     }
+    return NULL;
+}
+
+static adc_unit_t adc_unit_from_pin(int pin_val)
+{
+    const struct adc_pin *pin = find_pin(pin_val);
+    return pin != NULL ? (adc_unit_t) pin->adc_unit : ADC_UNIT_MAX;
+}
+
+static adc_channel_t get_channel(avm_int_t pin_val)
+{
+    const struct adc_pin *pin = find_pin(pin_val);
+    return pin != NULL ? (adc_channel_t) pin->channel : ADC_CHANNEL_MAX;
 }
 
 static term create_pair(Context *ctx, term term1, term term2)
@@ -251,6 +282,46 @@ static term create_pair(Context *ctx, term term1, term term2)
     return ret;
 }
 
+static term make_error(Context *ctx, term reason)
+{
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    return create_pair(ctx, ERROR_ATOM, reason);
+}
+
+static bool parse_read_options(Context *ctx, term read_options, struct read_options *opts)
+{
+    GlobalContext *global = ctx->global;
+    term samples = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "samples"), term_from_int(DEFAULT_SAMPLES), global);
+    if (UNLIKELY(!term_is_integer(samples) || term_to_int(samples) < 1)) {
+        return false;
+    }
+    opts->samples = term_to_int(samples);
+    term discard = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "discard"), term_from_int(0), global);
+    if (UNLIKELY(!term_is_integer(discard) || term_to_int(discard) < 0)) {
+        return false;
+    }
+    opts->discard = term_to_int(discard);
+    opts->raw = interop_kv_get_value_default(read_options, ATOM_STR("\x3", "raw"), FALSE_ATOM, global) == TRUE_ATOM;
+    opts->voltage = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "voltage"), FALSE_ATOM, global) == TRUE_ATOM;
+    opts->value = interop_kv_get_value_default(read_options, ATOM_STR("\x5", "value"), FALSE_ATOM, global) == TRUE_ATOM;
+    opts->lut = NULL;
+    term profile = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "profile"), UNDEFINED_ATOM, global);
+    if (profile != UNDEFINED_ATOM) {
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+        void *lut;
+        if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), profile, profile_resource_type, &lut))) {
+            return false;
+        }
+        opts->lut = (struct adc_lut *) lut;
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
 static void log_char_val_type(esp_adc_cal_value_t val_type)
 {
     if (val_type == ESP_ADC_CAL_VAL_EFUSE_TP) {
@@ -293,7 +364,7 @@ static term nif_adc_config_width(Context *ctx, int argc, term argv[])
     }
 
     if (adc_unit == ADC_UNIT_1) {
-        esp_err_t err = adc1_config_width(bit_width);
+        esp_err_t err = adc_acq_config_width(bit_width);
         if (err != ESP_OK) {
             if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
                 RAISE_ERROR(OUT_OF_MEMORY_ATOM);
@@ -312,6 +383,19 @@ static term nif_adc_config_width(Context *ctx, int argc, term argv[])
     return OK_ATOM;
 }
 
+static esp_err_t config_channel_atten(adc_unit_t adc_unit, adc_channel_t channel, adc_atten_t atten)
+{
+    if (adc_unit == ADC_UNIT_1) {
+        return adc1_config_channel_atten((adc1_channel_t) channel, atten);
+    }
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (adc_unit == ADC_UNIT_2) {
+        return adc2_config_channel_atten((adc2_channel_t) channel, atten);
+    }
+#endif
+    return ESP_OK;
+}
+
 static term nif_adc_config_channel_attenuation(Context *ctx, int argc, term argv[])
 {
     UNUSED(argc);
@@ -340,31 +424,180 @@ static term nif_adc_config_channel_attenuation(Context *ctx, int argc, term argv
 
     adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
 
-    if (adc_unit == ADC_UNIT_1) {
-        esp_err_t err = adc1_config_channel_atten((adc1_channel_t) channel, atten);
+    esp_err_t err = config_channel_atten(adc_unit, channel, atten);
+    if (UNLIKELY(err != ESP_OK)) {
+        if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        } else {
+            return create_pair(ctx, ERROR_ATOM, term_from_int(err));
+        }
+    }
+
+    TRACE("Attenuation on channel %u set to %u\n", channel, atten);
+    return OK_ATOM;
+}
+
+static term configure_error(Context *ctx, term pin, term reason)
+{
+    // {error, {Pin, Reason}}
+    if (UNLIKELY(memory_ensure_free(ctx, 2 * TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    return create_pair(ctx, ERROR_ATOM, create_pair(ctx, pin, reason));
+}
+
+//
+// Configure a batch of pins, given as [{Pin, BitWidth, Attenuation}], and
+// start computing their calibration characteristics in the background.
+//
+static term nif_adc_configure(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    term pins = argv[0];
+    VALIDATE_VALUE(pins, term_is_list);
+    struct adc_cal_key keys[MAX_CONFIGURE_PINS];
+    size_t n = 0;
+    while (term_is_nonempty_list(pins)) {
+        term spec = term_get_list_head(pins);
+        if (UNLIKELY(!term_is_tuple(spec) || term_get_tuple_arity(spec) != 3 || n == MAX_CONFIGURE_PINS)) {
+            RAISE_ERROR(BADARG_ATOM);
+        }
+        term pin = term_get_tuple_element(spec, 0);
+        term width = term_get_tuple_element(spec, 1);
+        term attenuation = term_get_tuple_element(spec, 2);
+        if (UNLIKELY(!term_is_integer(pin) || !term_is_atom(width) || !term_is_atom(attenuation))) {
+            RAISE_ERROR(BADARG_ATOM);
+        }
+        adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
+        adc_channel_t channel = get_channel(term_to_int(pin));
+        if (UNLIKELY(adc_unit == ADC_UNIT_MAX || channel == ADC_CHANNEL_MAX)) {
+            return configure_error(ctx, pin, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+        }
+        adc_bits_width_t bit_width = interop_atom_term_select_int(bit_width_table, width, ctx->global);
+        if (UNLIKELY(bit_width == ADC_WIDTH_MAX)) {
+            return configure_error(ctx, pin, globalcontext_make_atom(ctx->global, invalid_width_atom));
+        }
+        adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+        if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
+            return configure_error(ctx, pin, globalcontext_make_atom(ctx->global, invalid_db_atom));
+        }
+        esp_err_t err = adc_unit == ADC_UNIT_1 ? adc_acq_config_width(bit_width) : ESP_OK;
+        if (LIKELY(err == ESP_OK)) {
+            err = config_channel_atten(adc_unit, channel, atten);
+        }
         if (UNLIKELY(err != ESP_OK)) {
-            if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
-                RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-            } else {
-                return create_pair(ctx, ERROR_ATOM, term_from_int(err));
-            }
+            return configure_error(ctx, pin, term_from_int(err));
+        }
+
+        bool seen = false;
+        for (size_t i = 0; i < n && !seen; ++i) {
+            seen = keys[i].adc_unit == adc_unit && keys[i].atten == atten && keys[i].bit_width == bit_width;
+        }
+        if (!seen) {
+            keys[n].adc_unit = adc_unit;
+            keys[n].atten = atten;
+            keys[n].bit_width = bit_width;
+            ++n;
         }
+        pins = term_get_list_tail(pins);
     }
-#ifdef CONFIG_AVM_ADC2_ENABLE
-    else if (adc_unit == ADC_UNIT_2) {
-        esp_err_t err = adc2_config_channel_atten((adc2_channel_t) channel, atten);
+
+    // readings taken before the characteristics are ready compute them
+    // themselves, so a failure to prepare them is not an error
+    adc_cal_prepare(keys, n);
+    return OK_ATOM;
+}
+
+//
+// Take samples for a reading until either all samples have been taken or
+// the time slice is used up.  Samples are taken in chunks, so the ADC
+// hardware lock is never held for more than one chunk at a time.
+//
+static esp_err_t reading_run_slice(struct reading_state *state)
+{
+    ADC_TRACE(ADC_TRACE_READ_SLICE_BEGIN, state->ch.channel, state->taken);
+    int64_t start = esp_timer_get_time();
+    while (state->taken < state->opts.samples) {
+        avm_int_t chunk = state->opts.samples - state->taken;
+        if (chunk > CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES) {
+            chunk = CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES;
+        }
+        esp_err_t err = adc_acq_sample(&state->ch, chunk, &state->sum, NULL);
         if (UNLIKELY(err != ESP_OK)) {
-            if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
-                RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-            } else {
-                return create_pair(ctx, ERROR_ATOM, term_from_int(err));
-            }
+            ADC_TRACE(ADC_TRACE_READ_SLICE_END, err, state->taken);
+            return err;
         }
+        state->taken += chunk;
+        if (esp_timer_get_time() - start >= CONFIG_AVM_ADC_READ_TIME_SLICE_US) {
+            break;
+        }
+    }
+    ADC_TRACE(ADC_TRACE_READ_SLICE_END, ESP_OK, state->taken);
+    return ESP_OK;
+}
+
+// As the acquisition task reports errors of asynchronous readings
+static term sample_error(Context *ctx, esp_err_t err)
+{
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    if (err == ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "ADC2 in use by Wi-Fi! Use adc:wifi_release/0 to stop wifi and free adc2 for reading.\n");
+        return make_error(ctx, globalcontext_make_atom(ctx->global, timeout_atom));
     }
 #endif
+    return make_error(ctx, term_from_int(err));
+}
 
-    TRACE("Attenuation on channel %u set to %u\n", channel, atten);
-    return OK_ATOM;
+static term make_reading(Context *ctx, struct reading_state *state)
+{
+    uint32_t adc_reading = (uint32_t) (state->sum / state->opts.samples);
+    ADC_TRACE(ADC_TRACE_READ_DONE, state->opts.samples, adc_reading);
+
+    term raw = state->opts.raw ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
+    term voltage = UNDEFINED_ATOM;
+    term value = UNDEFINED_ATOM;
+    bool need_voltage = state->opts.voltage || (state->opts.value && state->opts.lut != NULL);
+    if (need_voltage) {
+        esp_adc_cal_characteristics_t adc_chars;
+        esp_adc_cal_value_t val_type;
+        adc_cal_get(state->ch.adc_unit, state->atten, state->ch.bit_width, &adc_chars, &val_type);
+        log_char_val_type(val_type);
+        uint32_t mv = esp_adc_cal_raw_to_voltage(adc_reading, &adc_chars);
+        if (state->opts.voltage) {
+            voltage = term_from_int32(mv);
+        }
+        if (state->opts.value && state->opts.lut != NULL) {
+            value = term_from_int32(adc_lut_lookup(state->opts.lut, mv));
+        }
+    }
+
+    if (state->opts.value) {
+        if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(3)) != MEMORY_GC_OK)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        term ret = term_alloc_tuple(3, &ctx->heap);
+        term_put_tuple_element(ret, 0, raw);
+        term_put_tuple_element(ret, 1, voltage);
+        term_put_tuple_element(ret, 2, value);
+        return ret;
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    } else {
+        return create_pair(ctx, raw, voltage);
+    }
+}
+
+static void reading_resource_dtor(ErlNifEnv *caller_env, void *obj)
+{
+    UNUSED(caller_env);
+
+    struct reading_state *state = (struct reading_state *) obj;
+    if (state->opts.lut != NULL) {
+        enif_release_resource(state->opts.lut);
+    }
 }
 
 static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
@@ -374,7 +607,6 @@ static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
     term pin = argv[0];
     VALIDATE_VALUE(pin, term_is_integer);
     adc_channel_t channel = get_channel(term_to_int(pin));
-    TRACE("take_reading channel: %u\n", channel);
     if (UNLIKELY(channel == ADC_CHANNEL_MAX)) {
         if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
@@ -385,16 +617,14 @@ static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
 
     term read_options = argv[1];
     VALIDATE_VALUE(read_options, term_is_list);
-    term samples = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "samples"), DEFAULT_SAMPLES, ctx->global);
-    avm_int_t samples_val = term_to_int(samples);
-    TRACE("take_reading samples: %i\n", samples_val);
-    term raw = interop_kv_get_value_default(read_options, ATOM_STR("\x3", "raw"), FALSE_ATOM, ctx->global);
-    term voltage = interop_kv_get_value_default(read_options, ATOM_STR("\x7", "voltage"), FALSE_ATOM, ctx->global);
+    struct read_options opts;
+    if (UNLIKELY(!parse_read_options(ctx, read_options, &opts))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
 
     term width = argv[2];
     VALIDATE_VALUE(width, term_is_atom);
     adc_bits_width_t bit_width = interop_atom_term_select_int(bit_width_table, width, ctx->global);
-    TRACE("take_reading bit width: %i\n", bit_width);
     if (UNLIKELY(bit_width == ADC_WIDTH_MAX)) {
         if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
@@ -406,7 +636,6 @@ static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
     term attenuation = argv[3];
     VALIDATE_VALUE(attenuation, term_is_atom);
     adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
-    TRACE("take_reading attenuation: %i\n", atten);
     if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
         if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
             RAISE_ERROR(OUT_OF_MEMORY_ATOM);
@@ -415,141 +644,1936 @@ static term nif_adc_take_reading(Context *ctx, int argc, term argv[])
         }
     }
 
-    adc_unit_t adc_unit = adc_unit_from_pin(term_to_int(pin));
+    struct reading_state state = {
+        .ch = {
+            .adc_unit = adc_unit_from_pin(term_to_int(pin)),
+            .channel = channel,
+            .bit_width = bit_width,
+            .discard = opts.discard },
+        .atten = atten,
+        .opts = opts
+    };
+    esp_err_t err = reading_run_slice(&state);
+    if (UNLIKELY(err != ESP_OK)) {
+        return sample_error(ctx, err);
+    }
+    if (state.taken == state.opts.samples) {
+        return make_reading(ctx, &state);
+    }
 
-    esp_adc_cal_characteristics_t *adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
-    if (UNLIKELY(IS_NULL_PTR(adc_chars))) {
+    // out of time; park the partial sum in a resource and let the caller
+    // resume the reading with adc:resume_reading/1
+    struct reading_state *rsrc_state = enif_alloc_resource(reading_resource_type, sizeof(struct reading_state));
+    if (UNLIKELY(IS_NULL_PTR(rsrc_state))) {
         RAISE_ERROR(OUT_OF_MEMORY_ATOM);
     }
+    *rsrc_state = state;
+    if (state.opts.lut != NULL) {
+        // the profile must outlive the suspended reading
+        enif_keep_resource(state.opts.lut);
+    }
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
+        enif_release_resource(rsrc_state);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term obj = enif_make_resource(erl_nif_env_from_context(ctx), rsrc_state);
+    enif_release_resource(rsrc_state);
+    return create_pair(ctx, globalcontext_make_atom(ctx->global, continue_atom), obj);
+}
 
-    esp_adc_cal_value_t val_type = esp_adc_cal_characterize(adc_unit, atten, bit_width, DEFAULT_VREF, adc_chars);
-    TRACE("take_reading calibration type: %i\n", val_type);
-    log_char_val_type(val_type);
+static term nif_adc_resume_reading(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
 
-    uint32_t adc_reading = 0;
-    if (adc_unit == ADC_UNIT_1) {
-        // adc1_config_width() is used here in case the last adc1 pin to be configured was of a different width.
-        // this will ensure the calibration characteristics and reading match the desired bit width for the channel.
-        esp_err_t err = adc1_config_width(bit_width);
-        if (UNLIKELY(err != ESP_OK)) {
-            if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
-                RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-            } else {
-                return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, invalid_width_atom));
-            }
-        }
-        for (avm_int_t i = 0; i < samples_val; ++i) {
-            adc_reading += adc1_get_raw((adc1_channel_t) channel);
-        }
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], reading_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
     }
-#ifdef CONFIG_AVM_ADC2_ENABLE
-    else if (adc_unit == ADC_UNIT_2) {
-        int read_raw;
-        for (avm_int_t i = 0; i < samples_val; ++i) {
-            esp_err_t r = adc2_get_raw((adc2_channel_t) channel, bit_width, &read_raw);
-            if (UNLIKELY(r == ESP_ERR_TIMEOUT)) {
-                ESP_LOGW(TAG, "ADC2 in use by Wi-Fi! Use adc:wifi_release/0 to stop wifi and free adc2 for reading.\n");
-                if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
-                    RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-                } else {
-                    return create_pair(ctx, ERROR_ATOM, globalcontext_make_atom(ctx->global, timeout_atom));
-                }
-            }
-            adc_reading += read_raw;
-        }
+    struct reading_state *state = (struct reading_state *) rsrc_obj_ptr;
+    if (UNLIKELY(state->taken == state->opts.samples)) {
+        RAISE_ERROR(BADARG_ATOM);
     }
-#endif
-    adc_reading /= samples_val;
-    TRACE("take_reading adc_reading: %i\n", adc_reading);
-
-    raw = raw == TRUE_ATOM ? term_from_int32(adc_reading) : UNDEFINED_ATOM;
-    if (voltage == TRUE_ATOM) {
-        voltage = term_from_int32(esp_adc_cal_raw_to_voltage(adc_reading, adc_chars));
-    } else {
-        voltage = UNDEFINED_ATOM;
-    };
 
-    free(adc_chars);
+    esp_err_t err = reading_run_slice(state);
+    if (UNLIKELY(err != ESP_OK)) {
+        // make sure the resource cannot be resumed after an error
+        state->taken = state->opts.samples;
+        return sample_error(ctx, err);
+    }
+    if (state->taken == state->opts.samples) {
+        return make_reading(ctx, state);
+    }
 
-    if (UNLIKELY(memory_ensure_free(ctx, 3) != MEMORY_GC_OK)) {
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
         RAISE_ERROR(OUT_OF_MEMORY_ATOM);
-    } else {
-        return create_pair(ctx, raw, voltage);
     }
+    return create_pair(ctx, globalcontext_make_atom(ctx->global, continue_atom), argv[0]);
 }
 
-static term nif_adc_pin_is_adc2(Context *ctx, int argc, term argv[])
+static inline bool term_to_float_value(term t, float *out)
 {
-    UNUSED(argc);
-#ifdef CONFIG_AVM_ADC2_ENABLE
-    term pin = argv[0];
-    VALIDATE_VALUE(pin, term_is_integer);
-    adc_unit_t Adc_Unit = adc_unit_from_pin(term_to_int(pin));
-    switch (Adc_Unit) {
-        case ADC_UNIT_2:
-            return TRUE_ATOM;
-        default:
-            return FALSE_ATOM;
+    if (term_is_integer(t)) {
+        *out = (float) term_to_int(t);
+        return true;
     }
-#else
-    UNUSED(argv);
-    return FALSE_ATOM;
-#endif
+    if (term_is_float(t)) {
+        *out = (float) term_to_float(t);
+        return true;
+    }
+    return false;
 }
 
-static const struct Nif adc_config_width_nif = {
-    .base.type = NIFFunctionType,
-    .nif_ptr = nif_adc_config_width
-};
-static const struct Nif adc_config_channel_attenuation_nif = {
-    .base.type = NIFFunctionType,
-    .nif_ptr = nif_adc_config_channel_attenuation
-};
-static const struct Nif adc_take_reading_nif = {
-    .base.type = NIFFunctionType,
-    .nif_ptr = nif_adc_take_reading
-};
-static const struct Nif adc_pin_is_adc2_nif = {
-    .base.type = NIFFunctionType,
-    .nif_ptr = nif_adc_pin_is_adc2
-};
-
-//
-// Component Nif Entrypoints
-//
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+// upper bound of the input range for each attenuation, in mV
+static const uint16_t attenuation_max_mv[] = { 1100, 1500, 2200, 3900 };
 
-void atomvm_adc_init(GlobalContext *global)
+static bool kv_get_float(term kv, AtomString key, float default_value, GlobalContext *global, float *out)
 {
-    // Check TP is burned into eFuse
-    if (esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_TP) == ESP_OK) {
-        ESP_LOGI(TAG, "eFuse Two Point: Supported");
-    } else {
-        ESP_LOGI(TAG, "eFuse Two Point: NOT supported");
+    term t = interop_kv_get_value(kv, key, global);
+    if (term_is_invalid_term(t)) {
+        *out = default_value;
+        return true;
     }
+    return term_to_float_value(t, out) && *out >= 0.0f;
+}
 
-    // Check Vref is burned into eFuse
-    if (esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_VREF) == ESP_OK) {
-        ESP_LOGI(TAG, "eFuse Vref: Supported");
-    } else {
-        ESP_LOGI(TAG, "eFuse Vref: NOT supported");
+static bool kv_get_divider(term kv, GlobalContext *global, uint32_t *r_top, uint32_t *r_bottom)
+{
+    term divider = interop_kv_get_value_default(kv, ATOM_STR("\x7", "divider"), UNDEFINED_ATOM, global);
+    if (divider == UNDEFINED_ATOM) {
+        *r_top = 0;
+        *r_bottom = 1;
+        return true;
+    }
+    if (!term_is_tuple(divider) || term_get_tuple_arity(divider) != 2
+        || !term_is_integer(term_get_tuple_element(divider, 0)) || !term_is_integer(term_get_tuple_element(divider, 1))
+        || term_to_int(term_get_tuple_element(divider, 0)) < 0 || term_to_int(term_get_tuple_element(divider, 1)) <= 0) {
+        return false;
     }
+    *r_top = term_to_int(term_get_tuple_element(divider, 0));
+    *r_bottom = term_to_int(term_get_tuple_element(divider, 1));
+    return true;
 }
 
-const struct Nif *atomvm_adc_get_nif(const char *nifname)
+//
+// {ntc, Options} | {divider, RTop, RBottom} | {li_ion, Options}
+//
+static bool parse_profile(term profile, GlobalContext *global, struct adc_profile *out)
 {
-    TRACE("Locating nif %s ...", nifname);
-    if (strcmp("adc:config_width/2", nifname) == 0) {
-        TRACE("Resolved platform nif %s ...\n", nifname);
-        return &adc_config_width_nif;
+    if (!term_is_tuple(profile) || term_get_tuple_arity(profile) < 2) {
+        return false;
     }
-    if (strcmp("adc:config_channel_attenuation/2", nifname) == 0) {
-        TRACE("Resolved platform nif %s ...\n", nifname);
-        return &adc_config_channel_attenuation_nif;
+    term type = term_get_tuple_element(profile, 0);
+
+    if (type == globalcontext_make_atom(global, ATOM_STR("\x3", "ntc")) && term_get_tuple_arity(profile) == 2) {
+        term opts = term_get_tuple_element(profile, 1);
+        if (!term_is_list(opts)) {
+            return false;
+        }
+        if (!kv_get_float(opts, ATOM_STR("\x2", "r0"), 10000.0f, global, &out->ntc.r0)
+            || !kv_get_float(opts, ATOM_STR("\x2", "t0"), 25.0f, global, &out->ntc.t0)
+            || !kv_get_float(opts, ATOM_STR("\x6", "series"), out->ntc.r0, global, &out->ntc.series)
+            || !kv_get_float(opts, ATOM_STR("\x6", "supply"), 3300.0f, global, &out->ntc.supply_mv)) {
+            return false;
+        }
+        term position = interop_kv_get_value_default(opts, ATOM_STR("\x8", "position"), globalcontext_make_atom(global, ATOM_STR("\x3", "low")), global);
+        out->ntc.high_side = position == globalcontext_make_atom(global, ATOM_STR("\x4", "high"));
+        if (!out->ntc.high_side && position != globalcontext_make_atom(global, ATOM_STR("\x3", "low"))) {
+            return false;
+        }
+        term sh = interop_kv_get_value_default(opts, ATOM_STR("\xe", "steinhart_hart"), UNDEFINED_ATOM, global);
+        if (sh != UNDEFINED_ATOM) {
+            out->type = ADC_PROFILE_NTC_STEINHART_HART;
+            return term_is_tuple(sh) && term_get_tuple_arity(sh) == 3
+                && term_to_float_value(term_get_tuple_element(sh, 0), &out->ntc.a)
+                && term_to_float_value(term_get_tuple_element(sh, 1), &out->ntc.b)
+                && term_to_float_value(term_get_tuple_element(sh, 2), &out->ntc.c)
+                && out->ntc.series > 0.0f && out->ntc.supply_mv > 0.0f;
+        }
+        out->type = ADC_PROFILE_NTC_BETA;
+        return kv_get_float(opts, ATOM_STR("\x4", "beta"), 3950.0f, global, &out->ntc.beta)
+            && out->ntc.beta > 0.0f && out->ntc.r0 > 0.0f && out->ntc.series > 0.0f && out->ntc.supply_mv > 0.0f;
     }
-    if (strcmp("adc:take_reading/4", nifname) == 0) {
+
+    if (type == globalcontext_make_atom(global, ATOM_STR("\x7", "divider")) && term_get_tuple_arity(profile) == 3) {
+        term r_top = term_get_tuple_element(profile, 1);
+        term r_bottom = term_get_tuple_element(profile, 2);
+        if (!term_is_integer(r_top) || !term_is_integer(r_bottom) || term_to_int(r_top) < 0 || term_to_int(r_bottom) <= 0) {
+            return false;
+        }
+        out->type = ADC_PROFILE_DIVIDER;
+        out->divider.r_top = term_to_int(r_top);
+        out->divider.r_bottom = term_to_int(r_bottom);
+        return true;
+    }
+
+    if (type == globalcontext_make_atom(global, ATOM_STR("\x6", "li_ion")) && term_get_tuple_arity(profile) == 2) {
+        term opts = term_get_tuple_element(profile, 1);
+        if (!term_is_list(opts)) {
+            return false;
+        }
+        term cells = interop_kv_get_value_default(opts, ATOM_STR("\x5", "cells"), term_from_int(1), global);
+        if (!term_is_integer(cells) || term_to_int(cells) < 1) {
+            return false;
+        }
+        out->type = ADC_PROFILE_LI_ION;
+        out->li_ion.cells = term_to_int(cells);
+        return kv_get_divider(opts, global, &out->li_ion.r_top, &out->li_ion.r_bottom);
+    }
+
+    return false;
+}
+
+static term nif_adc_compile_profile(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    struct adc_profile profile;
+    if (UNLIKELY(!parse_profile(argv[0], ctx->global, &profile))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term attenuation = argv[1];
+    VALIDATE_VALUE(attenuation, term_is_atom);
+    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+    if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_db_atom));
+    }
+
+    // the table only covers the input range of the configured attenuation,
+    // which gives the best interpolation step for the available points
+    uint32_t max_mv = attenuation_max_mv[atten];
+    struct adc_lut *lut = enif_alloc_resource(profile_resource_type, adc_lut_size(max_mv));
+    if (UNLIKELY(IS_NULL_PTR(lut))) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    adc_lut_compile(&profile, max_mv, lut);
+    TRACE("compile_profile: %u points, %u mV step\n", lut->points, 1 << lut->shift);
+
+    if (UNLIKELY(memory_ensure_free(ctx, TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
+        enif_release_resource(lut);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term obj = enif_make_resource(erl_nif_env_from_context(ctx), lut);
+    enif_release_resource(lut);
+    return obj;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_SCAN_ENABLE
+//
+// Channel scans
+//
+// The channels of a scan are visited in an order planned to minimize
+// reconfiguration: grouped by unit, then by bit width (the adc1 width is
+// global to the unit), then by attenuation, so the SAR input stage sees as
+// few range changes as possible.  Each channel discards its settling
+// conversions after the multiplexer switches to it.
+//
+
+struct scan_entry
+{
+    struct adc_acq_channel ch;
+    adc_atten_t atten;
+    uint8_t index;
+    uint64_t sum;
+    uint32_t voltage;
+};
+
+static int scan_entry_compare(const struct scan_entry *a, const struct scan_entry *b)
+{
+    if (a->ch.adc_unit != b->ch.adc_unit) {
+        return a->ch.adc_unit < b->ch.adc_unit ? -1 : 1;
+    }
+    if (a->ch.bit_width != b->ch.bit_width) {
+        return a->ch.bit_width < b->ch.bit_width ? -1 : 1;
+    }
+    if (a->atten != b->atten) {
+        return a->atten < b->atten ? -1 : 1;
+    }
+    return (int) a->ch.channel - (int) b->ch.channel;
+}
+
+static void scan_plan(struct scan_entry *entries, size_t n)
+{
+    // insertion sort; scans are at most MAX_SCAN_CHANNELS long
+    for (size_t i = 1; i < n; ++i) {
+        struct scan_entry entry = entries[i];
+        size_t j = i;
+        while (j > 0 && scan_entry_compare(&entries[j - 1], &entry) > 0) {
+            entries[j] = entries[j - 1];
+            --j;
+        }
+        entries[j] = entry;
+    }
+}
+
+static term nif_adc_take_scan(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    term channels = argv[0];
+    VALIDATE_VALUE(channels, term_is_list);
+    term read_options = argv[1];
+    VALIDATE_VALUE(read_options, term_is_list);
+    struct read_options opts;
+    if (UNLIKELY(!parse_read_options(ctx, read_options, &opts))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    // scanned channels have no profiles to compute values with
+    if (UNLIKELY(opts.samples > MAX_SCAN_SAMPLES || opts.value || opts.lut != NULL)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    // as for readings, a discard option overrides the setting of each pin
+    bool override_discard = !term_is_invalid_term(interop_kv_get_value(read_options, ATOM_STR("\x7", "discard"), ctx->global));
+
+    struct scan_entry entries[MAX_SCAN_CHANNELS];
+    size_t n = 0;
+    while (term_is_nonempty_list(channels)) {
+        term channel = term_get_list_head(channels);
+        if (UNLIKELY(n == MAX_SCAN_CHANNELS || !term_is_tuple(channel) || term_get_tuple_arity(channel) != 4)) {
+            RAISE_ERROR(BADARG_ATOM);
+        }
+        // {Pin, BitWidth, Attenuation, Discard}
+        term pin = term_get_tuple_element(channel, 0);
+        term width = term_get_tuple_element(channel, 1);
+        term attenuation = term_get_tuple_element(channel, 2);
+        term discard = term_get_tuple_element(channel, 3);
+        VALIDATE_VALUE(pin, term_is_integer);
+        VALIDATE_VALUE(width, term_is_atom);
+        VALIDATE_VALUE(attenuation, term_is_atom);
+        VALIDATE_VALUE(discard, term_is_integer);
+
+        struct scan_entry *entry = &entries[n];
+        entry->ch.adc_unit = adc_unit_from_pin(term_to_int(pin));
+        entry->ch.channel = get_channel(term_to_int(pin));
+        if (UNLIKELY(entry->ch.channel == ADC_CHANNEL_MAX)) {
+            return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+        }
+        entry->ch.bit_width = interop_atom_term_select_int(bit_width_table, width, ctx->global);
+        if (UNLIKELY(entry->ch.bit_width == ADC_WIDTH_MAX)) {
+            return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_width_atom));
+        }
+        entry->atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+        if (UNLIKELY(entry->atten == ADC_ATTEN_MAX)) {
+            return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_db_atom));
+        }
+        if (override_discard) {
+            entry->ch.discard = opts.discard;
+        } else {
+            entry->ch.discard = term_to_int(discard) > 0 ? term_to_int(discard) : 0;
+        }
+        entry->index = n;
+        entry->sum = 0;
+        ++n;
+        channels = term_get_list_tail(channels);
+    }
+    if (UNLIKELY(n == 0)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    scan_plan(entries, n);
+
+    uint32_t conversions = 0;
+    ADC_TRACE(ADC_TRACE_SCAN_BEGIN, n, opts.samples);
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < n; ++i) {
+        // in chunks, as readings are, so that the acquisition task is never
+        // kept off the ADC for more than a chunk
+        for (avm_int_t taken = 0; taken < opts.samples;) {
+            avm_int_t chunk = opts.samples - taken;
+            if (chunk > CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES) {
+                chunk = CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES;
+            }
+            esp_err_t err = adc_acq_sample(&entries[i].ch, chunk, &entries[i].sum, &conversions);
+            if (UNLIKELY(err != ESP_OK)) {
+                ADC_TRACE(ADC_TRACE_SCAN_END, err, conversions);
+                return sample_error(ctx, err);
+            }
+            taken += chunk;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    if (elapsed_us < 1) {
+        elapsed_us = 1;
+    }
+    ADC_TRACE(ADC_TRACE_SCAN_END, ESP_OK, conversions);
+
+    // entries are sorted by calibration group, so look up characteristics once per group
+    esp_adc_cal_characteristics_t adc_chars;
+    const struct scan_entry *group = NULL;
+    uint8_t position[MAX_SCAN_CHANNELS];
+    for (size_t i = 0; i < n; ++i) {
+        struct scan_entry *entry = &entries[i];
+        entry->sum /= opts.samples;
+        if (opts.voltage) {
+            if (group == NULL || group->ch.adc_unit != entry->ch.adc_unit || group->ch.bit_width != entry->ch.bit_width || group->atten != entry->atten) {
+                adc_cal_get(entry->ch.adc_unit, entry->atten, entry->ch.bit_width, &adc_chars, NULL);
+                group = entry;
+            }
+            entry->voltage = esp_adc_cal_raw_to_voltage((uint32_t) entry->sum, &adc_chars);
+        }
+        position[entry->index] = i;
+    }
+
+    // {[{Raw, Voltage}], [{scan_rate, Hz}, {conversion_rate, Hz}, {conversions, N}]}
+    size_t info_size = 3 * (CONS_SIZE + TUPLE_SIZE(2) + BOXED_INT64_SIZE);
+    if (UNLIKELY(memory_ensure_free(ctx, n * (CONS_SIZE + TUPLE_SIZE(2)) + info_size + TUPLE_SIZE(2)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term list = term_nil();
+    for (size_t i = n; i > 0; --i) {
+        const struct scan_entry *entry = &entries[position[i - 1]];
+        term raw = opts.raw ? term_from_int32((int32_t) entry->sum) : UNDEFINED_ATOM;
+        term voltage = opts.voltage ? term_from_int32(entry->voltage) : UNDEFINED_ATOM;
+        list = term_list_prepend(create_pair(ctx, raw, voltage), list, &ctx->heap);
+    }
+    term info = term_nil();
+    info = term_list_prepend(create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xb", "conversions")), term_make_maybe_boxed_int64(conversions, &ctx->heap)), info, &ctx->heap);
+    info = term_list_prepend(create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xf", "conversion_rate")), term_make_maybe_boxed_int64(conversions * 1000000LL / elapsed_us, &ctx->heap)), info, &ctx->heap);
+    info = term_list_prepend(create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "scan_rate")), term_make_maybe_boxed_int64(1000000LL / elapsed_us, &ctx->heap)), info, &ctx->heap);
+    return create_pair(ctx, list, info);
+}
+#endif
+
+static term nif_adc_submit_reading(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    term pin = argv[0];
+    VALIDATE_VALUE(pin, term_is_integer);
+    adc_channel_t channel = get_channel(term_to_int(pin));
+    if (UNLIKELY(channel == ADC_CHANNEL_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+    }
+
+    term read_options = argv[1];
+    VALIDATE_VALUE(read_options, term_is_list);
+    struct read_options opts;
+    if (UNLIKELY(!parse_read_options(ctx, read_options, &opts))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    term priority = interop_kv_get_value_default(read_options, ATOM_STR("\x8", "priority"), globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "normal")), ctx->global);
+    VALIDATE_VALUE(priority, term_is_atom);
+    adc_acq_priority_t prio = interop_atom_term_select_int(priority_table, priority, ctx->global);
+    if (UNLIKELY(prio == ADC_ACQ_PRIORITY_MAX)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    term deadline = interop_kv_get_value_default(read_options, ATOM_STR("\x8", "deadline"), UNDEFINED_ATOM, ctx->global);
+    if (UNLIKELY(deadline != UNDEFINED_ATOM && (!term_is_integer(deadline) || term_to_int(deadline) < 0))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    term width = argv[2];
+    VALIDATE_VALUE(width, term_is_atom);
+    adc_bits_width_t bit_width = interop_atom_term_select_int(bit_width_table, width, ctx->global);
+    if (UNLIKELY(bit_width == ADC_WIDTH_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_width_atom));
+    }
+
+    term attenuation = argv[3];
+    VALIDATE_VALUE(attenuation, term_is_atom);
+    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+    if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_db_atom));
+    }
+
+    term reply_to = argv[4];
+    VALIDATE_VALUE(reply_to, term_is_pid);
+
+    struct adc_acq_read *read = calloc(1, sizeof(struct adc_acq_read));
+    if (UNLIKELY(IS_NULL_PTR(read))) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    read->global = ctx->global;
+    read->reply_to = term_to_local_process_id(reply_to);
+    read->ref_ticks = globalcontext_get_ref_ticks(ctx->global);
+    read->ch.adc_unit = adc_unit_from_pin(term_to_int(pin));
+    read->ch.channel = channel;
+    read->ch.bit_width = bit_width;
+    read->ch.discard = opts.discard;
+    read->atten = atten;
+    read->samples = opts.samples;
+    read->raw = opts.raw;
+    read->voltage = opts.voltage;
+    read->priority = prio;
+    read->deadline_us = deadline == UNDEFINED_ATOM ? ADC_ACQ_NO_DEADLINE : esp_timer_get_time() + (int64_t) term_to_int(deadline) * 1000;
+    uint64_t ref_ticks = read->ref_ticks;
+
+    ADC_TRACE(ADC_TRACE_SUBMIT, prio, opts.samples);
+    esp_err_t err = adc_acq_submit(read);
+    if (UNLIKELY(err != ESP_OK)) {
+        free(read);
+        return make_error(ctx, term_from_int(err));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + REF_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    return create_pair(ctx, OK_ATOM, term_from_ref_ticks(ref_ticks, &ctx->heap));
+}
+
+static term nif_adc_scheduler_stats(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+    UNUSED(argv);
+
+    struct adc_acq_stats stats;
+    adc_acq_get_stats(&stats);
+
+    // [{preemptions, N}, {pending, N}, {Priority, [{completed, N}, {deadline_misses, N}]}, ...]
+    size_t counter_size = TUPLE_SIZE(2) + CONS_SIZE + BOXED_INT64_SIZE;
+    size_t class_size = 2 * counter_size + TUPLE_SIZE(2) + CONS_SIZE;
+    if (UNLIKELY(memory_ensure_free(ctx, 2 * counter_size + ADC_ACQ_PRIORITY_MAX * class_size) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    GlobalContext *global = ctx->global;
+
+    term ret = term_nil();
+    for (int i = ADC_ACQ_PRIORITY_MAX - 1; i >= 0; --i) {
+        term counters = term_nil();
+        counters = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\xf", "deadline_misses")), term_make_maybe_boxed_int64(stats.deadline_misses[i], &ctx->heap)), counters, &ctx->heap);
+        counters = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\x9", "completed")), term_make_maybe_boxed_int64(stats.completed[i], &ctx->heap)), counters, &ctx->heap);
+        ret = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, priority_table[i].as_str), counters), ret, &ctx->heap);
+    }
+    ret = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\x7", "pending")), term_make_maybe_boxed_int64(stats.pending, &ctx->heap)), ret, &ctx->heap);
+    ret = term_list_prepend(create_pair(ctx, globalcontext_make_atom(global, ATOM_STR("\xb", "preemptions")), term_make_maybe_boxed_int64(stats.preemptions, &ctx->heap)), ret, &ctx->heap);
+    return ret;
+}
+
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+static bool parse_smooth(term spec, GlobalContext *global, struct adc_smooth *out)
+{
+    if (!term_is_tuple(spec) || term_get_tuple_arity(spec) < 2) {
+        return false;
+    }
+    term type = term_get_tuple_element(spec, 0);
+    term window = term_get_tuple_element(spec, 1);
+    if (!term_is_integer(window) || term_to_int(window) < 1) {
+        return false;
+    }
+    if (type == globalcontext_make_atom(global, ATOM_STR("\xe", "moving_average")) && term_get_tuple_arity(spec) == 2) {
+        // {moving_average, Window}
+        return adc_smooth_init_moving_average(out, term_to_int(window));
+    }
+    if (type == globalcontext_make_atom(global, ATOM_STR("\xe", "savitzky_golay")) && term_get_tuple_arity(spec) == 3) {
+        // {savitzky_golay, Window, Order}
+        term order = term_get_tuple_element(spec, 2);
+        if (!term_is_integer(order) || term_to_int(order) < 0) {
+            return false;
+        }
+        return adc_smooth_init_savitzky_golay(out, term_to_int(window), term_to_int(order));
+    }
+    return false;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+//
+// Background samplers
+//
+
+static bool parse_filter(term spec, GlobalContext *global, struct adc_filter **out)
+{
+    if (spec == UNDEFINED_ATOM) {
+        *out = NULL;
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_FILTER_ENABLE
+    if (!term_is_tuple(spec) || term_get_tuple_arity(spec) != 3) {
+        return false;
+    }
+    term type = term_get_tuple_element(spec, 0);
+    float a;
+    float b;
+    if (!term_to_float_value(term_get_tuple_element(spec, 1), &a) || !term_to_float_value(term_get_tuple_element(spec, 2), &b)) {
+        return false;
+    }
+
+    struct adc_filter *filter = malloc(sizeof(struct adc_filter));
+    if (IS_NULL_PTR(filter)) {
+        return false;
+    }
+    if (type == globalcontext_make_atom(global, ATOM_STR("\x6", "kalman")) && a >= 0.0f && b > 0.0f) {
+        // {kalman, ProcessNoise, MeasurementNoise}, variances in mV^2
+        adc_filter_init_kalman(filter, (int64_t) (a * ADC_FILTER_ONE), (int64_t) (b * ADC_FILTER_ONE));
+    } else if (type == globalcontext_make_atom(global, ATOM_STR("\xa", "alpha_beta")) && a > 0.0f && a <= 1.0f && b >= 0.0f && b <= 2.0f) {
+        // {alpha_beta, Alpha, Beta}
+        adc_filter_init_alpha_beta(filter, (int32_t) (a * ADC_FILTER_ONE), (int32_t) (b * ADC_FILTER_ONE));
+    } else {
+        free(filter);
+        return false;
+    }
+    *out = filter;
+    return true;
+#else
+    UNUSED(global);
+    return false;
+#endif
+}
+
+static bool parse_stream(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term block_size = interop_kv_get_value_default(options, ATOM_STR("\x6", "stream"), UNDEFINED_ATOM, global);
+    term smooth_spec = interop_kv_get_value_default(options, ATOM_STR("\x6", "smooth"), UNDEFINED_ATOM, global);
+    if (block_size == UNDEFINED_ATOM) {
+        // smoothing only applies to streamed blocks
+        return smooth_spec == UNDEFINED_ATOM;
+    }
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (!term_is_integer(block_size) || term_to_int(block_size) < 1 || term_to_int(block_size) > ADC_SAMPLER_MAX_BLOCK) {
+        return false;
+    }
+
+    struct adc_smooth *smooth = NULL;
+    if (smooth_spec != UNDEFINED_ATOM) {
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+        smooth = malloc(sizeof(struct adc_smooth));
+        if (IS_NULL_PTR(smooth)) {
+            return false;
+        }
+        if (!parse_smooth(smooth_spec, global, smooth)) {
+            free(smooth);
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+    return adc_sampler_set_stream(sampler, term_to_int(block_size), smooth);
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static inline bool kv_get_int(term kv, AtomString key, avm_int_t default_value, avm_int_t min, avm_int_t max, GlobalContext *global, avm_int_t *out)
+{
+    term value = interop_kv_get_value_default(kv, key, term_from_int(default_value), global);
+    if (!term_is_integer(value) || term_to_int(value) < min || term_to_int(value) > max) {
+        return false;
+    }
+    *out = term_to_int(value);
+    return true;
+}
+
+static bool parse_envelope(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x8", "envelope"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_ENVELOPE_ENABLE
+    if (!term_is_list(spec)) {
+        return false;
+    }
+    // times in ms, voltages in mV
+    avm_int_t attack;
+    avm_int_t decay;
+    avm_int_t threshold;
+    avm_int_t separation;
+    if (!kv_get_int(spec, ATOM_STR("\x6", "attack"), DEFAULT_ENVELOPE_ATTACK, 0, 60000, global, &attack)
+        || !kv_get_int(spec, ATOM_STR("\x5", "decay"), DEFAULT_ENVELOPE_DECAY, 0, 60000, global, &decay)
+        || !kv_get_int(spec, ATOM_STR("\x9", "threshold"), 0, 0, UINT16_MAX, global, &threshold)
+        || !kv_get_int(spec, ATOM_STR("\xa", "separation"), DEFAULT_ENVELOPE_SEPARATION, 0, 3600000, global, &separation)) {
+        return false;
+    }
+    term center = interop_kv_get_value_default(spec, ATOM_STR("\x6", "center"), globalcontext_make_atom(global, ATOM_STR("\x4", "auto")), global);
+    avm_int_t center_mv;
+    if (center == globalcontext_make_atom(global, ATOM_STR("\x4", "auto"))) {
+        center_mv = ADC_ENVELOPE_AUTO_CENTER;
+    } else if (term_is_integer(center) && term_to_int(center) >= 0 && term_to_int(center) <= UINT16_MAX) {
+        center_mv = term_to_int(center);
+    } else {
+        return false;
+    }
+
+    sampler->envelope = malloc(sizeof(struct adc_envelope));
+    if (IS_NULL_PTR(sampler->envelope)) {
+        return false;
+    }
+    adc_envelope_init(sampler->envelope, sampler->period_us, (int64_t) attack * 1000, (int64_t) decay * 1000,
+        center_mv, threshold, (int64_t) separation * 1000);
+    return true;
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_power(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x5", "power"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_POWER_ENABLE
+    if (!term_is_list(spec)) {
+        return false;
+    }
+    avm_int_t frequency;
+    avm_int_t cycles;
+    avm_int_t harmonics;
+    if (!kv_get_int(spec, ATOM_STR("\x9", "frequency"), DEFAULT_POWER_FREQUENCY, 1, 1000, global, &frequency)
+        || !kv_get_int(spec, ATOM_STR("\x6", "cycles"), DEFAULT_POWER_CYCLES, 1, 1000, global, &cycles)
+        || !kv_get_int(spec, ATOM_STR("\x9", "harmonics"), DEFAULT_POWER_HARMONICS, 1, ADC_POWER_MAX_HARMONICS, global, &harmonics)) {
+        return false;
+    }
+    sampler->power = malloc(sizeof(struct adc_power));
+    if (IS_NULL_PTR(sampler->power)) {
+        return false;
+    }
+    return adc_power_init(sampler->power, sampler->period_us, frequency, cycles, harmonics);
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_pulse(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x5", "pulse"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_PULSE_ENABLE
+    if (!term_is_list(spec)) {
+        return false;
+    }
+    // {threshold, {Low, High}} in mV, {window, Ms}
+    term threshold = interop_kv_get_value_default(spec, ATOM_STR("\x9", "threshold"), UNDEFINED_ATOM, global);
+    if (!term_is_tuple(threshold) || term_get_tuple_arity(threshold) != 2) {
+        return false;
+    }
+    term low = term_get_tuple_element(threshold, 0);
+    term high = term_get_tuple_element(threshold, 1);
+    if (!term_is_integer(low) || !term_is_integer(high) || term_to_int(low) < 0 || term_to_int(high) < term_to_int(low)
+        || term_to_int(high) > UINT16_MAX) {
+        return false;
+    }
+    avm_int_t window;
+    if (!kv_get_int(spec, ATOM_STR("\x6", "window"), DEFAULT_PULSE_WINDOW, 1, 3600000, global, &window)) {
+        return false;
+    }
+    sampler->pulse = malloc(sizeof(struct adc_pulse));
+    if (IS_NULL_PTR(sampler->pulse)) {
+        return false;
+    }
+    adc_pulse_init(sampler->pulse, term_to_int(low), term_to_int(high), (int64_t) window * 1000);
+    return true;
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_health(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x6", "health"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_HEALTH_ENABLE
+    if (!term_is_list(spec)) {
+        return false;
+    }
+    avm_int_t window;
+    avm_int_t noise;
+    if (!kv_get_int(spec, ATOM_STR("\x6", "window"), DEFAULT_HEALTH_WINDOW, 2, MAX_HEALTH_WINDOW, global, &window)
+        || !kv_get_int(spec, ATOM_STR("\x5", "noise"), DEFAULT_HEALTH_NOISE, 1, UINT16_MAX, global, &noise)) {
+        return false;
+    }
+    sampler->health = malloc(sizeof(struct adc_health));
+    if (IS_NULL_PTR(sampler->health)) {
+        return false;
+    }
+    // ADC_WIDTH_BIT_9 is 0, and each following width is one more bit
+    uint32_t max_raw = (1 << (9 + sampler->ch.bit_width)) - 1;
+    adc_health_init(sampler->health, window, max_raw, noise);
+    return true;
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+#ifdef CONFIG_AVM_ADC_PHASE_ENABLE
+// {Pin, BitWidth, Attenuation, Discard}
+static bool parse_channel(term channel, GlobalContext *global, struct adc_acq_channel *ch, adc_atten_t *atten)
+{
+    if (!term_is_tuple(channel) || term_get_tuple_arity(channel) != 4) {
+        return false;
+    }
+    term pin = term_get_tuple_element(channel, 0);
+    term width = term_get_tuple_element(channel, 1);
+    term attenuation = term_get_tuple_element(channel, 2);
+    term discard = term_get_tuple_element(channel, 3);
+    if (!term_is_integer(pin) || !term_is_atom(width) || !term_is_atom(attenuation) || !term_is_integer(discard)) {
+        return false;
+    }
+    ch->adc_unit = adc_unit_from_pin(term_to_int(pin));
+    ch->channel = get_channel(term_to_int(pin));
+    ch->bit_width = interop_atom_term_select_int(bit_width_table, width, global);
+    ch->discard = term_to_int(discard) > 0 ? term_to_int(discard) : 0;
+    *atten = interop_atom_term_select_int(attenuation_table, attenuation, global);
+    return ch->channel != ADC_CHANNEL_MAX && ch->bit_width != ADC_WIDTH_MAX && *atten != ADC_ATTEN_MAX;
+}
+#endif
+
+static bool parse_phase(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x5", "phase"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_PHASE_ENABLE
+    if (!term_is_list(spec)) {
+        return false;
+    }
+    adc_atten_t atten;
+    term channel = interop_kv_get_value_default(spec, ATOM_STR("\x7", "channel"), UNDEFINED_ATOM, global);
+    if (!parse_channel(channel, global, &sampler->ch2, &atten)) {
+        return false;
+    }
+    if (sampler->ch2.adc_unit == sampler->ch.adc_unit && sampler->ch2.channel == sampler->ch.channel) {
+        return false;
+    }
+
+    term method = interop_kv_get_value_default(spec, ATOM_STR("\x6", "method"), globalcontext_make_atom(global, ATOM_STR("\x8", "goertzel")), global);
+    adc_phase_method_t phase_method;
+    if (method == globalcontext_make_atom(global, ATOM_STR("\x8", "goertzel"))) {
+        phase_method = ADC_PHASE_GOERTZEL;
+    } else if (method == globalcontext_make_atom(global, ATOM_STR("\x5", "xcorr"))) {
+        phase_method = ADC_PHASE_XCORR;
+    } else {
+        return false;
+    }
+    avm_int_t frequency;
+    avm_int_t cycles;
+    avm_int_t max_lag;
+    if (!kv_get_int(spec, ATOM_STR("\x9", "frequency"), DEFAULT_POWER_FREQUENCY, 1, 1000, global, &frequency)
+        || !kv_get_int(spec, ATOM_STR("\x6", "cycles"), DEFAULT_POWER_CYCLES, 1, 1000, global, &cycles)) {
+        return false;
+    }
+    // by default, look for lags of up to half a cycle either way
+    avm_int_t half_cycle = 1000000 / (2 * frequency * sampler->period_us);
+    if (!kv_get_int(spec, ATOM_STR("\x7", "max_lag"), half_cycle > 0 ? half_cycle : 1, 1, ADC_PHASE_MAX_WINDOW, global, &max_lag)) {
+        return false;
+    }
+
+    sampler->phase = calloc(1, sizeof(struct adc_phase));
+    if (IS_NULL_PTR(sampler->phase)) {
+        return false;
+    }
+    adc_cal_get(sampler->ch2.adc_unit, atten, sampler->ch2.bit_width, &sampler->adc_chars2, NULL);
+    return adc_phase_init(sampler->phase, phase_method, sampler->period_us, frequency, cycles, max_lag);
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_quantiles(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term spec = interop_kv_get_value_default(options, ATOM_STR("\x9", "quantiles"), UNDEFINED_ATOM, global);
+    if (spec == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_QUANTILES_ENABLE
+    float p[ADC_QUANTILES_MAX];
+    unsigned n = 0;
+    while (term_is_nonempty_list(spec)) {
+        if (n == ADC_QUANTILES_MAX || !term_to_float_value(term_get_list_head(spec), &p[n])) {
+            return false;
+        }
+        ++n;
+        spec = term_get_list_tail(spec);
+    }
+    if (!term_is_nil(spec)) {
+        return false;
+    }
+    sampler->quantiles = malloc(sizeof(struct adc_quantiles));
+    if (IS_NULL_PTR(sampler->quantiles)) {
+        return false;
+    }
+    return adc_quantiles_init(sampler->quantiles, p, n);
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_jitter(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term enabled = interop_kv_get_value_default(options, ATOM_STR("\x6", "jitter"), FALSE_ATOM, global);
+    if (enabled == FALSE_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+    if (enabled != TRUE_ATOM) {
+        return false;
+    }
+    sampler->jitter = malloc(sizeof(struct adc_jitter));
+    if (IS_NULL_PTR(sampler->jitter)) {
+        return false;
+    }
+    adc_jitter_init(sampler->jitter, sampler->period_us);
+    return true;
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_sink(Context *ctx, term options, struct adc_sampler *sampler)
+{
+    term sink = interop_kv_get_value_default(options, ATOM_STR("\x4", "sink"), UNDEFINED_ATOM, ctx->global);
+    if (sink == UNDEFINED_ATOM) {
+        return true;
+    }
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+    void *rsrc_obj_ptr;
+    if (sampler->block == NULL || !enif_get_resource(erl_nif_env_from_context(ctx), sink, sink_resource_type, &rsrc_obj_ptr)) {
+        return false;
+    }
+    struct sink_resource *rsrc = (struct sink_resource *) rsrc_obj_ptr;
+
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sink != NULL) {
+        adc_sink_retain(rsrc->sink);
+        sampler->sink = rsrc->sink;
+    }
+    xSemaphoreGive(sampler_resource_lock);
+    return sampler->sink != NULL;
+#else
+    UNUSED(sampler);
+    return false;
+#endif
+}
+
+static bool parse_sampler_options(term options, GlobalContext *global, struct adc_sampler *sampler)
+{
+    term rate = interop_kv_get_value_default(options, ATOM_STR("\x4", "rate"), term_from_int(DEFAULT_SAMPLER_RATE), global);
+    if (!term_is_integer(rate) || term_to_int(rate) < 1 || term_to_int(rate) > ADC_SAMPLER_MAX_RATE) {
+        return false;
+    }
+    sampler->period_us = 1000000 / term_to_int(rate);
+
+    term samples = interop_kv_get_value_default(options, ATOM_STR("\x7", "samples"), term_from_int(1), global);
+    if (!term_is_integer(samples) || term_to_int(samples) < 1 || term_to_int(samples) > CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES) {
+        return false;
+    }
+    sampler->oversample = term_to_int(samples);
+
+    term filter = interop_kv_get_value_default(options, ATOM_STR("\x6", "filter"), UNDEFINED_ATOM, global);
+    if (!parse_filter(filter, global, &sampler->filter)) {
+        return false;
+    }
+    return parse_quantiles(options, global, sampler) && parse_jitter(options, global, sampler)
+        && parse_envelope(options, global, sampler) && parse_power(options, global, sampler)
+        && parse_pulse(options, global, sampler) && parse_health(options, global, sampler)
+        && parse_phase(options, global, sampler) && parse_stream(options, global, sampler);
+}
+
+static void sampler_resource_stop(struct sampler_resource *rsrc)
+{
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    struct adc_sampler *sampler = rsrc->sampler;
+    rsrc->sampler = NULL;
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (sampler != NULL) {
+        adc_acq_sampler_stop(sampler);
+    }
+}
+
+static term nif_adc_sampler_create(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    term pin = argv[0];
+    VALIDATE_VALUE(pin, term_is_integer);
+    adc_channel_t channel = get_channel(term_to_int(pin));
+    if (UNLIKELY(channel == ADC_CHANNEL_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_pin_atom));
+    }
+
+    term width = argv[1];
+    VALIDATE_VALUE(width, term_is_atom);
+    adc_bits_width_t bit_width = interop_atom_term_select_int(bit_width_table, width, ctx->global);
+    if (UNLIKELY(bit_width == ADC_WIDTH_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_width_atom));
+    }
+
+    term attenuation = argv[2];
+    VALIDATE_VALUE(attenuation, term_is_atom);
+    adc_atten_t atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+    if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_db_atom));
+    }
+
+    term discard = argv[3];
+    VALIDATE_VALUE(discard, term_is_integer);
+    term options = argv[4];
+    VALIDATE_VALUE(options, term_is_list);
+    term owner = argv[5];
+    VALIDATE_VALUE(owner, term_is_pid);
+
+    struct adc_sampler *sampler = adc_sampler_new();
+    if (UNLIKELY(IS_NULL_PTR(sampler))) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    sampler->global = ctx->global;
+    sampler->owner = term_to_local_process_id(owner);
+    sampler->ref_ticks = globalcontext_get_ref_ticks(ctx->global);
+    sampler->ch.adc_unit = adc_unit_from_pin(term_to_int(pin));
+    sampler->ch.channel = channel;
+    sampler->ch.bit_width = bit_width;
+    sampler->ch.discard = term_to_int(discard) > 0 ? term_to_int(discard) : 0;
+    sampler->atten = atten;
+    sampler->source = term_to_int(pin);
+    adc_cal_get(sampler->ch.adc_unit, atten, bit_width, &sampler->adc_chars, NULL);
+    if (UNLIKELY(!parse_sampler_options(options, ctx->global, sampler) || !parse_sink(ctx, options, sampler))) {
+        adc_sampler_destroy(sampler);
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    struct sampler_resource *rsrc = enif_alloc_resource(sampler_resource_type, sizeof(struct sampler_resource));
+    if (UNLIKELY(IS_NULL_PTR(rsrc))) {
+        adc_sampler_destroy(sampler);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    rsrc->sampler = NULL;
+    uint64_t ref_ticks = sampler->ref_ticks;
+
+    esp_err_t err = adc_acq_sampler_start(sampler);
+    if (UNLIKELY(err != ESP_OK)) {
+        adc_sampler_destroy(sampler);
+        enif_release_resource(rsrc);
+        return make_error(ctx, term_from_int(err));
+    }
+    rsrc->sampler = sampler;
+    TRACE("sampler_create: channel %u every %lli us\n", channel, sampler->period_us);
+
+    // the owner may exit without stopping the sampler, while other processes
+    // still reference it
+    ErlNifPid owner_pid = owner;
+    if (UNLIKELY(enif_monitor_process(erl_nif_env_from_context(ctx), rsrc, &owner_pid, &rsrc->monitor) != 0)) {
+        sampler_resource_stop(rsrc);
+        enif_release_resource(rsrc);
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "noproc")));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + REF_SIZE + TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
+        enif_release_resource(rsrc);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term obj = enif_make_resource(erl_nif_env_from_context(ctx), rsrc);
+    enif_release_resource(rsrc);
+    return create_pair(ctx, term_from_ref_ticks(ref_ticks, &ctx->heap), obj);
+}
+
+static void sampler_resource_dtor(ErlNifEnv *caller_env, void *obj)
+{
+    UNUSED(caller_env);
+
+    // nobody references the sampler anymore, so nobody can stop it either
+    sampler_resource_stop((struct sampler_resource *) obj);
+}
+
+static void sampler_resource_down(ErlNifEnv *caller_env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon)
+{
+    UNUSED(caller_env);
+    UNUSED(pid);
+    UNUSED(mon);
+
+    // messages would go nowhere, and nobody may be left to stop the sampler
+    TRACE("sampler_resource_down: owner exited\n");
+    sampler_resource_stop((struct sampler_resource *) obj);
+}
+
+static term nif_adc_sampler_destroy(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+    sampler_resource_stop(rsrc);
+    // fails if the owner has exited already
+    enif_demonitor_process(erl_nif_env_from_context(ctx), rsrc, &rsrc->monitor);
+    return OK_ATOM;
+}
+
+static term nif_adc_sampler_reconfigure(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+    term options = argv[1];
+    VALIDATE_VALUE(options, term_is_list);
+
+    term attenuation = interop_kv_get_value_default(options, ATOM_STR("\xb", "attenuation"), UNDEFINED_ATOM, ctx->global);
+    adc_atten_t atten = ADC_ATTEN_MAX;
+    if (attenuation != UNDEFINED_ATOM) {
+        VALIDATE_VALUE(attenuation, term_is_atom);
+        atten = interop_atom_term_select_int(attenuation_table, attenuation, ctx->global);
+        if (UNLIKELY(atten == ADC_ATTEN_MAX)) {
+            return make_error(ctx, globalcontext_make_atom(ctx->global, invalid_db_atom));
+        }
+    }
+    term rate = interop_kv_get_value_default(options, ATOM_STR("\x4", "rate"), UNDEFINED_ATOM, ctx->global);
+    if (rate != UNDEFINED_ATOM && (!term_is_integer(rate) || term_to_int(rate) < 1 || term_to_int(rate) > ADC_SAMPLER_MAX_RATE)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    term samples = interop_kv_get_value_default(options, ATOM_STR("\x7", "samples"), UNDEFINED_ATOM, ctx->global);
+    if (samples != UNDEFINED_ATOM && (!term_is_integer(samples) || term_to_int(samples) < 1 || term_to_int(samples) > CONFIG_AVM_ADC_ACQ_CHUNK_SAMPLES)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    // {filter, undefined} removes the filter
+    term filter_spec = interop_kv_get_value(options, ATOM_STR("\x6", "filter"), ctx->global);
+    struct adc_filter *filter = NULL;
+    if (!term_is_invalid_term(filter_spec) && !parse_filter(filter_spec, ctx->global, &filter)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct adc_sampler_config *config = malloc(sizeof(struct adc_sampler_config));
+    if (IS_NULL_PTR(config)) {
+        free(filter);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+
+    term error = OK_ATOM;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    struct adc_sampler *sampler = rsrc->sampler;
+    if (sampler == NULL) {
+        error = globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "stopped"));
+    } else if (rate != UNDEFINED_ATOM && (sampler->envelope != NULL || sampler->power != NULL || sampler->phase != NULL)) {
+        // these processors are set up for the rate the sampler started with
+        error = globalcontext_make_atom(ctx->global, ATOM_STR("\xa", "fixed_rate"));
+    } else {
+        adc_sampler_get_config(sampler, config);
+        if (atten != ADC_ATTEN_MAX) {
+            config->atten = atten;
+            adc_cal_get(sampler->ch.adc_unit, atten, sampler->ch.bit_width, &config->adc_chars, NULL);
+        }
+        if (rate != UNDEFINED_ATOM) {
+            config->period_us = 1000000 / term_to_int(rate);
+        }
+        if (samples != UNDEFINED_ATOM) {
+            config->oversample = term_to_int(samples);
+        }
+        if (!term_is_invalid_term(filter_spec)) {
+            config->set_filter = true;
+            config->filter = filter;
+        }
+        adc_sampler_reconfigure(sampler, config);
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (error != OK_ATOM) {
+        free(filter);
+        free(config);
+        return make_error(ctx, error);
+    }
+    return OK_ATOM;
+}
+
+#ifdef CONFIG_AVM_ADC_FILTER_ENABLE
+static term nif_adc_sampler_filter(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+
+    struct adc_filter filter;
+    bool stopped = false;
+    bool has_filter = false;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sampler == NULL) {
+        stopped = true;
+    } else {
+        // the acquisition task swaps or removes the filter on reconfiguration
+        portENTER_CRITICAL(&rsrc->sampler->lock);
+        const struct adc_filter *current = rsrc->sampler->filter;
+        if (current != NULL) {
+            has_filter = true;
+            filter = *current;
+        }
+        portEXIT_CRITICAL(&rsrc->sampler->lock);
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (stopped) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "stopped")));
+    }
+    if (!has_filter) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "no_filter")));
+    }
+    if (!filter.initialized) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "no_data")));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, TUPLE_SIZE(2) + 2 * FLOAT_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term estimate = term_from_float((avm_float_t) filter.x / ADC_FILTER_ONE, &ctx->heap);
+    term variance = term_from_float((avm_float_t) filter.p / ADC_FILTER_ONE, &ctx->heap);
+    return create_pair(ctx, estimate, variance);
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_QUANTILES_ENABLE
+static term nif_adc_sampler_quantiles(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+
+    // only copy the estimates, not the whole estimator state, while in the
+    // critical section
+    float p[ADC_QUANTILES_MAX];
+    float estimates[ADC_QUANTILES_MAX];
+    unsigned n = 0;
+    uint64_t count = 0;
+    bool stopped = false;
+    bool has_quantiles = false;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sampler == NULL) {
+        stopped = true;
+    } else if (rsrc->sampler->quantiles != NULL) {
+        const struct adc_quantiles *quantiles = rsrc->sampler->quantiles;
+        has_quantiles = true;
+        portENTER_CRITICAL(&rsrc->sampler->lock);
+        count = quantiles->count;
+        n = quantiles->n;
+        for (unsigned i = 0; count > 0 && i < n; ++i) {
+            p[i] = quantiles->estimators[i].p;
+            estimates[i] = adc_quantiles_get(quantiles, i);
+        }
+        portEXIT_CRITICAL(&rsrc->sampler->lock);
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (stopped) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "stopped")));
+    }
+    if (!has_quantiles) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xc", "no_quantiles")));
+    }
+    if (count == 0) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "no_data")));
+    }
+
+    // [{P, Estimate}, ...]
+    if (UNLIKELY(memory_ensure_free(ctx, n * (CONS_SIZE + TUPLE_SIZE(2) + 2 * FLOAT_SIZE)) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term ret = term_nil();
+    for (int i = n - 1; i >= 0; --i) {
+        term quantile = create_pair(ctx, term_from_float(p[i], &ctx->heap), term_from_float(estimates[i], &ctx->heap));
+        ret = term_list_prepend(quantile, ret, &ctx->heap);
+    }
+    return ret;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+#define JITTER_STATS 8
+#define JITTER_SIZE (JITTER_STATS * (CONS_SIZE + TUPLE_SIZE(2)) + 4 * BOXED_INT64_SIZE + 3 * FLOAT_SIZE \
+    + ADC_JITTER_BUCKETS * (CONS_SIZE + BOXED_INT64_SIZE))
+
+static term nif_adc_sampler_jitter(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+
+    struct adc_jitter jitter;
+    bool stopped = false;
+    bool has_jitter = false;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sampler == NULL) {
+        stopped = true;
+    } else if (rsrc->sampler->jitter != NULL) {
+        has_jitter = true;
+        portENTER_CRITICAL(&rsrc->sampler->lock);
+        jitter = *rsrc->sampler->jitter;
+        portEXIT_CRITICAL(&rsrc->sampler->lock);
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (stopped) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "stopped")));
+    }
+    if (!has_jitter) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "no_jitter")));
+    }
+    if (jitter.intervals == 0) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "no_data")));
+    }
+
+    float mean;
+    float stddev;
+    adc_jitter_moments(&jitter, &mean, &stddev);
+
+    if (UNLIKELY(memory_ensure_free(ctx, JITTER_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term histogram = term_nil();
+    for (int i = ADC_JITTER_BUCKETS - 1; i >= 0; --i) {
+        histogram = term_list_prepend(term_make_maybe_boxed_int64(jitter.histogram[i], &ctx->heap), histogram, &ctx->heap);
+    }
+    term stats[JITTER_STATS] = {
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "intervals")), term_make_maybe_boxed_int64(jitter.intervals, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x3", "min")), term_make_maybe_boxed_int64(jitter.min_us, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x3", "max")), term_make_maybe_boxed_int64(jitter.max_us, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x4", "mean")), term_from_float(mean, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "stddev")), term_from_float(stddev, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x4", "rate")), term_from_float(mean > 0.0f ? 1000000.0f / mean : 0.0f, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "missed")), term_make_maybe_boxed_int64(jitter.missed, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "histogram")), histogram)
+    };
+    term ret = term_nil();
+    for (int i = JITTER_STATS - 1; i >= 0; --i) {
+        ret = term_list_prepend(stats[i], ret, &ctx->heap);
+    }
+    return ret;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+#define STREAM_STATS 5
+#define STREAM_STATS_SIZE (STREAM_STATS * (CONS_SIZE + TUPLE_SIZE(2) + BOXED_INT64_SIZE))
+
+static term nif_adc_sampler_stream_stats(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sampler_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sampler_resource *rsrc = (struct sampler_resource *) rsrc_obj_ptr;
+
+    struct adc_stream_stats stats;
+    uint32_t sequence = 0;
+    bool stopped = false;
+    bool has_stream = false;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sampler == NULL) {
+        stopped = true;
+    } else if (rsrc->sampler->block != NULL) {
+        has_stream = true;
+        portENTER_CRITICAL(&rsrc->sampler->lock);
+        stats = rsrc->sampler->stream_stats;
+        portEXIT_CRITICAL(&rsrc->sampler->lock);
+        // a plain read; the acquisition task may be one frame ahead
+        sequence = rsrc->sampler->sequence;
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (stopped) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "stopped")));
+    }
+    if (!has_stream) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x9", "no_stream")));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, STREAM_STATS_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term values[STREAM_STATS] = {
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x8", "sequence")), term_make_maybe_boxed_int64(sequence, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "frames")), term_make_maybe_boxed_int64(stats.frames, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x4", "gaps")), term_make_maybe_boxed_int64(stats.gaps, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xb", "lost_frames")), term_make_maybe_boxed_int64(stats.lost_frames, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xc", "lost_samples")), term_make_maybe_boxed_int64(stats.lost_samples, &ctx->heap))
+    };
+    term ret = term_nil();
+    for (int i = STREAM_STATS - 1; i >= 0; --i) {
+        ret = term_list_prepend(values[i], ret, &ctx->heap);
+    }
+    return ret;
+}
+#endif
+
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+//
+// Binary stream sinks
+//
+
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+static bool parse_address(term address, term port, struct adc_sink_config *config)
+{
+    // {A, B, C, D}
+    if (!term_is_tuple(address) || term_get_tuple_arity(address) != 4 || !term_is_integer(port)
+        || term_to_int(port) < 1 || term_to_int(port) > UINT16_MAX) {
+        return false;
+    }
+    uint8_t octets[4];
+    for (int i = 0; i < 4; ++i) {
+        term octet = term_get_tuple_element(address, i);
+        if (!term_is_integer(octet) || term_to_int(octet) < 0 || term_to_int(octet) > 255) {
+            return false;
+        }
+        octets[i] = term_to_int(octet);
+    }
+    // network byte order
+    memcpy(&config->addr, octets, sizeof(octets));
+    config->addr_port = term_to_int(port);
+    return true;
+}
+#endif
+
+static bool parse_sink_spec(term spec, GlobalContext *global, struct adc_sink_config *config)
+{
+    // {uart, Port, Options} | {usb_cdc, Options} | {udp | tcp, Address, Port, Options}
+    if (!term_is_tuple(spec) || term_get_tuple_arity(spec) < 2) {
+        return false;
+    }
+    term type = term_get_tuple_element(spec, 0);
+    term options;
+    config->port = 0;
+    if (type == globalcontext_make_atom(global, ATOM_STR("\x4", "uart")) && term_get_tuple_arity(spec) == 3) {
+        term port = term_get_tuple_element(spec, 1);
+        if (!term_is_integer(port)) {
+            return false;
+        }
+        config->type = ADC_SINK_UART;
+        config->port = term_to_int(port);
+        options = term_get_tuple_element(spec, 2);
+    } else if (type == globalcontext_make_atom(global, ATOM_STR("\x7", "usb_cdc")) && term_get_tuple_arity(spec) == 2) {
+        config->type = ADC_SINK_USB_CDC;
+        options = term_get_tuple_element(spec, 1);
+#ifdef CONFIG_AVM_ADC_SINK_NET_ENABLE
+    } else if ((type == globalcontext_make_atom(global, ATOM_STR("\x3", "udp")) || type == globalcontext_make_atom(global, ATOM_STR("\x3", "tcp")))
+        && term_get_tuple_arity(spec) == 4) {
+        if (!parse_address(term_get_tuple_element(spec, 1), term_get_tuple_element(spec, 2), config)) {
+            return false;
+        }
+        config->type = type == globalcontext_make_atom(global, ATOM_STR("\x3", "udp")) ? ADC_SINK_UDP : ADC_SINK_TCP;
+        options = term_get_tuple_element(spec, 3);
+#endif
+    } else {
+        return false;
+    }
+    if (!term_is_list(options)) {
+        return false;
+    }
+
+    avm_int_t baud_rate;
+    avm_int_t tx_pin;
+    avm_int_t rx_pin;
+    avm_int_t buffer_size;
+    avm_int_t mtu;
+    if (!kv_get_int(options, ATOM_STR("\x9", "baud_rate"), DEFAULT_SINK_BAUD_RATE, 1200, 5000000, global, &baud_rate)
+        || !kv_get_int(options, ATOM_STR("\x2", "tx"), -1, -1, SOC_GPIO_PIN_COUNT - 1, global, &tx_pin)
+        || !kv_get_int(options, ATOM_STR("\x2", "rx"), -1, -1, SOC_GPIO_PIN_COUNT - 1, global, &rx_pin)
+        || !kv_get_int(options, ATOM_STR("\x6", "buffer"), DEFAULT_SINK_BUFFER, MIN_SINK_BUFFER, 1024 * 1024, global, &buffer_size)
+        || !kv_get_int(options, ATOM_STR("\x3", "mtu"), DEFAULT_SINK_MTU, 576, 65535, global, &mtu)) {
+        return false;
+    }
+    config->baud_rate = baud_rate;
+    config->tx_pin = tx_pin;
+    config->rx_pin = rx_pin;
+    config->buffer_size = buffer_size;
+    config->datagram_size = mtu - SINK_UDP_OVERHEAD;
+    return true;
+}
+
+static term nif_adc_sink_open(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    struct adc_sink_config config;
+    if (UNLIKELY(!parse_sink_spec(argv[0], ctx->global, &config))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    struct sink_resource *rsrc = enif_alloc_resource(sink_resource_type, sizeof(struct sink_resource));
+    if (UNLIKELY(IS_NULL_PTR(rsrc))) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    rsrc->sink = NULL;
+    esp_err_t err = adc_sink_open(&config, &rsrc->sink);
+    if (UNLIKELY(err != ESP_OK)) {
+        enif_release_resource(rsrc);
+        return make_error(ctx, term_from_int(err));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, TERM_BOXED_RESOURCE_SIZE) != MEMORY_GC_OK)) {
+        enif_release_resource(rsrc);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term obj = enif_make_resource(erl_nif_env_from_context(ctx), rsrc);
+    enif_release_resource(rsrc);
+    return obj;
+}
+
+static void sink_resource_close(struct sink_resource *rsrc)
+{
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    struct adc_sink *sink = rsrc->sink;
+    rsrc->sink = NULL;
+    xSemaphoreGive(sampler_resource_lock);
+
+    // samplers writing to the sink keep it open until they are stopped
+    if (sink != NULL) {
+        adc_sink_release(sink);
+    }
+}
+
+static void sink_resource_dtor(ErlNifEnv *caller_env, void *obj)
+{
+    UNUSED(caller_env);
+
+    sink_resource_close((struct sink_resource *) obj);
+}
+
+static term nif_adc_sink_close(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sink_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    sink_resource_close((struct sink_resource *) rsrc_obj_ptr);
+    return OK_ATOM;
+}
+
+#define SINK_STATS 7
+#define SINK_STATS_SIZE (SINK_STATS * (CONS_SIZE + TUPLE_SIZE(2) + BOXED_INT64_SIZE))
+
+static term nif_adc_sink_get_stats(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    void *rsrc_obj_ptr;
+    if (UNLIKELY(!enif_get_resource(erl_nif_env_from_context(ctx), argv[0], sink_resource_type, &rsrc_obj_ptr))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    struct sink_resource *rsrc = (struct sink_resource *) rsrc_obj_ptr;
+
+    struct adc_sink_stats stats;
+    bool closed = false;
+    xSemaphoreTake(sampler_resource_lock, portMAX_DELAY);
+    if (rsrc->sink == NULL) {
+        closed = true;
+    } else {
+        adc_sink_get_stats(rsrc->sink, &stats);
+    }
+    xSemaphoreGive(sampler_resource_lock);
+
+    if (closed) {
+        return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "closed")));
+    }
+
+    if (UNLIKELY(memory_ensure_free(ctx, SINK_STATS_SIZE) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term values[SINK_STATS] = {
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "frames")), term_make_maybe_boxed_int64(stats.frames, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x4", "gaps")), term_make_maybe_boxed_int64(stats.gaps, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x7", "dropped")), term_make_maybe_boxed_int64(stats.dropped, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x5", "bytes")), term_make_maybe_boxed_int64(stats.bytes, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x5", "sends")), term_make_maybe_boxed_int64(stats.sends, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x6", "errors")), term_make_maybe_boxed_int64(stats.errors, &ctx->heap)),
+        create_pair(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\x8", "connects")), term_make_maybe_boxed_int64(stats.connects, &ctx->heap))
+    };
+    term ret = term_nil();
+    for (int i = SINK_STATS - 1; i >= 0; --i) {
+        ret = term_list_prepend(values[i], ret, &ctx->heap);
+    }
+    return ret;
+}
+#endif
+
+#endif
+
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+//
+// Sample blocks, as binaries of native 16-bit samples
+//
+
+static term nif_adc_smooth(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    VALIDATE_VALUE(argv[0], term_is_binary);
+    struct adc_smooth smooth;
+    if (UNLIKELY(!parse_smooth(argv[1], ctx->global, &smooth))) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+    size_t size = term_binary_size(argv[0]);
+    if (UNLIKELY(size % sizeof(uint16_t) != 0)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+
+    // argv[0] may move if the heap is collected
+    if (UNLIKELY(memory_ensure_free_with_roots(ctx, term_binary_heap_size(size), 1, argv, MEMORY_CAN_SHRINK) != MEMORY_GC_OK)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term ret = term_create_uninitialized_binary(size, &ctx->heap, ctx->global);
+    const char *in = term_binary_data(argv[0]);
+    uint16_t *out = (uint16_t *) term_binary_data(ret);
+
+    if (((uintptr_t) in & (sizeof(uint16_t) - 1)) == 0) {
+        adc_smooth_apply(&smooth, (const uint16_t *) in, out, size / sizeof(uint16_t));
+    } else {
+        // sub-binaries are not necessarily aligned
+        uint16_t *aligned = malloc(size);
+        if (IS_NULL_PTR(aligned)) {
+            RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+        }
+        memcpy(aligned, in, size);
+        adc_smooth_apply(&smooth, aligned, out, size / sizeof(uint16_t));
+        free(aligned);
+    }
+    return ret;
+}
+#endif
+
+//
+// Tracing
+//
+
+static term nif_adc_trace(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+
+    term enable = argv[0];
+    if (UNLIKELY(enable != TRUE_ATOM && enable != FALSE_ATOM)) {
+        RAISE_ERROR(BADARG_ATOM);
+    }
+#ifdef CONFIG_AVM_ADC_TRACE_ENABLE
+    UNUSED(ctx);
+    adc_trace_enable(enable == TRUE_ATOM);
+    return OK_ATOM;
+#else
+    return make_error(ctx, globalcontext_make_atom(ctx->global, ATOM_STR("\xd", "not_supported")));
+#endif
+}
+
+static term nif_adc_trace_dump(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+    UNUSED(argv);
+
+    // drain into a scratch buffer first, as the ring may change size until it
+    // is locked
+    size_t max_records = adc_trace_count();
+    void *buf = malloc(sizeof(struct adc_trace_header) + max_records * sizeof(struct adc_trace_record));
+    if (IS_NULL_PTR(buf)) {
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    size_t size = adc_trace_drain(buf, max_records);
+
+    if (UNLIKELY(memory_ensure_free(ctx, term_binary_heap_size(size)) != MEMORY_GC_OK)) {
+        free(buf);
+        RAISE_ERROR(OUT_OF_MEMORY_ATOM);
+    }
+    term ret = term_from_literal_binary(buf, size, &ctx->heap, ctx->global);
+    free(buf);
+    return ret;
+}
+
+static term nif_adc_pin_is_adc2(Context *ctx, int argc, term argv[])
+{
+    UNUSED(argc);
+#ifdef CONFIG_AVM_ADC2_ENABLE
+    term pin = argv[0];
+    VALIDATE_VALUE(pin, term_is_integer);
+    adc_unit_t Adc_Unit = adc_unit_from_pin(term_to_int(pin));
+    switch (Adc_Unit) {
+        case ADC_UNIT_2:
+            return TRUE_ATOM;
+        default:
+            return FALSE_ATOM;
+    }
+#else
+    UNUSED(argv);
+    return FALSE_ATOM;
+#endif
+}
+
+static const struct Nif adc_config_width_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_config_width
+};
+static const struct Nif adc_config_channel_attenuation_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_config_channel_attenuation
+};
+static const struct Nif adc_configure_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_configure
+};
+static const struct Nif adc_take_reading_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_take_reading
+};
+static const struct Nif adc_resume_reading_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_resume_reading
+};
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+static const struct Nif adc_compile_profile_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_compile_profile
+};
+#endif
+#ifdef CONFIG_AVM_ADC_SCAN_ENABLE
+static const struct Nif adc_take_scan_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_take_scan
+};
+#endif
+static const struct Nif adc_submit_reading_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_submit_reading
+};
+static const struct Nif adc_scheduler_stats_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_scheduler_stats
+};
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+static const struct Nif adc_sampler_create_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_create
+};
+static const struct Nif adc_sampler_destroy_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_destroy
+};
+static const struct Nif adc_sampler_reconfigure_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_reconfigure
+};
+#endif
+#ifdef CONFIG_AVM_ADC_FILTER_ENABLE
+static const struct Nif adc_sampler_filter_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_filter
+};
+#endif
+#ifdef CONFIG_AVM_ADC_QUANTILES_ENABLE
+static const struct Nif adc_sampler_quantiles_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_quantiles
+};
+#endif
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+static const struct Nif adc_sampler_jitter_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_jitter
+};
+#endif
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+static const struct Nif adc_sampler_stream_stats_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sampler_stream_stats
+};
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+static const struct Nif adc_sink_open_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sink_open
+};
+static const struct Nif adc_sink_close_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sink_close
+};
+static const struct Nif adc_sink_get_stats_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_sink_get_stats
+};
+#endif
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+static const struct Nif adc_smooth_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_smooth
+};
+#endif
+static const struct Nif adc_trace_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_trace
+};
+static const struct Nif adc_trace_dump_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_trace_dump
+};
+static const struct Nif adc_pin_is_adc2_nif = {
+    .base.type = NIFFunctionType,
+    .nif_ptr = nif_adc_pin_is_adc2
+};
+
+//
+// Component Nif Entrypoints
+//
+
+void atomvm_adc_init(GlobalContext *global)
+{
+    if (UNLIKELY(adc_acq_init() != ESP_OK)) {
+        ESP_LOGE(TAG, "Unable to initialize ADC acquisition");
+    }
+
+    ErlNifEnv env;
+    erl_nif_env_partial_init_from_globalcontext(&env, global);
+    reading_resource_type = enif_init_resource_type(&env, "adc_reading", &reading_resource_type_init, ERL_NIF_RT_CREATE, NULL);
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+    profile_resource_type = enif_init_resource_type(&env, "adc_profile", &profile_resource_type_init, ERL_NIF_RT_CREATE, NULL);
+#endif
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+    sampler_resource_type = enif_init_resource_type(&env, "adc_sampler", &sampler_resource_type_init, ERL_NIF_RT_CREATE, NULL);
+    sampler_resource_lock = xSemaphoreCreateMutex();
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+    sink_resource_type = enif_init_resource_type(&env, "adc_sink", &sink_resource_type_init, ERL_NIF_RT_CREATE, NULL);
+#endif
+
+    // Check TP is burned into eFuse
+    if (esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_TP) == ESP_OK) {
+        ESP_LOGI(TAG, "eFuse Two Point: Supported");
+    } else {
+        ESP_LOGI(TAG, "eFuse Two Point: NOT supported");
+    }
+
+    // Check Vref is burned into eFuse
+    if (esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_VREF) == ESP_OK) {
+        ESP_LOGI(TAG, "eFuse Vref: Supported");
+    } else {
+        ESP_LOGI(TAG, "eFuse Vref: NOT supported");
+    }
+}
+
+const struct Nif *atomvm_adc_get_nif(const char *nifname)
+{
+    TRACE("Locating nif %s ...", nifname);
+    if (strcmp("adc:config_width/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_config_width_nif;
+    }
+    if (strcmp("adc:config_channel_attenuation/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_config_channel_attenuation_nif;
+    }
+    if (strcmp("adc:configure/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_configure_nif;
+    }
+    if (strcmp("adc:take_reading/4", nifname) == 0) {
         TRACE("Resolved platform nif %s ...\n", nifname);
         return &adc_take_reading_nif;
     }
+    if (strcmp("adc:resume_reading/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_resume_reading_nif;
+    }
+#ifdef CONFIG_AVM_ADC_PROFILES_ENABLE
+    if (strcmp("adc:compile_profile/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_compile_profile_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_SCAN_ENABLE
+    if (strcmp("adc:take_scan/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_take_scan_nif;
+    }
+#endif
+    if (strcmp("adc:submit_reading/5", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_submit_reading_nif;
+    }
+    if (strcmp("adc:scheduler_stats/0", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_scheduler_stats_nif;
+    }
+#ifdef CONFIG_AVM_ADC_SAMPLER_ENABLE
+    if (strcmp("adc:sampler_create/6", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_create_nif;
+    }
+    if (strcmp("adc:sampler_destroy/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_destroy_nif;
+    }
+    if (strcmp("adc:sampler_reconfigure/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_reconfigure_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_FILTER_ENABLE
+    if (strcmp("adc:sampler_filter/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_filter_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_QUANTILES_ENABLE
+    if (strcmp("adc:sampler_quantiles/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_quantiles_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_JITTER_ENABLE
+    if (strcmp("adc:sampler_jitter/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_jitter_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_STREAM_ENABLE
+    if (strcmp("adc:sampler_stream_stats/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sampler_stream_stats_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_SINK_ENABLE
+    if (strcmp("adc:sink_open/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sink_open_nif;
+    }
+    if (strcmp("adc:sink_close/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sink_close_nif;
+    }
+    if (strcmp("adc:sink_get_stats/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_sink_get_stats_nif;
+    }
+#endif
+#ifdef CONFIG_AVM_ADC_SMOOTH_ENABLE
+    if (strcmp("adc:smooth/2", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_smooth_nif;
+    }
+#endif
+    if (strcmp("adc:trace/1", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_trace_nif;
+    }
+    if (strcmp("adc:trace_dump/0", nifname) == 0) {
+        TRACE("Resolved platform nif %s ...\n", nifname);
+        return &adc_trace_dump_nif;
+    }
     if (strcmp("adc:pin_is_adc2/1", nifname) == 0) {
         TRACE("Resolved platform nif %s ...\n", nifname);
         return &adc_pin_is_adc2_nif;
@@ -27,13 +27,20 @@
 -module(adc).
 
 -export([
-    start/1, start/2, stop/1, read/1, read/2
+    start/1, start/2, start_configured/0, start_configured/1, stop/1, read/1, read/2, read_value/1, read_value/2, read_async/1, read_async/2, scan/2, scheduler_stats/0,
+    start_sampler/2, stop_sampler/1, reconfigure/2, sampler_estimate/1, quantiles/1, jitter/1, stream_stats/1, burst/3, smooth/2,
+    open_sink/1, close_sink/1, sink_stats/1,
+    trace/1, trace_dump/0
 ]).
--export([config_width/2, config_channel_attenuation/2, take_reading/4, pin_is_adc2/1]). %% internal nif APIs
+-export([config_width/2, config_channel_attenuation/2, configure/1, take_reading/4, resume_reading/1, take_scan/2, compile_profile/2, submit_reading/5,
+         sampler_create/6, sampler_destroy/1, sampler_reconfigure/2, sampler_filter/1, sampler_quantiles/1, sampler_jitter/1, sampler_stream_stats/1, sink_open/1, sink_close/1, sink_get_stats/1,
+         pin_is_adc2/1]). %% internal nif APIs
 -export([init/1, handle_call/3, handle_cast/2, handle_info/2, terminate/2, code_change/3]).
 
 -behaviour(gen_server).
 
+-export_type([adc/0, sampler/0, sink/0]).
+
 -type adc() :: pid().
 -type adc_pin() ::  adc1_pin() | adc2_pin().
 -type adc1_pin() :: 32..39.
@@ -41,23 +48,65 @@
 -type options() :: [option()].
 -type bit_width() :: bit_9 | bit_10 | bit_11 | bit_12 | bit_13 | bit_max.
 -type attenuation() :: db_0 | db_2_5 | db_6 | db_11.
--type option() :: {bit_width, bit_width()} | {attenuation, attenuation()}.
+-type option() :: {bit_width, bit_width()} | {attenuation, attenuation()} | {discard, non_neg_integer()} | {profile, profile()}.
+-type pin_config() :: {Name::atom(), Pin::adc_pin(), Options::[option() | {sampler, sampler_options()}]}.
+-type profile() :: {ntc, [ntc_option()]} | {divider, RTop::pos_integer(), RBottom::pos_integer()} | {li_ion, [li_ion_option()]}.
+-type ntc_option() :: {beta, number()} | {steinhart_hart, {A::float(), B::float(), C::float()}} | {r0, number()} | {t0, number()}
+                    | {series, number()} | {supply, number()} | {position, low | high}.
+-type li_ion_option() :: {cells, pos_integer()} | {divider, {RTop::non_neg_integer(), RBottom::pos_integer()}}.
 
 -type read_options() :: [read_option()].
--type read_option() :: raw | voltage | {samples, pos_integer()}.
+-type read_option() :: raw | voltage | value | {samples, pos_integer()} | {discard, non_neg_integer()} | {priority, priority()} | {deadline, non_neg_integer()}.
+-type priority() :: high | normal | low.
 
 -type raw_value() :: 0..4095 | undefined.
 -type voltage_reading() :: 0..3300 | undefined.
--type reading() :: {raw_value(), voltage_reading()}.
+-type reading() :: {raw_value(), voltage_reading()} | {raw_value(), voltage_reading(), value()}.
+-type value() :: integer() | undefined.
+-type scan_info() :: [{scan_rate, non_neg_integer()} | {conversion_rate, non_neg_integer()} | {conversions, non_neg_integer()}].
+-opaque sampler() :: {reference(), term()}.
+-type sampler_options() :: [sampler_option()].
+-type sampler_option() :: {rate, pos_integer()} | {samples, pos_integer()} | {filter, filter()} | {quantiles, [float()]} | {stream, BlockSize::pos_integer()} | {smooth, smoothing()}
+                        | {envelope, [envelope_option()]} | {power, [power_option()]} | {phase, [phase_option()]}
+                        | {pulse, [pulse_option()]} | {health, [health_option()]} | {jitter, boolean()} | {sink, sink()}.
+-type reconfigure_option() :: {attenuation, attenuation()} | {rate, pos_integer()} | {samples, pos_integer()} | {filter, filter() | undefined}.
+-opaque sink() :: term().
+-type sink_spec() :: {uart, Port::non_neg_integer(), [sink_option()]} | {usb_cdc, [sink_option()]}
+                   | {udp | tcp, Address::{byte(), byte(), byte(), byte()}, Port::pos_integer(), [sink_option()]}.
+-type sink_option() :: {baud_rate, pos_integer()} | {tx, Pin::non_neg_integer()} | {rx, Pin::non_neg_integer()} | {buffer, Bytes::pos_integer()}
+                     | {mtu, Bytes::pos_integer()}.
+-type sink_stat() :: {frames, non_neg_integer()} | {gaps, non_neg_integer()} | {dropped, non_neg_integer()}
+                   | {bytes, non_neg_integer()} | {sends, non_neg_integer()} | {errors, non_neg_integer()} | {connects, non_neg_integer()}.
+-type stream_stat() :: {sequence, non_neg_integer()} | {frames, non_neg_integer()} | {gaps, non_neg_integer()}
+                     | {lost_frames, non_neg_integer()} | {lost_samples, non_neg_integer()}.
+-type health_option() :: {window, Samples::pos_integer()} | {noise, MilliVolts::pos_integer()}.
+-type jitter_stat() :: {intervals, non_neg_integer()} | {min, Us::integer()} | {max, Us::integer()} | {mean, Us::float()}
+                     | {stddev, Us::float()} | {rate, Hz::float()} | {missed, non_neg_integer()} | {histogram, [non_neg_integer()]}.
+-type health() :: ok | stuck | saturated_low | saturated_high | open.
+-type pulse_option() :: {threshold, {LowMilliVolts::non_neg_integer(), HighMilliVolts::non_neg_integer()}} | {window, Ms::pos_integer()}.
+-type phase_option() :: {adc, adc()} | {method, goertzel | xcorr} | {frequency, Hz::pos_integer()} | {cycles, pos_integer()}
+                      | {max_lag, Samples::pos_integer()}.
+-type power_option() :: {frequency, Hz::pos_integer()} | {cycles, pos_integer()} | {harmonics, pos_integer()}.
+-type envelope_option() :: {attack, Ms::non_neg_integer()} | {decay, Ms::non_neg_integer()} | {threshold, MilliVolts::non_neg_integer()}
+                         | {separation, Ms::non_neg_integer()} | {center, auto | MilliVolts::non_neg_integer()}.
+-type smoothing() :: {moving_average, Window::pos_integer()} | {savitzky_golay, Window::pos_integer(), Order::non_neg_integer()}.
+-type samples() :: binary().
+-type filter() :: {kalman, ProcessNoise::number(), MeasurementNoise::number()} | {alpha_beta, Alpha::number(), Beta::number()}.
+-type class_stats() :: [{completed, non_neg_integer()} | {deadline_misses, non_neg_integer()}].
+-type scheduler_stats() :: [{preemptions, non_neg_integer()} | {pending, non_neg_integer()} | {priority(), class_stats()}].
 
 -define(DEFAULT_OPTIONS, [{bit_width, bit_12}, {attenuation, db_11}]).
 -define(DEFAULT_SAMPLES, 64).
 -define(DEFAULT_READ_OPTIONS, [raw, voltage, {samples, ?DEFAULT_SAMPLES}]).
+-define(DEFAULT_SAMPLER_RATE, 100).
+-define(BURST_TIMEOUT_MARGIN, 1000).
 
 -record(state, {
     pin :: adc_pin(),
     bit_width :: bit_width(),
-    attenuation :: attenuation()
+    attenuation :: attenuation(),
+    discard :: non_neg_integer(),
+    profile :: term() | undefined
 }).
 
 
@@ -86,6 +135,15 @@ start(Pin) ->
 %% may be used to automatically select the highest sample rate supported by your
 %% ESP chip-set.
 %%
+%% The option `{discard, N}' specifies the number of settling conversions to
+%% discard whenever the ADC multiplexer switches to this pin from another
+%% channel (default 0).  High impedance sources may need a few settling
+%% conversions to avoid crosstalk from the previously read channel.
+%%
+%% The option `{profile, Profile}' attaches a conversion profile to the ADC,
+%% used to convert readings to engineering units (see `read_value/2').  The
+%% profile is compiled into a lookup table when the ADC is started.
+%%
 %% Note. Unlike the esp-idf adc driver bit widths are used on a per pin basis,
 %% so pins on the same adc unit can use different widths if necessary.
 %%
@@ -96,6 +154,54 @@ start(Pin) ->
 start(Pin, Options) ->
     gen_server:start(?MODULE, [Pin, Options], []).
 
+%%-----------------------------------------------------------------------------
+%% @returns {ok, [{Name, ADC, Sampler}]} | {error, Reason}
+%% @equiv   start_configured(PinConfigs)
+%% @doc     Start the ADCs configured in the application environment.
+%%
+%% PinConfigs is the value of the `pins' key in the environment of the `adc'
+%% application (default `[]').
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start_configured() -> {ok, [{Name::atom(), adc(), sampler() | undefined}]} | {error, Reason::term()}.
+start_configured() ->
+    start_configured(application:get_env(adc, pins, [])).
+
+%%-----------------------------------------------------------------------------
+%% @param   PinConfigs  pins to start
+%% @returns {ok, [{Name, ADC, Sampler}]} | {error, Reason}
+%% @doc     Start a set of ADCs in one batch.
+%%
+%% Each element of PinConfigs is `{Name, Pin, Options}', where Options are
+%% the options of `start/2', optionally with a `{sampler, SamplerOptions}'
+%% entry to also start a sampler on the pin (see `start_sampler/2').
+%%
+%% All pins are configured in a single call, and their calibration
+%% characteristics are computed on the other core (on dual core chips)
+%% while the ADC processes are started, which is faster than calling
+%% `start/2' for each pin.  Each ADC is registered under its Name, which may
+%% be used instead of the ADC in all operations.  Samplers are owned by the
+%% calling process, and stopped when it exits.
+%%
+%% The result lists the ADCs in the order given, with their sampler, or
+%% `undefined'.  If any ADC or sampler fails to start, the ones already
+%% started are stopped, and the error is returned; a configuration error is
+%% returned as `{error, {Pin, Reason}}'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start_configured(PinConfigs::[pin_config()]) -> {ok, [{Name::atom(), adc(), sampler() | undefined}]} | {error, Reason::term()}.
+start_configured(PinConfigs) ->
+    Channels = [
+        {Pin, proplists:get_value(bit_width, Options, bit_12), proplists:get_value(attenuation, Options, db_11)}
+        || {_Name, Pin, Options} <- PinConfigs
+    ],
+    case adc:configure(Channels) of
+        ok ->
+            start_configured(PinConfigs, []);
+        {error, _Reason} = Error ->
+            Error
+    end.
+
 %%-----------------------------------------------------------------------------
 %% @returns ok
 %% @doc     Stop the specified ADC.
@@ -137,14 +243,535 @@ read(ADC) ->
 %% You may specify the number of samples to be taken and averaged over using the tuple
 %% `{samples, Samples::pos_integer()}'.
 %%
+%% The tuple `{discard, N}' overrides the number of settling conversions
+%% configured for the pin in `start/2'.
+%%
+%% If the ReadOptions contains the atom `value', the reading is a 3-tuple, and
+%% its third element is the reading converted with the profile configured in
+%% `start/2' (or `undefined', if the ADC has no profile).
+%%
 %% If the error `Reason' is timeout and the adc channel is on unit 2 then WiFi is likely
-%% enabled and adc2 readings will no longer be possible.
+%% enabled and adc2 readings will no longer be possible.  Other conversion
+%% errors are returned as the integer `esp_err_t' code of the driver.
 %% @end
 %%-----------------------------------------------------------------------------
 -spec read(ADC::adc(), ReadOptions::read_options()) -> {ok, reading()} | {error, Reason::term()}.
 read(ADC, ReadOptions) ->
     gen_server:call(ADC, {read, ReadOptions}).
 
+%%-----------------------------------------------------------------------------
+%% @param   ADC         ADC to read from
+%% @returns {ok, Value} | {error, Reason}
+%% @equiv   read_value(ADC, [{samples, 64}])
+%% @doc     Take a reading in engineering units.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec read_value(ADC::adc()) -> {ok, integer()} | {error, Reason::term()}.
+read_value(ADC) ->
+    read_value(ADC, [{samples, ?DEFAULT_SAMPLES}]).
+
+%%-----------------------------------------------------------------------------
+%% @param   ADC         ADC to read from
+%% @param   ReadOptions extra options
+%% @returns {ok, Value} | {error, Reason}
+%% @doc     Take a reading in engineering units.
+%%
+%% The reading is converted with the profile configured in `start/2', using
+%% a precompiled lookup table.  Values are integers, in milli-degrees Celsius
+%% for `ntc' profiles, in millivolts for `divider' profiles, and in per-mille
+%% state of charge for `li_ion' profiles.
+%%
+%% The ReadOptions are the same as for `read/2'.  An error is returned if the
+%% ADC has no profile.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec read_value(ADC::adc(), ReadOptions::read_options()) -> {ok, integer()} | {error, Reason::term()}.
+read_value(ADC, ReadOptions) ->
+    case read(ADC, [value | ReadOptions]) of
+        {ok, {_Raw, _MilliVolts, undefined}} ->
+            {error, no_profile};
+        {ok, {_Raw, _MilliVolts, Value}} ->
+            {ok, Value};
+        {ok, {error, _Reason} = Error} ->
+            Error;
+        Error ->
+            Error
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   ADC         ADC to read from
+%% @returns {ok, Ref} | {error, Reason}
+%% @equiv   read_async(ADC, [raw, voltage, {samples, 64}])
+%% @doc     Request an asynchronous reading from the pin associated with this ADC.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec read_async(ADC::adc()) -> {ok, reference()} | {error, Reason::term()}.
+read_async(ADC) ->
+    read_async(ADC, ?DEFAULT_READ_OPTIONS).
+
+%%-----------------------------------------------------------------------------
+%% @param   ADC         ADC to read from
+%% @param   ReadOptions extra options
+%% @returns {ok, Ref} | {error, Reason}
+%% @doc     Request an asynchronous reading from the pin associated with this ADC.
+%%
+%% The reading is taken by the ADC acquisition task and delivered to the
+%% calling process as a message of the form `{adc_reading, Ref, Reading}',
+%% where `Reading' is either `{RawValue, MilliVoltage}' or `{error, Reason}'.
+%%
+%% In addition to the options accepted by `read/2', the ReadOptions may contain
+%% `{priority, high | normal | low}' (default `normal') and
+%% `{deadline, Milliseconds}'.  Pending readings are served in priority order,
+%% and by earliest deadline within a priority class.  Long readings are taken in
+%% chunks, so a `high' priority reading only waits for the current chunk of a
+%% lower priority reading to finish.  Readings that complete after their
+%% deadline are still delivered, and are counted in `scheduler_stats/0'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec read_async(ADC::adc(), ReadOptions::read_options()) -> {ok, reference()} | {error, Reason::term()}.
+read_async(ADC, ReadOptions) ->
+    gen_server:call(ADC, {read_async, ReadOptions}).
+
+%%-----------------------------------------------------------------------------
+%% @param   ADCs        ADCs to read from
+%% @param   ReadOptions extra options
+%% @returns {ok, Readings, ScanInfo} | {error, Reason}
+%% @doc     Take one reading from each of the specified ADCs.
+%%
+%% The ReadOptions are the same as for `read/2', and apply to every channel,
+%% except that `value' is not supported, and that at most 64 `samples' are
+%% averaged per channel, as the whole scan is taken in one call.  A
+%% `{discard, N}' option overrides the setting of every pin.  The returned
+%% readings are in the same order as `ADCs'.
+%%
+%% Channels are not necessarily converted in the order given: the scan is
+%% planned to group channels by ADC unit, bit width and attenuation, so that
+%% the converter is reconfigured as few times as possible.  Settling
+%% conversions configured with `{discard, N}' are only taken when the
+%% multiplexer actually switches channel.
+%%
+%% `ScanInfo' reports the effective scan rate (full scans per second), the
+%% conversion rate, and the total number of conversions, including
+%% discarded settling conversions.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec scan(ADCs::[adc()], ReadOptions::read_options()) -> {ok, [reading()], scan_info()} | {error, Reason::term()}.
+scan(ADCs, ReadOptions) ->
+    Channels = [gen_server:call(ADC, get_channel) || ADC <- ADCs],
+    case adc:take_scan(Channels, ReadOptions) of
+        {error, _Reason} = Error ->
+            Error;
+        {Readings, ScanInfo} ->
+            {ok, Readings, ScanInfo}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @returns scheduler statistics
+%% @doc     Return statistics from the ADC acquisition task.
+%%
+%% The returned property list contains the number of times a reading was
+%% preempted by a more urgent one, the number of pending readings, and, per
+%% priority class, the number of completed readings and deadline misses.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec scheduler_stats() -> scheduler_stats().
+scheduler_stats() ->
+    throw(nif_error).
+
+%%-----------------------------------------------------------------------------
+%% @param   Enable  whether to record trace events
+%% @returns ok | {error, not_supported}
+%% @doc     Enable or disable the binary trace ring.
+%%
+%% While enabled, the reading, scan and acquisition paths record compact
+%% binary events into a ring buffer, which is drained with `trace_dump/0'.
+%% Tracing is disabled at boot, and `{error, not_supported}' is returned if
+%% the trace ring is disabled in the build configuration.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec trace(Enable::boolean()) -> ok | {error, not_supported}.
+trace(_Enable) ->
+    throw(nif_error).
+
+%%-----------------------------------------------------------------------------
+%% @returns trace dump
+%% @doc     Drain the binary trace ring.
+%%
+%% Returns the recorded events, oldest first, and removes them from the ring.
+%% Use `tools/adc_trace_decode.py' on the host to convert a dump to the
+%% Chrome trace event format, which can be loaded in Perfetto.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec trace_dump() -> binary().
+trace_dump() ->
+    throw(nif_error).
+
+
+%%-----------------------------------------------------------------------------
+%% @param   ADC             ADC to sample
+%% @param   SamplerOptions  sampler options
+%% @returns {ok, Sampler} | {error, Reason}
+%% @doc     Start a background sampler on the pin associated with this ADC.
+%%
+%% A sampler periodically takes samples on the ADC acquisition task, without
+%% any involvement of the Erlang VM, and passes every sample through the
+%% processors configured in the SamplerOptions.  The results of the processors
+%% can be queried at any time.
+%%
+%% The following options are supported:
+%% <ul>
+%%   <li>`{rate, Hz}' the sample rate (default 100, at most 10000)</li>
+%%   <li>`{samples, N}' the number of conversions averaged into each sample
+%%       (default 1)</li>
+%%   <li>`{filter, {kalman, ProcessNoise, MeasurementNoise}}' a 1-D Kalman
+%%       filter, with the process and measurement noise variances in mV^2</li>
+%%   <li>`{filter, {alpha_beta, Alpha, Beta}}' an alpha-beta tracking filter,
+%%       with gains `0 < Alpha =< 1' and `0 =< Beta =< 2'</li>
+%%   <li>`{quantiles, [P]}' estimate up to 8 quantiles of the voltage, each
+%%       P between 0 and 1 exclusive, e.g. `[0.5, 0.95, 0.99]' (see
+%%       `quantiles/1')</li>
+%%   <li>`{stream, BlockSize}' send blocks of BlockSize samples (at most 4096)
+%%       to the calling process, as
+%%       `{adc_sampler, Ref, {block, Sequence, Timestamp, Samples}}' messages,
+%%       where Ref is the first element of the Sampler, Sequence the sequence
+%%       number of the block, Timestamp is the time of the first sample in
+%%       microseconds and Samples is a samples binary.  When samples are
+%%       skipped because the sampler fell behind or a conversion failed, the
+%%       block is cut short, and the loss is reported before the next block
+%%       with a `{adc_sampler, Ref, {gap, Sequence, Timestamp, LostSamples}}'
+%%       message, with the time of the first lost sample.  Blocks and gaps
+%%       share one sequence, so a stream is complete if no sequence number
+%%       is missing (see `stream_stats/1')</li>
+%%   <li>`{smooth, Smoothing}' smooth streamed blocks before they are sent
+%%       (see `smooth/2')</li>
+%%   <li>`{sink, Sink}' write streamed blocks to a sink opened with
+%%       `open_sink/1' instead of sending them to the calling process</li>
+%%   <li>`{envelope, EnvelopeOptions}' track the amplitude envelope of the
+%%       signal and send `{adc_sampler, Ref, {peak, Timestamp, Amplitude}}'
+%%       messages to the calling process for each peak of the envelope, with
+%%       the Amplitude in millivolts.  EnvelopeOptions may contain the attack
+%%       and decay time constants (`{attack, Ms}', default 5, and
+%%       `{decay, Ms}', default 100), the minimum peak amplitude
+%%       (`{threshold, MilliVolts}', default 0), the minimum time between
+%%       peaks (`{separation, Ms}', default 100) and the voltage around which
+%%       the signal is rectified (`{center, MilliVolts}', or `{center, auto}'
+%%       to track the DC level of the signal, the default)</li>
+%%   <li>`{power, PowerOptions}' measure the power quality of an AC signal
+%%       of the line frequency `{frequency, Hz}' (default 50), and send
+%%       `{adc_sampler, Ref, {power, Timestamp, Metrics}}' messages to the
+%%       calling process every `{cycles, N}' cycles (default 10), where
+%%       Metrics contains the AC RMS and fundamental amplitude in millivolts,
+%%       the THD up to the `{harmonics, H}'th harmonic (default 7, at most 15)
+%%       and the crest factor, all as floats.  The sample rate must be more
+%%       than twice the line frequency, and windows that are too long for
+%%       the line frequency and sample rate raise `badarg'.</li>
+%%   <li>`{pulse, PulseOptions}' measure pulses on the signal, which is high
+%%       once it rises to High millivolts and low once it falls to Low
+%%       millivolts, given as `{threshold, {Low, High}}' (required), and send
+%%       `{adc_sampler, Ref, {pulse, Timestamp, Stats}}' messages to the
+%%       calling process at the end of every window of `{window, Ms}'
+%%       milliseconds (default 1000).  Stats contains the number of pulses
+%%       (`pulses'), the `{Min, Mean, Max}' pulse width (`width') and period
+%%       (`period') in microseconds, and the duty cycle over the window
+%%       in per-mille (`duty').</li>
+%%   <li>`{health, HealthOptions}' check the health of the pin over every
+%%       window of `{window, N}' samples (default 100), and send
+%%       `{adc_sampler, Ref, {health, Timestamp, Health}}' messages to the
+%%       calling process when it changes, where Health is `ok', `stuck'
+%%       (identical readings over a window), `saturated_low' or
+%%       `saturated_high' (readings pinned at a rail), or `open' (a standard
+%%       deviation above `{noise, MilliVolts}', default 50)</li>
+%%   <li>`{phase, PhaseOptions}' sample the pin of a second ADC, given as
+%%       `{adc, ADC2}', right after each sample of this one, and send
+%%       `{adc_sampler, Ref, {phase, Timestamp, Metrics}}' messages to the
+%%       calling process every `{cycles, N}' cycles (default 10) of the
+%%       frequency `{frequency, Hz}' (default 50).  Metrics contains how much
+%%       the second signal lags the first, in microseconds (`lag') and in
+%%       degrees (`phase'), and the cosine of the phase (`power_factor'), all
+%%       as floats.  The phase is measured at the fundamental with
+%%       `{method, goertzel}' (the default), or derived from the peak of the
+%%       cross-correlation of both signals, within `{max_lag, Samples}'
+%%       (default half a cycle), with `{method, xcorr}'.</li>
+%%   <li>`{jitter, true}' record the time between samples (see
+%%       `jitter/1')</li>
+%% </ul>
+%%
+%% The sampler runs until it is stopped with `stop_sampler/1', until the
+%% calling process, which owns the sampler, exits, or until the returned
+%% Sampler is no longer referenced by any process.  Once a sampler is
+%% stopped, all operations on it but `stop_sampler/1' return
+%% `{error, stopped}'.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec start_sampler(ADC::adc(), SamplerOptions::sampler_options()) -> {ok, sampler()} | {error, Reason::term()}.
+start_sampler(ADC, SamplerOptions) ->
+    gen_server:call(ADC, {start_sampler, [resolve_sampler_option(Option) || Option <- SamplerOptions]}).
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler to stop
+%% @returns ok
+%% @doc     Stop a background sampler.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec stop_sampler(Sampler::sampler()) -> ok.
+stop_sampler({_Ref, Resource}) ->
+    adc:sampler_destroy(Resource).
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler to reconfigure
+%% @param   Options     options to change
+%% @returns ok | {error, Reason}
+%% @doc     Change the configuration of a running sampler.
+%%
+%% The following options of `start_sampler/2' can be changed, while the
+%% sampler keeps running:
+%% <ul>
+%%   <li>`{attenuation, Attenuation}' the attenuation of the pin, and the
+%%       calibration of the sampler's readings</li>
+%%   <li>`{rate, Hz}' the sample rate; samplers tracking envelopes, power or
+%%       phase return `{error, fixed_rate}', and jitter statistics (see
+%%       `jitter/1') start over</li>
+%%   <li>`{samples, N}' the number of conversions averaged into each sample</li>
+%%   <li>`{filter, Filter}' a new tracking filter, which starts from scratch,
+%%       or `{filter, undefined}' to remove it</li>
+%% </ul>
+%% All changes take effect together, in between two samples, and never
+%% within a streamed block: the block collected so far is sent early, and
+%% streaming samplers then send an
+%% `{adc_sampler, Ref, {reconfigured, Sequence, Timestamp}}' message (or a
+%% config record to their sink), with the time from which the new
+%% configuration applies, before the next block.  Changes made before the
+%% previous ones took effect are merged with them.
+%%
+%% The attenuation is set on the pin, but readings taken through the ADC
+%% (see `read/2') are still calibrated for the attenuation it was started
+%% with.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec reconfigure(Sampler::sampler(), Options::[reconfigure_option()]) -> ok | {error, Reason::term()}.
+reconfigure({_Ref, Resource}, Options) ->
+    adc:sampler_reconfigure(Resource, Options).
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler with a filter
+%% @returns {ok, {Estimate, Variance}} | {error, Reason}
+%% @doc     Return the current estimate of the sampler's tracking filter.
+%%
+%% The estimate is in millivolts.  For Kalman filters, the variance is the
+%% variance of the estimate; for alpha-beta filters, it is the variance of the
+%% residual between the measurements and the prediction.  Both are floats.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec sampler_estimate(Sampler::sampler()) -> {ok, {Estimate::float(), Variance::float()}} | {error, Reason::term()}.
+sampler_estimate({_Ref, Resource}) ->
+    case adc:sampler_filter(Resource) of
+        {error, _Reason} = Error ->
+            Error;
+        Estimate ->
+            {ok, Estimate}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler with quantile estimators
+%% @returns {ok, [{P, Estimate}]} | {error, Reason}
+%% @doc     Return the current quantile estimates of a sampler.
+%%
+%% Quantiles are estimated over all samples since the sampler was started,
+%% in constant memory, with the P-square algorithm.  Estimates are in
+%% millivolts, as floats, and are exact while there are fewer than five
+%% samples.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec quantiles(Sampler::sampler()) -> {ok, [{P::float(), Estimate::float()}]} | {error, Reason::term()}.
+quantiles({_Ref, Resource}) ->
+    case adc:sampler_quantiles(Resource) of
+        {error, _Reason} = Error ->
+            Error;
+        Quantiles ->
+            {ok, Quantiles}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler started with `{jitter, true}'
+%% @returns {ok, Stats} | {error, Reason}
+%% @doc     Return the timing statistics of a sampler.
+%%
+%% Intervals are measured between the starts of consecutive samples, in
+%% microseconds, since the sampler was started.  Stats contains the number
+%% of intervals (`intervals'), their `min', `max', `mean' and `stddev', the
+%% effective sample `rate' in Hz, the number of samples skipped because the
+%% sampler fell behind (`missed'), and a `histogram' of the deviation of the
+%% intervals from the nominal period, as a list of 16 counts: the first
+%% counts exact intervals, the Nth deviations from 2^(N-2) up to 2^(N-1) - 1
+%% microseconds, and the last every larger deviation.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec jitter(Sampler::sampler()) -> {ok, [jitter_stat()]} | {error, Reason::term()}.
+jitter({_Ref, Resource}) ->
+    case adc:sampler_jitter(Resource) of
+        {error, _Reason} = Error ->
+            Error;
+        Stats ->
+            {ok, Stats}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Sampler     sampler started with `{stream, BlockSize}'
+%% @returns {ok, Stats} | {error, Reason}
+%% @doc     Return the loss counters of a streaming sampler.
+%%
+%% Stats contains the next sequence number (`sequence'), the number of
+%% blocks (`frames') and gap reports (`gaps') delivered to the calling
+%% process or the sink, the number of blocks and gap reports dropped
+%% because the sink was full (`lost_frames'), and the number of samples
+%% lost, in dropped blocks or skipped (`lost_samples'), since the sampler
+%% was started.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec stream_stats(Sampler::sampler()) -> {ok, [stream_stat()]} | {error, Reason::term()}.
+stream_stats({_Ref, Resource}) ->
+    case adc:sampler_stream_stats(Resource) of
+        {error, _Reason} = Error ->
+            Error;
+        Stats ->
+            {ok, Stats}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   ADC             ADC to sample
+%% @param   Count           number of samples to capture
+%% @param   SamplerOptions  sampler options
+%% @returns {ok, Samples} | {error, Reason}
+%% @doc     Capture a burst of samples.
+%%
+%% Count samples are taken at the rate given in SamplerOptions (see
+%% `start_sampler/2'), and returned as a samples binary.  If a `{smooth, Smoothing}'
+%% option is given, the burst is smoothed before it is returned.  If samples
+%% are skipped because the sampler fell behind, `{error, overrun}' is returned.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec burst(ADC::adc(), Count::pos_integer(), SamplerOptions::sampler_options()) -> {ok, samples()} | {error, Reason::term()}.
+burst(ADC, Count, SamplerOptions) ->
+    case start_sampler(ADC, [{stream, Count} | SamplerOptions]) of
+        {ok, {Ref, _Resource} = Sampler} ->
+            Rate = proplists:get_value(rate, SamplerOptions, ?DEFAULT_SAMPLER_RATE),
+            Timeout = (Count * 1000) div Rate + ?BURST_TIMEOUT_MARGIN,
+            Reply = receive
+                {adc_sampler, Ref, {block, _Sequence, _Timestamp, Samples}} when byte_size(Samples) =:= 2 * Count ->
+                    {ok, Samples};
+                {adc_sampler, Ref, {block, _Sequence, _Timestamp, _ShortSamples}} ->
+                    {error, overrun}
+            after Timeout ->
+                {error, timeout}
+            end,
+            stop_sampler(Sampler),
+            flush_blocks(Ref),
+            Reply;
+        Error ->
+            Error
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Samples     samples binary
+%% @param   Smoothing   smoothing to apply
+%% @returns smoothed samples binary
+%% @doc     Smooth a block of samples.
+%%
+%% Samples binaries contain 16-bit unsigned samples in native byte order,
+%% in millivolts.  The following smoothings are supported:
+%% <ul>
+%%   <li>`{moving_average, Window}' a centered moving average over an odd
+%%       Window of at most 65 samples</li>
+%%   <li>`{savitzky_golay, Window, Order}' a Savitzky-Golay filter, which fits
+%%       a polynomial of the given Order (at most 6, and less than Window)
+%%       over an odd Window of at most 65 samples; peaks are preserved better
+%%       than with a moving average</li>
+%% </ul>
+%% At the edges of the block, the first and last samples are repeated to fill
+%% the window.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec smooth(Samples::samples(), Smoothing::smoothing()) -> samples().
+smooth(_Samples, _Smoothing) ->
+    throw(nif_error).
+
+%%-----------------------------------------------------------------------------
+%% @param   SinkSpec    port to write to
+%% @returns {ok, Sink} | {error, Reason}
+%% @doc     Open a binary stream sink.
+%%
+%% Samplers started with a `{sink, Sink}' option write their blocks to the
+%% sink as binary frames, straight from the ADC acquisition task, without
+%% any involvement of the Erlang VM.  This is meant for lab and end-of-line
+%% test setups, where a host captures the frames, e.g. with
+%% `tools/adc_capture.py'.  The frame format is described in the
+%% documentation of the driver.
+%%
+%% SinkSpec is `{uart, Port, Options}' for a UART, `{usb_cdc, Options}'
+%% for the USB Serial/JTAG controller of chips that have one,
+%% `{udp, Address, Port, Options}' to send frames in UDP datagrams, or
+%% `{tcp, Address, Port, Options}' to send them over a TCP connection, which
+%% is made, and made again after errors, in the background.  Address is an
+%% IPv4 address tuple.  The following options are supported:
+%% <ul>
+%%   <li>`{baud_rate, Baud}' the UART baud rate (default 921600)</li>
+%%   <li>`{tx, Pin}' and `{rx, Pin}' the UART pins (default the pins
+%%       already routed to the UART)</li>
+%%   <li>`{buffer, Bytes}' the size of the buffer between the acquisition
+%%       task and the port (default 16384); frames that do not fit are
+%%       dropped and counted</li>
+%%   <li>`{mtu, Bytes}' the MTU of the network (default 1500); UDP sinks
+%%       batch as many frames into each datagram as fit, and send at least
+%%       every 20 ms</li>
+%% </ul>
+%% The sink is closed with `close_sink/1', or once it is no longer
+%% referenced by any process, after the samplers writing to it are stopped.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec open_sink(SinkSpec::sink_spec()) -> {ok, sink()} | {error, Reason::term()}.
+open_sink(SinkSpec) ->
+    case adc:sink_open(SinkSpec) of
+        {error, _Reason} = Error ->
+            Error;
+        Sink ->
+            {ok, Sink}
+    end.
+
+%%-----------------------------------------------------------------------------
+%% @param   Sink        sink to close
+%% @returns ok
+%% @doc     Close a binary stream sink.
+%%
+%% Samplers still writing to the sink keep the port open until they are
+%% stopped.
+%% @end
+%%-----------------------------------------------------------------------------
+-spec close_sink(Sink::sink()) -> ok.
+close_sink(Sink) ->
+    adc:sink_close(Sink).
+
+%%-----------------------------------------------------------------------------
+%% @param   Sink        sink
+%% @returns {ok, Stats} | {error, Reason}
+%% @doc     Return the statistics of a binary stream sink.
+%%
+%% Stats contains the number of sample frames (`frames') and gap records
+%% (`gaps') queued, the number of frames of either kind dropped because the
+%% buffer was full (`dropped'), which samplers report in their next gap
+%% record (see `stream_stats/1' for their losses), the number of bytes written to
+%% the port (`bytes'), the number of writes (`sends', datagrams for UDP
+%% sinks), the number of failed or short writes (`errors'), and the number of
+%% connections made by TCP sinks (`connects').
+%% @end
+%%-----------------------------------------------------------------------------
+-spec sink_stats(Sink::sink()) -> {ok, [sink_stat()]} | {error, Reason::term()}.
+sink_stats(Sink) ->
+    case adc:sink_get_stats(Sink) of
+        {error, _Reason} = Error ->
+            Error;
+        Stats ->
+            {ok, Stats}
+    end.
 
 %%
 %% gen_server API
@@ -152,26 +779,60 @@ read(ADC, ReadOptions) ->
 
 %% @hidden
 init([Pin, Options]) ->
-    BitWidth = proplists:get_value(bit_width, Options, bit_12),
-    case adc:config_width(Pin, BitWidth) of
+    case adc:config_width(Pin, proplists:get_value(bit_width, Options, bit_12)) of
         ok -> ok;
         {error, R1} ->
             throw({config_width, R1})
     end,
-    Attenuation = proplists:get_value(attenuation, Options, db_11),
-    case adc:config_channel_attenuation(Pin, Attenuation) of
+    case adc:config_channel_attenuation(Pin, proplists:get_value(attenuation, Options, db_11)) of
         ok -> ok;
         {error, R2} ->
             throw({config_channel_attenuation, R2})
     end,
+    init([Pin, Options, configured]);
+init([Pin, Options, configured]) ->
+    %% the hardware has already been configured, by the clause above or by
+    %% start_configured/1
+    BitWidth = proplists:get_value(bit_width, Options, bit_12),
+    Attenuation = proplists:get_value(attenuation, Options, db_11),
+    Discard = proplists:get_value(discard, Options, 0),
+    Profile = case proplists:get_value(profile, Options) of
+        undefined ->
+            undefined;
+        ProfileSpec ->
+            try
+                adc:compile_profile(ProfileSpec, Attenuation)
+            catch
+                _:_ ->
+                    throw({profile, ProfileSpec})
+            end
+    end,
     {ok, #state{
-        pin=Pin, bit_width=BitWidth, attenuation=Attenuation
+        pin=Pin, bit_width=BitWidth, attenuation=Attenuation, discard=Discard, profile=Profile
     }}.
 
 %% @hidden
-handle_call({read, ReadOptions}, _From, State) ->
-    Reading = adc:take_reading(State#state.pin, ReadOptions, State#state.bit_width, State#state.attenuation),
-    {reply, {ok, Reading}, State};
+handle_call({read, ReadOptions}, From, State) ->
+    case adc:take_reading(State#state.pin, read_options(ReadOptions, State), State#state.bit_width, State#state.attenuation) of
+        {continue, Continuation} ->
+            self() ! {continue_reading, From, Continuation},
+            {noreply, State};
+        Reading ->
+            {reply, {ok, Reading}, State}
+    end;
+handle_call({read_async, ReadOptions}, {Pid, _Tag}, State) ->
+    Reply = adc:submit_reading(State#state.pin, read_options(ReadOptions, State), State#state.bit_width, State#state.attenuation, Pid),
+    {reply, Reply, State};
+handle_call({start_sampler, SamplerOptions}, {Pid, _Tag}, State) ->
+    Reply = case adc:sampler_create(State#state.pin, State#state.bit_width, State#state.attenuation, State#state.discard, SamplerOptions, Pid) of
+        {error, _Reason} = Error ->
+            Error;
+        Sampler ->
+            {ok, Sampler}
+    end,
+    {reply, Reply, State};
+handle_call(get_channel, _From, State) ->
+    {reply, {State#state.pin, State#state.bit_width, State#state.attenuation, State#state.discard}, State};
 handle_call(Request, _From, State) ->
     {reply, {error, {unknown_request, Request}}, State}.
 
@@ -180,6 +841,16 @@ handle_cast(_Msg, State) ->
     {noreply, State}.
 
 %% @hidden
+handle_info({continue_reading, From, Continuation}, State) ->
+    %% Large readings are taken in time slices; going back through the
+    %% mailbox between slices lets other processes run in the meantime.
+    case adc:resume_reading(Continuation) of
+        {continue, Continuation} ->
+            self() ! {continue_reading, From, Continuation};
+        Reading ->
+            gen_server:reply(From, {ok, Reading})
+    end,
+    {noreply, State};
 handle_info(_Info, State) ->
     {noreply, State}.
 
@@ -191,6 +862,17 @@ terminate(_Reason, _State) ->
 code_change(_OldVsn, State, _Extra) ->
     {ok, State}.
 
+%%
+%% internal operations
+%%
+
+%% @private
+read_options(ReadOptions, #state{profile=undefined} = State) ->
+    %% options given by the caller take precedence over the pin defaults
+    ReadOptions ++ [{discard, State#state.discard}];
+read_options(ReadOptions, State) ->
+    ReadOptions ++ [{discard, State#state.discard}, {profile, State#state.profile}].
+
 %%
 %% internal nif API operations
 %%
@@ -203,10 +885,129 @@ config_width(_Pin, _BitWidth) ->
 config_channel_attenuation(_Pin, _Attenuation) ->
     throw(nif_error).
 
+%% @hidden
+configure(_PinConfigs) ->
+    throw(nif_error).
+
 %% @hidden
 take_reading(_Pin, _ReadOptions, _BitWidth, _Attenuation) ->
     throw(nif_error).
 
+%% @hidden
+resume_reading(_Continuation) ->
+    throw(nif_error).
+
+%% @hidden
+compile_profile(_Profile, _Attenuation) ->
+    throw(nif_error).
+
+%% @hidden
+take_scan(_Channels, _ReadOptions) ->
+    throw(nif_error).
+
+%% @hidden
+submit_reading(_Pin, _ReadOptions, _BitWidth, _Attenuation, _ReplyTo) ->
+    throw(nif_error).
+
+%% @private
+start_configured([], Accum) ->
+    {ok, lists:reverse(Accum)};
+start_configured([{Name, Pin, Options} | Rest], Accum) ->
+    case gen_server:start({local, Name}, ?MODULE, [Pin, Options, configured], []) of
+        {ok, ADC} ->
+            case start_configured_sampler(ADC, proplists:get_value(sampler, Options)) of
+                {ok, Sampler} ->
+                    start_configured(Rest, [{Name, ADC, Sampler} | Accum]);
+                {error, _Reason} = Error ->
+                    stop(ADC),
+                    stop_configured(Accum),
+                    Error
+            end;
+        {error, _Reason} = Error ->
+            stop_configured(Accum),
+            Error
+    end.
+
+%% @private
+start_configured_sampler(_ADC, undefined) ->
+    {ok, undefined};
+start_configured_sampler(ADC, SamplerOptions) ->
+    start_sampler(ADC, SamplerOptions).
+
+%% @private
+stop_configured(Started) ->
+    lists:foreach(
+        fun({_Name, ADC, Sampler}) ->
+            case Sampler of
+                undefined -> ok;
+                _ -> stop_sampler(Sampler)
+            end,
+            stop(ADC)
+        end,
+        Started
+    ).
+
+%% @private
+resolve_sampler_option({phase, PhaseOptions}) ->
+    {phase, [resolve_phase_option(Option) || Option <- PhaseOptions]};
+resolve_sampler_option(Option) ->
+    Option.
+
+%% @private
+resolve_phase_option({adc, ADC}) ->
+    {channel, gen_server:call(ADC, get_channel)};
+resolve_phase_option(Option) ->
+    Option.
+
+%% @private
+flush_blocks(Ref) ->
+    receive
+        {adc_sampler, Ref, _Event} ->
+            flush_blocks(Ref)
+    after 0 ->
+        ok
+    end.
+
+%% @hidden
+sampler_create(_Pin, _BitWidth, _Attenuation, _Discard, _SamplerOptions, _Owner) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_destroy(_Resource) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_reconfigure(_Resource, _Options) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_filter(_Resource) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_quantiles(_Resource) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_jitter(_Resource) ->
+    throw(nif_error).
+
+%% @hidden
+sampler_stream_stats(_Resource) ->
+    throw(nif_error).
+
+%% @hidden
+sink_open(_SinkSpec) ->
+    throw(nif_error).
+
+%% @hidden
+sink_close(_Sink) ->
+    throw(nif_error).
+
+%% @hidden
+sink_get_stats(_Sink) ->
+    throw(nif_error).
+
 %% @hidden
 pin_is_adc2(_Pin) ->
     throw(nif_error).
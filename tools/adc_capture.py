@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 dushin.net
+# All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Capture frames written by an ADC stream sink (adc:open_sink/1).
+
+Reads frames from a serial port, e.g. /dev/ttyUSB0 for a UART behind a USB
+adapter or /dev/ttyACM0 for the USB Serial/JTAG controller, or receives them
+from a UDP or TCP sink, checks their CRC and writes the samples as CSV, one
+row per sample with its timestamp in microseconds, the source pin and the
+voltage in millivolts.  The input may also be a file of raw frames, e.g. one
+saved earlier with --raw.
+
+Usage: adc_capture.py (PORT [--baud BAUD] | --udp PORT | --tcp PORT [--bind ADDRESS])
+                      [--csv FILE] [--raw FILE] [--frames N] [--seconds S]
+
+TCP sinks reconnect after errors, so the capture accepts a new connection
+whenever one is closed, until it stops.
+
+Statistics are printed on stderr at the end: frames received, frames with a
+bad CRC, bytes skipped while looking for the start of a frame, gap records
+received, the frames and samples they report lost on the device, and config
+records received, one for each reconfiguration of a sampler.  Every
+frame of a source has a sequence number, so frames lost on the way, which no
+gap record reports, are counted as missing.  To test on a host without a
+device, run
+host/adc_sink_sim, which writes frames to a pseudo terminal, or sends them
+to a UDP or TCP port on the loopback interface.
+"""
+
+import argparse
+import binascii
+import csv
+import os
+import select
+import socket
+import struct
+import sys
+import termios
+import time
+import tty
+
+# Must be kept in sync with nifs/adc_frame.h
+HEADER = struct.Struct("<4sBBHIIIqI")
+GAP = struct.Struct("<II")
+CONFIG = struct.Struct("<BBH")
+TRAILER = struct.Struct("<I")
+MAGIC = b"ADCF"
+VERSION = 2
+SAMPLES = 0
+GAP_RECORD = 1
+CONFIG_RECORD = 2
+MAX_PAYLOAD = 2 * 4096
+SEQUENCE_MASK = 0xffffffff
+
+
+class FrameReader:
+    """Split a byte stream into frames, resynchronizing on the magic."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frames = 0
+        self.crc_errors = 0
+        self.skipped = 0
+        self.gaps = 0
+        self.lost_frames = 0
+        self.lost_samples = 0
+        self.reconfigs = 0
+        self.missing = 0
+        self.next_sequence = {}
+
+    def account(self, source, first, count):
+        """Account for count sequence numbers from first, received or reported lost."""
+        expected = self.next_sequence.get(source)
+        if expected is not None:
+            ahead = (first - expected) & SEQUENCE_MASK
+            # anything else is a duplicate, or out of order
+            if ahead < 0x80000000:
+                self.missing += ahead
+        self.next_sequence[source] = (first + count) & SEQUENCE_MASK
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(MAGIC)
+            if start < 0:
+                # keep a partial magic at the end
+                keep = len(MAGIC) - 1
+                self.skipped += max(0, len(self.buffer) - keep)
+                del self.buffer[:max(0, len(self.buffer) - keep)]
+                return
+            if start > 0:
+                self.skipped += start
+                del self.buffer[:start]
+            if len(self.buffer) < HEADER.size:
+                return
+            _, version, frame_type, source, sequence, count, length, timestamp_us, period_us = HEADER.unpack_from(self.buffer)
+            if version != VERSION or length > MAX_PAYLOAD or length % 2 != 0:
+                self.skipped += 1
+                del self.buffer[:1]
+                continue
+            size = HEADER.size + length + TRAILER.size
+            if len(self.buffer) < size:
+                return
+            (crc,) = TRAILER.unpack_from(self.buffer, HEADER.size + length)
+            if binascii.crc32(self.buffer[len(MAGIC):HEADER.size + length]) != crc:
+                # not a frame after all, or a corrupted one
+                self.crc_errors += 1
+                self.skipped += 1
+                del self.buffer[:1]
+                continue
+            payload = bytes(self.buffer[HEADER.size:HEADER.size + length])
+            del self.buffer[:size]
+            self.frames += 1
+            if frame_type == GAP_RECORD and length == GAP.size:
+                first, lost = GAP.unpack(payload)
+                self.gaps += 1
+                self.lost_frames += lost
+                self.lost_samples += count
+                if lost > 0:
+                    self.account(source, first, lost)
+                self.account(source, sequence, 1)
+                continue
+            if frame_type == CONFIG_RECORD and length == CONFIG.size:
+                # the attenuation and oversampling are not needed for the CSV,
+                # and the new period comes with every block
+                self.reconfigs += 1
+            self.account(source, sequence, 1)
+            if frame_type != SAMPLES:
+                continue
+            samples = struct.unpack("<%dH" % (length // 2), payload)
+            yield source, timestamp_us, period_us, samples
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd, termios.TCSANOW)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, "B%d" % baud, None)
+        if speed is None:
+            sys.exit("unsupported baud rate %d" % baud)
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+class Input:
+    """Bytes from a serial port or file, or from UDP or TCP sinks."""
+
+    def __init__(self, args):
+        self.server = None
+        self.conn = None
+        if args.udp is not None:
+            self.server = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.server.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+            self.server.bind((args.bind, args.udp))
+            self.datagrams = True
+        elif args.tcp is not None:
+            self.server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            self.server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            self.server.bind((args.bind, args.tcp))
+            self.server.listen(1)
+            self.datagrams = False
+        else:
+            self.fd = open_port(args.port, args.baud)
+
+    def fileno(self):
+        if self.server is None:
+            return self.fd
+        if self.conn is not None:
+            return self.conn.fileno()
+        return self.server.fileno()
+
+    def read(self):
+        """Return the next bytes, b"" at the end, or None if there are none yet."""
+        if self.server is None:
+            try:
+                return os.read(self.fd, 4096)
+            except OSError:
+                # the other side of a pseudo terminal went away
+                return b""
+        if self.datagrams:
+            return self.server.recv(65536)
+        if self.conn is None:
+            self.conn, _ = self.server.accept()
+            return None
+        data = self.conn.recv(65536)
+        if not data:
+            # wait for the sink to reconnect
+            self.conn.close()
+            self.conn = None
+            return None
+        return data
+
+    def close(self):
+        if self.server is None:
+            os.close(self.fd)
+            return
+        if self.conn is not None:
+            self.conn.close()
+        self.server.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Capture frames written by an ADC stream sink")
+    parser.add_argument("port", nargs="?", help="serial port, pseudo terminal or file of raw frames")
+    parser.add_argument("--udp", type=int, metavar="PORT", help="receive datagrams from a UDP sink")
+    parser.add_argument("--tcp", type=int, metavar="PORT", help="accept connections from a TCP sink")
+    parser.add_argument("--bind", default="0.0.0.0", help="address to receive on (default all)")
+    parser.add_argument("--baud", type=int, default=921600, help="baud rate (default 921600)")
+    parser.add_argument("--csv", metavar="FILE", help="write samples as CSV (- for stdout)")
+    parser.add_argument("--raw", metavar="FILE", help="save the raw byte stream")
+    parser.add_argument("--frames", type=int, default=0, help="stop after N frames")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after S seconds")
+    args = parser.parse_args()
+    if sum(x is not None for x in (args.port, args.udp, args.tcp)) != 1:
+        parser.error("give one of PORT, --udp or --tcp")
+
+    stream = Input(args)
+    out = None
+    writer = None
+    if args.csv is not None:
+        out = sys.stdout if args.csv == "-" else open(args.csv, "w", newline="")
+        writer = csv.writer(out)
+        writer.writerow(["timestamp_us", "source", "mv"])
+    raw = open(args.raw, "wb") if args.raw is not None else None
+
+    reader = FrameReader()
+    samples = 0
+    deadline = time.monotonic() + args.seconds if args.seconds > 0 else None
+    try:
+        while args.frames == 0 or reader.frames < args.frames:
+            timeout = None if deadline is None else deadline - time.monotonic()
+            if timeout is not None and timeout <= 0:
+                break
+            if not select.select([stream], [], [], timeout)[0]:
+                continue
+            data = stream.read()
+            if data is None:
+                continue
+            if not data:
+                break
+            if raw is not None:
+                raw.write(data)
+            for source, timestamp_us, period_us, block in reader.feed(data):
+                samples += len(block)
+                if writer is not None:
+                    for i, mv in enumerate(block):
+                        writer.writerow([timestamp_us + i * period_us, source, mv])
+                if args.frames and reader.frames >= args.frames:
+                    break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        stream.close()
+        if raw is not None:
+            raw.close()
+        if out is not None and out is not sys.stdout:
+            out.close()
+
+    sys.stderr.write("frames %d samples %d crc_errors %d skipped %d gaps %d lost_frames %d lost_samples %d reconfigs %d missing %d\n"
+                     % (reader.frames, samples, reader.crc_errors, reader.skipped, reader.gaps,
+                        reader.lost_frames, reader.lost_samples, reader.reconfigs, reader.missing))
+
+
+if __name__ == "__main__":
+    main()
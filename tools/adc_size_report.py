@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 dushin.net
+# All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Report the flash, IRAM and DRAM used by each feature of the ADC driver.
+
+Reads the linker map file of an application image, e.g. build/atomvm-esp32.map
+in the AtomVM ESP32 build directory, so only code and data actually linked into
+the image are counted.  Code of the NIF glue in atomvm_adc.c, adc_acq.c and
+adc_sampler.c is attributed to features by function name, as the component is
+built with one section per function; everything else is attributed by object
+file.
+
+Usage: adc_size_report.py MAP [--archive NAME] [--objects] [--json]
+
+Features are selected with the CONFIG_AVM_ADC_*_ENABLE options in menuconfig;
+see the Kconfig file of the component.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+COLUMNS = ["flash_code", "flash_rodata", "iram", "dram"]
+
+# object file -> feature
+OBJECTS = {
+    "atomvm_adc": "core",
+    "adc_acq": "core",
+    "adc_cal": "core",
+    "adc_block": "smooth",
+    "adc_trace": "trace",
+    "adc_profile": "profiles",
+    "adc_smooth": "smooth",
+    "adc_sampler": "sampler",
+    "adc_filter": "filter",
+    "adc_quantile": "quantiles",
+    "adc_jitter": "jitter",
+    "adc_frame": "sink",
+    "adc_sink": "sink",
+    "adc_envelope": "envelope",
+    "adc_power": "power",
+    "adc_phase": "phase",
+    "adc_pulse": "pulse",
+    "adc_health": "health",
+}
+
+# objects whose sections are attributed by function or variable name
+GLUE = {"atomvm_adc", "adc_acq", "adc_sampler"}
+
+# (pattern, feature), first match wins
+SYMBOLS = [
+    (r"profile|lut|kv_get_float|kv_get_divider|attenuation_max_mv", "profiles"),
+    (r"scan", "scan"),
+    (r"sampler_filter|parse_filter", "filter"),
+    (r"quantile", "quantiles"),
+    (r"jitter", "jitter"),
+    (r"smooth", "smooth"),
+    (r"sink", "sink"),
+    (r"stream|block_event|gap_event|config_event", "stream"),
+    (r"envelope|peak_event", "envelope"),
+    (r"power", "power"),
+    (r"phase|parse_channel|process_pair", "phase"),
+    (r"pulse", "pulse"),
+    (r"health", "health"),
+    (r"sampler|metrics|send_event", "sampler"),
+    (r"trace", "trace"),
+]
+
+FEATURES = ["core", "trace", "profiles", "scan", "smooth", "sampler", "filter", "quantiles",
+            "jitter", "stream", "sink", "envelope", "power", "phase", "pulse", "health"]
+
+OUTPUT_SECTION = re.compile(r"^(\.\S+)(?:\s+0x[0-9a-f]+\s+0x[0-9a-f]+)?")
+INPUT_SECTION = re.compile(r"^ (\.\S+)(?:\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*))?$")
+CONTINUATION = re.compile(r"^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*)$")
+MEMBER = re.compile(r"([^/\\(]+)\(([^)]+)\)$")
+
+
+def column(output_section):
+    name = output_section.lower()
+    if "iram" in name:
+        return "iram"
+    if name.startswith((".rtc", ".debug", ".comment", ".note", ".eh_frame", ".xt.", ".xtensa")):
+        return None
+    if "dram" in name or re.search(r"(^|\.)(s?data|s?bss|noinit)\b", name):
+        return "dram"
+    if "rodata" in name:
+        return "flash_rodata"
+    if "text" in name or "literal" in name:
+        return "flash_code"
+    return None
+
+
+def object_name(path, archive):
+    match = MEMBER.search(path.strip())
+    if match is None or (archive is not None and match.group(1) != archive):
+        return None
+    obj = match.group(2)
+    for suffix in (".c.obj", ".c.o", ".obj", ".o"):
+        if obj.endswith(suffix):
+            return obj[:-len(suffix)]
+    return obj
+
+
+def feature(obj, section):
+    if obj in GLUE:
+        # .text.nif_adc_sampler_jitter, .rodata.parse_power.str1.1, ...
+        symbol = section.split(".", 2)[-1] if section.count(".") >= 2 else ""
+        for pattern, name in SYMBOLS:
+            if re.search(pattern, symbol):
+                return name
+    return OBJECTS.get(obj, obj)
+
+
+def parse_map(lines, archive):
+    """Yield (object, input section, column, size) for each linked input section."""
+    in_memory_map = False
+    output = None
+    pending = None
+    for line in lines:
+        line = line.rstrip("\n")
+        if not in_memory_map:
+            in_memory_map = line.startswith("Linker script and memory map")
+            continue
+        if pending is not None:
+            match = CONTINUATION.match(line)
+            if match is not None:
+                yield pending, match.group(2), int(match.group(1), 16), output
+            pending = None
+            continue
+        if line.startswith("."):
+            output = OUTPUT_SECTION.match(line).group(1)
+            continue
+        match = INPUT_SECTION.match(line)
+        if match is None:
+            continue
+        if match.group(2) is None:
+            # long section names are followed by their address on the next line
+            pending = match.group(1)
+        else:
+            yield match.group(1), match.group(3), int(match.group(2), 16), output
+
+
+def report(lines, archive):
+    totals = {}
+    for section, path, size, output in parse_map(lines, archive):
+        if size == 0 or output is None:
+            continue
+        col = column(output)
+        obj = object_name(path, archive)
+        if col is None or obj is None:
+            continue
+        key = (feature(obj, section), obj)
+        row = totals.setdefault(key, dict.fromkeys(COLUMNS, 0))
+        row[col] += size
+    return totals
+
+
+def group(totals, by_object):
+    rows = {}
+    for (name, obj), sizes in totals.items():
+        key = "%s (%s)" % (name, obj) if by_object else name
+        row = rows.setdefault(key, dict.fromkeys(COLUMNS, 0))
+        for col in COLUMNS:
+            row[col] += sizes[col]
+    order = {name: i for i, name in enumerate(FEATURES)}
+    return sorted(rows.items(), key=lambda kv: (order.get(kv[0].split(" ")[0], len(order)), kv[0]))
+
+
+def print_table(rows, out):
+    header = ["feature"] + COLUMNS + ["total"]
+    width = max([len(header[0])] + [len(name) for name, _ in rows]) + 2
+    out.write(header[0].ljust(width) + "".join(h.rjust(14) for h in header[1:]) + "\n")
+    sums = dict.fromkeys(COLUMNS, 0)
+    for name, sizes in rows:
+        for col in COLUMNS:
+            sums[col] += sizes[col]
+        values = [sizes[col] for col in COLUMNS] + [sum(sizes.values())]
+        out.write(name.ljust(width) + "".join(str(v).rjust(14) for v in values) + "\n")
+    values = [sums[col] for col in COLUMNS] + [sum(sums.values())]
+    out.write("total".ljust(width) + "".join(str(v).rjust(14) for v in values) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Report the flash, IRAM and DRAM used by each feature of the ADC driver")
+    parser.add_argument("map", help="linker map file of the application image")
+    parser.add_argument("--archive", default="libatomvm_adc.a", help="component library name (default libatomvm_adc.a)")
+    parser.add_argument("--objects", action="store_true", help="break features down by object file")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    args = parser.parse_args()
+
+    with open(args.map) as f:
+        totals = report(f, args.archive)
+    if not totals:
+        sys.exit("%s: no sections from %s" % (args.map, args.archive))
+    rows = group(totals, args.objects)
+    if args.json:
+        json.dump({name: sizes for name, sizes in rows}, sys.stdout, indent=2)
+        sys.stdout.write("\n")
+    else:
+        print_table(rows, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 dushin.net
+# All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Decode adc:trace_dump/0 binaries into Chrome trace event JSON.
+
+The output can be loaded in Perfetto (https://ui.perfetto.dev) or in
+chrome://tracing.  Several dumps may be given, in the order they were taken;
+timestamps are unwrapped across them.
+
+Usage: adc_trace_decode.py DUMP... [-o OUTPUT]
+
+Get dumps off the device in whatever way suits the application, e.g. by
+sending the binary returned by adc:trace_dump/0 to the host over a socket,
+and save each one to a file as is.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHII")
+MAGIC = b"ADCT"
+VERSION = 2
+
+# Tracks, shown as threads; events of the VM are shown on one track per task
+# that recorded them, as schedulers may trace concurrently
+VM = 1
+ACQUISITION = 2
+VM_TASKS = 16
+
+ESP_OK = 0
+PRIORITIES = ["high", "normal", "low"]
+
+# Must be kept in sync with adc_trace_event_t in nifs/adc_trace.h:
+#   id: (name, phase, track, arg0 name, arg1 name)
+# phase is "B" (begin), "E" (end) or "i" (instant)
+EVENTS = {
+    0: ("read_slice", "B", VM, "channel", "taken"),
+    1: ("read_slice", "E", VM, "error", "taken"),
+    2: ("reading", "i", VM, "samples", "raw"),
+    3: ("scan", "B", VM, "channels", "samples"),
+    4: ("scan", "E", VM, "error", "conversions"),
+    5: ("submit", "i", VM, "priority", "samples"),
+    6: ("chunk", "B", ACQUISITION, "priority", "samples"),
+    7: ("chunk", "E", ACQUISITION, "error", "taken"),
+    8: ("complete", "i", ACQUISITION, "priority", "deadline_missed"),
+    9: ("preempt", "i", ACQUISITION, "priority", None),
+    10: ("samplers", "B", ACQUISITION, None, None),
+    11: ("samplers", "E", ACQUISITION, None, "samples"),
+    12: ("sampler_overrun", "i", ACQUISITION, None, "late_us"),
+}
+
+
+def format_arg(name, value):
+    if name == "priority" and value < len(PRIORITIES):
+        return PRIORITIES[value]
+    if name == "error" and value != ESP_OK:
+        return "0x%x" % value
+    return value
+
+
+def read_dump(data):
+    if len(data) < HEADER.size:
+        raise ValueError("truncated header")
+    magic, version, record_size, records, dropped = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError("not an adc trace dump")
+    if version != VERSION:
+        raise ValueError("unsupported trace version %d" % version)
+    if len(data) < HEADER.size + records * record_size:
+        raise ValueError("truncated records")
+    record = struct.Struct("<IBBHI")
+    out = []
+    for i in range(records):
+        out.append(record.unpack_from(data, HEADER.size + i * record_size))
+    return out, dropped
+
+
+def decode(dumps):
+    events = [
+        {"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "adc"}},
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": VM, "args": {"name": "vm"}},
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": ACQUISITION, "args": {"name": "acquisition"}},
+    ]
+    vm_tasks = set()
+    high = 0
+    last = None
+    total_dropped = 0
+    for records, dropped in dumps:
+        total_dropped += dropped
+        for i, (timestamp, event, task, arg0, arg1) in enumerate(records):
+            # timestamps are the low 32 bits of the microsecond clock
+            if last is not None and high + timestamp < last - (1 << 31):
+                high += 1 << 32
+            ts = high + timestamp
+            last = ts
+            if i == 0 and dropped:
+                # records overwritten before this dump was taken
+                events.append({"name": "dropped", "ph": "i", "s": "g", "pid": 1, "tid": VM,
+                               "ts": ts, "args": {"records": dropped}})
+            if event not in EVENTS:
+                events.append({"name": "unknown_%d" % event, "ph": "i", "s": "t", "pid": 1, "tid": VM,
+                               "ts": ts, "args": {"arg0": arg0, "arg1": arg1}})
+                continue
+            name, phase, track, name0, name1 = EVENTS[event]
+            if track == VM and task != 0:
+                # task 0 is any task beyond the device's table
+                track = VM_TASKS + task
+                if task not in vm_tasks:
+                    vm_tasks.add(task)
+                    events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": track,
+                                   "args": {"name": "vm task %d" % task}})
+            args = {}
+            if name0 is not None:
+                args[name0] = format_arg(name0, arg0)
+            if name1 is not None:
+                args[name1] = format_arg(name1, arg1)
+            trace_event = {"name": name, "ph": phase, "pid": 1, "tid": track, "ts": ts, "args": args}
+            if phase == "i":
+                trace_event["s"] = "t"
+            events.append(trace_event)
+    return {"traceEvents": events, "displayTimeUnit": "ms", "otherData": {"dropped": total_dropped}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode adc:trace_dump/0 binaries into Chrome trace event JSON")
+    parser.add_argument("dumps", nargs="+", help="trace dump files, oldest first")
+    parser.add_argument("-o", "--output", help="output file (default standard output)")
+    args = parser.parse_args()
+
+    dumps = []
+    for path in args.dumps:
+        with open(path, "rb") as f:
+            try:
+                dumps.append(read_dump(f.read()))
+            except ValueError as e:
+                sys.exit("%s: %s" % (path, e))
+
+    trace = decode(dumps)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()